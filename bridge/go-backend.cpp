@@ -12,11 +12,24 @@
 
 #include "llvm-includes.h"
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
 #include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
 
 #include "go-llvm-diagnostics.h"
 #include "go-c.h"
+#include "go-export-data.h"
 
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Object/Archive.h"
 #include "llvm/Object/Binary.h"
@@ -35,6 +48,10 @@
 #define GO_EXPORT_SECTION_NAME ".go_export"
 #endif
 
+// Limits on the export data cache (see ExportDataCache below).
+#define GO_EXPORT_DATA_CACHE_MAX_FILES 1024
+#define GO_EXPORT_DATA_CACHE_MAX_BYTES (256ULL << 20)
+
 /* Return whether or not we've reported any errors.  */
 
 bool
@@ -53,11 +70,13 @@ go_imported_unsafe (void)
 {
 }
 
+// Locate the export data section in an object file. On success the
+// result refers to the underlying file buffer (no copy is made).
+
 static const char *
-readExportDataFromObject(llvm::object::ObjectFile *obj,
-                         int *perr,
-                         char **pbuf,
-                         size_t *plen)
+findExportDataInObject(llvm::object::ObjectFile *obj,
+                       int *perr,
+                       llvm::StringRef *result)
 {
   // Walk sections
   for (llvm::object::section_iterator si = obj->section_begin(),
@@ -69,67 +88,411 @@ readExportDataFromObject(llvm::object::ObjectFile *obj,
       break;
     if (sname == GO_EXPORT_SECTION_NAME) {
       // Extract section of interest
-      llvm::StringRef bytes;
-      if (sref.getContents(bytes)) {
+      if (sref.getContents(*result)) {
         *perr = errno;
         return "get section contents";
       }
-      char *buf = new char[bytes.size()];
-      if (! buf) {
-        *perr = errno;
-        return "malloc";
-      }
-      memcpy(buf, bytes.data(), bytes.size());
-      *pbuf = buf;
-      *plen = bytes.size();
       return nullptr;
     }
   }
   return nullptr;
 }
 
+// Objects compiled with -flto=thin are LLVM bitcode files. In that
+// case the export data is found in the module inline asm, in the
+// form emitted by Llvm_backend::write_export_data (a series of
+// ".ascii" directives following a ".section" directive for the
+// export section); here we undo the escaping applied there. Only the
+// module header is read, not the function bodies.
+
 static const char *
-readExportDataFromArchive(llvm::object::Archive *archive,
-                          off_t offset,
-                          int *perr,
-                          char **pbuf,
-                          size_t *plen)
+findExportDataInBitcode(llvm::MemoryBufferRef mbref,
+                        int *perr,
+                        std::string *result)
 {
-  llvm::Error err = llvm::Error::success();
+  llvm::LLVMContext context;
+  llvm::Expected<std::unique_ptr<llvm::Module>> modOrErr =
+      llvm::getLazyBitcodeModule(mbref, context);
+  if (!modOrErr) {
+    consumeError(modOrErr.takeError());
+    return nullptr; // ignore, as for unrecognized objects
+  }
 
-  // The gofrontend archive reader passes in an offset that points
-  // past the the archive member header, whereas the llvm::object::Archive
-  // code considers "child offset" to be the start of the region in the
-  // archive at the point of the member header. Adjust accordingly.
-  assert(!offset || offset > ARCHIVE_MEMBER_HEADER_SIZE);
-  uint64_t uoffset = static_cast<uint64_t>(offset) -
-      ARCHIVE_MEMBER_HEADER_SIZE;
-  for (auto &child : archive->children(err)) {
-    if (err)
-      return "unable to open as archive";
-    if (child.getChildOffset() != uoffset)
+  std::string &bytes = *result;
+  bool inSection = false;
+  llvm::StringRef rest((*modOrErr)->getModuleInlineAsm());
+  while (!rest.empty()) {
+    std::pair<llvm::StringRef, llvm::StringRef> split = rest.split('\n');
+    llvm::StringRef line = split.first.ltrim();
+    rest = split.second;
+    if (line.startswith(".section")) {
+      inSection = line.contains("\"" GO_EXPORT_SECTION_NAME "\"");
       continue;
-    // found.
-    llvm::Expected<std::unique_ptr<llvm::object::Binary>> childOrErr =
-        child.getAsBinary();
-    if (auto err = childOrErr.takeError()) {
-      // Ignore error if this is not recognized as an object file.
-      // This is also what gccgo does (go-backend.c:go_read_export_data).
-      // In particular, cgo archive may contain _cgo_flags as a member,
-      // which is not an object file.
-      consumeError(std::move(err));
-      return nullptr;
     }
-    llvm::object::ObjectFile *o =
-        llvm::dyn_cast<llvm::object::ObjectFile>(&*childOrErr.get());
-    if (o)
-      return readExportDataFromObject(o, perr, pbuf, plen);
+    if (line.startswith(".text")) {
+      inSection = false;
+      continue;
+    }
+    if (!inSection || !line.consume_front(".ascii"))
+      continue;
+    line = line.trim();
+    if (line.size() < 2 || line.front() != '"' || line.back() != '"') {
+      *perr = 0;
+      return "malformed export data in bitcode";
+    }
+    line = line.drop_front().drop_back();
+    for (size_t idx = 0; idx < line.size(); ++idx) {
+      char c = line[idx];
+      if (c != '\\' || idx + 1 == line.size()) {
+        bytes.push_back(c);
+        continue;
+      }
+      c = line[++idx];
+      if (c == 'n')
+        bytes.push_back('\n');
+      else if (c == '0' && line.substr(idx, 3) == "000") {
+        bytes.push_back('\0');
+        idx += 2;
+      } else
+        bytes.push_back(c);
+    }
   }
+  return nullptr;
+}
+
+namespace {
+
+// Export data reads are cached per process. The front end typically
+// asks for the export data of many members of the same archive (and
+// may come back to the same file more than once), so each file is
+// indexed once: the first time it is read, it is mapped into memory,
+// the export data of every object in it is located, and the mapping
+// is dropped again. What is kept is only where each object's export
+// data lives in the file. Entries are keyed by file identity
+// (device/inode) together with the size and modification time of the
+// file, so a file that has been rewritten gets a fresh entry instead
+// of a stale index.
+
+class ExportDataFile {
+ public:
+  // Where the export data of one object is found: a region of the
+  // file, or (for bitcode objects, where it has to be decoded) a
+  // string owned by the entry.
+  struct Location {
+    uint64_t fileOffset;
+    uint64_t size;
+    const std::string *decoded;
+  };
+
+  // Map and index the file open on the specified descriptor. Returns
+  // null if the file can't be read.
+  static std::unique_ptr<ExportDataFile> create(int fd, uint64_t size);
+
+  // Look up the export data for the object at the specified offset
+  // (zero for a standalone object, else the offset of the archive
+  // member's contents). A null result means there is no export data.
+  const char *lookup(off_t offset, int *perr, const Location **result) const;
+
+  // Bytes of decoded export data held by this entry.
+  uint64_t ownedBytes() const { return ownedBytes_; }
 
-  if (err)
+ private:
+  ExportDataFile() : ownedBytes_(0), archiveError_(false) { }
+
+  void indexObject(uint64_t offset, llvm::MemoryBufferRef mbref,
+                   llvm::StringRef file);
+
+  struct Entry {
+    Location loc;
+    const char *errmsg;
+    int err;
+  };
+  // Object offset -> export data.
+  std::unordered_map<uint64_t, Entry> exportData_;
+  // Storage for export data that doesn't live in the file as is.
+  std::list<std::string> ownedData_;
+  uint64_t ownedBytes_;
+  // Set if the file looks like an archive but can't be read as one.
+  bool archiveError_;
+};
+
+} // namespace
+
+void ExportDataFile::indexObject(uint64_t offset,
+                                 llvm::MemoryBufferRef mbref,
+                                 llvm::StringRef file)
+{
+  Entry &entry = exportData_[offset];
+  entry = { { 0, 0, nullptr }, nullptr, 0 };
+
+  // Bitcode (ThinLTO) object?
+  if (llvm::identify_magic(mbref.getBuffer()) == llvm::file_magic::bitcode) {
+    std::string bytes;
+    entry.errmsg = findExportDataInBitcode(mbref, &entry.err, &bytes);
+    if (entry.errmsg || bytes.empty())
+      return;
+    ownedBytes_ += bytes.size();
+    ownedData_.push_back(std::move(bytes));
+    entry.loc.decoded = &ownedData_.back();
+    entry.loc.size = ownedData_.back().size();
+    return;
+  }
+
+  llvm::Expected<std::unique_ptr<llvm::object::ObjectFile>> objOrErr =
+      llvm::object::ObjectFile::createObjectFile(mbref);
+  if (!objOrErr) {
+    // Ignore error if this is not recognized as an object file.
+    // This is also what gccgo does (go-backend.c:go_read_export_data).
+    // In particular, cgo archive may contain _cgo_flags as a member,
+    // which is not an object file.
+    consumeError(objOrErr.takeError());
+    return;
+  }
+  llvm::StringRef bytes;
+  entry.errmsg = findExportDataInObject(objOrErr->get(), &entry.err, &bytes);
+  if (entry.errmsg || bytes.empty())
+    return;
+  if (bytes.begin() >= file.begin() && bytes.end() <= file.end()) {
+    entry.loc.fileOffset = bytes.begin() - file.begin();
+    entry.loc.size = bytes.size();
+    return;
+  }
+  // Not expected for the object formats we read, but keep a copy
+  // rather than lose the data if the section contents don't point
+  // into the file.
+  ownedBytes_ += bytes.size();
+  ownedData_.push_back(bytes.str());
+  entry.loc.decoded = &ownedData_.back();
+  entry.loc.size = bytes.size();
+}
+
+std::unique_ptr<ExportDataFile> ExportDataFile::create(int fd, uint64_t size)
+{
+  // Create memory buffer for this file descriptor. This will mmap
+  // the file unless it is small. The buffer is only needed while
+  // indexing.
+  auto BuffOrErr = llvm::MemoryBuffer::getOpenFile(fd, "", size,
+                                                   /*RequiresNullTerminator=*/
+                                                   false);
+  if (! BuffOrErr)
+    return nullptr;
+  llvm::MemoryBufferRef mbref = BuffOrErr.get()->getMemBufferRef();
+  llvm::StringRef file = mbref.getBuffer();
+
+  std::unique_ptr<ExportDataFile> edf(new ExportDataFile());
+  if (llvm::identify_magic(file) != llvm::file_magic::archive) {
+    edf->indexObject(0, mbref, file);
+    return edf;
+  }
+
+  llvm::Expected<std::unique_ptr<llvm::object::Archive>> archiveOrErr =
+      llvm::object::Archive::create(mbref);
+  if (!archiveOrErr) {
+    consumeError(archiveOrErr.takeError());
+    edf->archiveError_ = true;
+    return edf;
+  }
+  llvm::Error err = llvm::Error::success();
+  for (auto &child : archiveOrErr.get()->children(err)) {
+    llvm::Expected<llvm::MemoryBufferRef> memberOrErr =
+        child.getMemoryBufferRef();
+    if (!memberOrErr) {
+      consumeError(memberOrErr.takeError());
+      continue;
+    }
+    // The gofrontend archive reader passes in an offset that points
+    // past the the archive member header, whereas the llvm::object::Archive
+    // code considers "child offset" to be the start of the region in the
+    // archive at the point of the member header. Adjust accordingly.
+    edf->indexObject(child.getChildOffset() + ARCHIVE_MEMBER_HEADER_SIZE,
+                     *memberOrErr, file);
+  }
+  if (err) {
+    consumeError(std::move(err));
+    edf->archiveError_ = true;
+  }
+  return edf;
+}
+
+const char *ExportDataFile::lookup(off_t offset,
+                                   int *perr,
+                                   const Location **result) const
+{
+  *result = nullptr;
+  if (archiveError_)
     return "unable to open as archive";
-  else
+  auto it = exportData_.find(static_cast<uint64_t>(offset));
+  if (it == exportData_.end())
+    return nullptr;
+  if (it->second.errmsg) {
+    *perr = it->second.err;
+    return it->second.errmsg;
+  }
+  if (it->second.loc.size)
+    *result = &it->second.loc;
+  return nullptr;
+}
+
+// Return the path of the file open on the specified descriptor, where
+// the system provides a way to find it. This is only used to tell the
+// compile server which files to preload, so it is fine to give up.
+
+static bool pathForFd(int fd, std::string *path)
+{
+#if defined(__linux__)
+  char buf[PATH_MAX];
+  std::string fdpath = "/proc/self/fd/" + std::to_string(fd);
+  ssize_t len = ::readlink(fdpath.c_str(), buf, sizeof(buf));
+  if (len <= 0 || len >= (ssize_t) sizeof(buf))
+    return false;
+  path->assign(buf, len);
+  return true;
+#elif defined(F_GETPATH)
+  char buf[PATH_MAX];
+  if (::fcntl(fd, F_GETPATH, buf) < 0)
+    return false;
+  *path = buf;
+  return true;
+#else
+  return false;
+#endif
+}
+
+namespace {
+
+struct ExportDataKey {
+  llvm::sys::fs::UniqueID id;
+  uint64_t size;
+  llvm::sys::TimePoint<> modTime;
+
+  bool operator<(const ExportDataKey &other) const {
+    return std::tie(id, size, modTime) <
+        std::tie(other.id, other.size, other.modTime);
+  }
+};
+
+// The cache is bounded both in number of files and in bytes of decoded
+// export data held, since a long-lived process (the compile server,
+// for instance) would otherwise accumulate an entry for every file it
+// has ever imported. The least recently used files are dropped first.
+
+class ExportDataCache {
+ public:
+  ExportDataCache() : ownedBytes_(0), hits_(0), misses_(0) { }
+
+  // Return the entry for the file open on the specified descriptor,
+  // indexing the file if needed. Returns null if the file can't be
+  // read. Unless 'preloading' is set, the path of a newly indexed file
+  // is recorded for newPaths().
+  ExportDataFile *get(int fd, bool preloading = false);
+
+  // Paths of the files read by this process (see go_export_data_paths).
+  const std::vector<std::string> &newPaths() const { return newPaths_; }
+
+  // Number of lookups (other than preloads) that found the file
+  // already in the cache, and number that had to read it.
+  unsigned hits() const { return hits_; }
+  unsigned misses() const { return misses_; }
+
+ private:
+  void dropStaleVersions(const llvm::sys::fs::UniqueID &id);
+  void evict();
+
+  typedef std::list<std::pair<ExportDataKey,
+                              std::unique_ptr<ExportDataFile>>> EntryList;
+  EntryList entries_; // most recently used first
+  std::map<ExportDataKey, EntryList::iterator> index_;
+  uint64_t ownedBytes_;
+  std::vector<std::string> newPaths_;
+  unsigned hits_;
+  unsigned misses_;
+};
+
+} // namespace
+
+void ExportDataCache::dropStaleVersions(const llvm::sys::fs::UniqueID &id)
+{
+  ExportDataKey lo = { id, 0, llvm::sys::TimePoint<>::min() };
+  auto it = index_.lower_bound(lo);
+  while (it != index_.end() && it->first.id == id) {
+    ownedBytes_ -= it->second->second->ownedBytes();
+    entries_.erase(it->second);
+    it = index_.erase(it);
+  }
+}
+
+void ExportDataCache::evict()
+{
+  // Never drop the entry just added (at the front).
+  while (entries_.size() > 1 &&
+         (entries_.size() > GO_EXPORT_DATA_CACHE_MAX_FILES ||
+          ownedBytes_ > GO_EXPORT_DATA_CACHE_MAX_BYTES)) {
+    ownedBytes_ -= entries_.back().second->ownedBytes();
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+ExportDataFile *ExportDataCache::get(int fd, bool preloading)
+{
+  llvm::sys::fs::file_status st;
+  if (llvm::sys::fs::status(fd, st))
     return nullptr;
+
+  ExportDataKey key = { st.getUniqueID(), st.getSize(),
+                        st.getLastModificationTime() };
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    if (!preloading)
+      hits_++;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return entries_.front().second.get();
+  }
+  if (!preloading)
+    misses_++;
+  dropStaleVersions(key.id);
+
+  std::unique_ptr<ExportDataFile> edf =
+      ExportDataFile::create(fd, st.getSize());
+  if (! edf)
+    return nullptr;
+  std::string path;
+  if (!preloading && pathForFd(fd, &path)) {
+    // Only report the path if it still names this file.
+    llvm::sys::fs::file_status pst;
+    if (!llvm::sys::fs::status(path, pst) &&
+        pst.getUniqueID() == key.id)
+      newPaths_.push_back(path);
+  }
+  ownedBytes_ += edf->ownedBytes();
+  entries_.emplace_front(key, std::move(edf));
+  index_[key] = entries_.begin();
+  evict();
+  return entries_.front().second.get();
+}
+
+static std::mutex exportDataCacheMutex;
+static ExportDataCache exportDataCache;
+
+// Read 'len' bytes at 'offset' in the file open on 'fd' into 'buf'.
+// Returns false on error or if the file is shorter than expected.
+
+static bool readAt(int fd, char *buf, uint64_t len, uint64_t offset)
+{
+  while (len) {
+    ssize_t n = ::pread(fd, buf, len, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      if (n == 0)
+        errno = 0;
+      return false;
+    }
+    buf += n;
+    len -= n;
+    offset += n;
+  }
+  return true;
 }
 
 /* The go_read_export_data function is called by the Go frontend
@@ -150,33 +513,85 @@ go_read_export_data (int fd, off_t offset, char **pbuf, size_t *plen,
   *pbuf = NULL;
   *plen = 0;
 
-  // Create memory buffer for this file descriptor
-  auto BuffOrErr = llvm::MemoryBuffer::getOpenFile(fd, "", -1);
-  if (! BuffOrErr)
-    return nullptr; // ignore this error
-  std::unique_ptr<llvm::MemoryBuffer> Buffer = std::move(BuffOrErr.get());
-
-  // Examine buffer as binary
-  llvm::Expected<std::unique_ptr<llvm::object::Binary>> BinOrErr =
-      llvm::object::createBinary(Buffer->getMemBufferRef());
-  if (!BinOrErr)
-    return nullptr; // also ignore here
-  std::unique_ptr<llvm::object::Binary> Binary = std::move(BinOrErr.get());
-
-  // Examine binary as archive
-  if (llvm::object::Archive *a =
-      llvm::dyn_cast<llvm::object::Archive>(Binary.get()))
-    return readExportDataFromArchive(a, offset, perr, pbuf, plen);
-
-  // Examine binary as object
-  llvm::object::ObjectFile *o =
-      llvm::dyn_cast<llvm::object::ObjectFile>(Binary.get());
-  if (o)
-    return readExportDataFromObject(o, perr, pbuf, plen);
+  ExportDataFile::Location loc;
+  {
+    std::lock_guard<std::mutex> lock(exportDataCacheMutex);
+    ExportDataFile *edf = exportDataCache.get(fd);
+    if (! edf)
+      return nullptr; // ignore this error
+
+    const ExportDataFile::Location *lp;
+    if (const char *errmsg = edf->lookup(offset, perr, &lp))
+      return errmsg;
+    if (! lp)
+      return nullptr;
+    loc = *lp;
 
+    // Decoded export data belongs to the cache entry, which may be
+    // evicted once the lock is dropped, so it is copied out here.
+    if (loc.decoded) {
+      char *buf = new char[loc.size];
+      memcpy(buf, loc.decoded->data(), loc.size);
+      *pbuf = buf;
+      *plen = loc.size;
+      return nullptr;
+    }
+  }
+
+  // The front end takes ownership of (and eventually deletes) the
+  // buffer, so it can't be handed a view of a shared mapping. Instead
+  // the export data is read from the file straight into the buffer,
+  // outside the cache lock; the entry was just matched against the
+  // file's current size and modification time.
+  char *buf = new char[loc.size];
+  if (! readAt(fd, buf, loc.size, loc.fileOffset)) {
+    *perr = errno;
+    delete[] buf;
+    return "read export data";
+  }
+  *pbuf = buf;
+  *plen = loc.size;
   return nullptr;
 }
 
+// Returns the paths of the files that export data was read from by
+// this process. The compile server uses this to preload the files a
+// compile imported, for the benefit of later compiles.
+
+void
+go_export_data_paths (std::vector<std::string> *paths)
+{
+  std::lock_guard<std::mutex> lock(exportDataCacheMutex);
+  *paths = exportDataCache.newPaths();
+}
+
+// Returns the number of export data reads by this process that found
+// the file already in the cache (for instance, preloaded by the
+// compile server before this process was forked), and the number that
+// had to read the file.
+
+void
+go_export_data_cache_stats (unsigned *hits, unsigned *misses)
+{
+  std::lock_guard<std::mutex> lock(exportDataCacheMutex);
+  *hits = exportDataCache.hits();
+  *misses = exportDataCache.misses();
+}
+
+// Index the export data in the specified file ahead of time, so that
+// processes forked afterwards find it in the cache.
+
+void
+go_preload_export_data (const char *path)
+{
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  std::lock_guard<std::mutex> lock(exportDataCacheMutex);
+  exportDataCache.get(fd, /*preloading=*/ true);
+  ::close(fd);
+}
+
 const char *lbasename(const char *path)
 {
   // TODO: add windows support
@@ -0,0 +1,25 @@
+//===-- go-export-data.h - export data cache routines ---------------------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Routines for inspecting and warming the bridge's export data cache
+// (see go_read_export_data). Used by the driver's compile server; not
+// part of the interface seen by gofrontend.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GO_EXPORT_DATA_H
+#define GO_EXPORT_DATA_H
+
+#include <string>
+#include <vector>
+
+extern void go_export_data_paths(std::vector<std::string> *);
+extern void go_preload_export_data(const char *);
+extern void go_export_data_cache_stats(unsigned *, unsigned *);
+
+#endif // !defined(GO_EXPORT_DATA_H)
@@ -31,11 +31,12 @@ bool Binstructions::isValidInst(llvm::Instruction *inst)
   return true;
 }
 
-Bexpression::Bexpression(NodeFlavor fl, const std::vector<Bnode *> &kids,
+Bexpression::Bexpression(NodeFlavor fl, llvm::ArrayRef<Bnode *> kids,
                          llvm::Value *val, Btype *typ, Location loc)
     : Bnode(fl, kids, loc)
     , value_(val)
     , btype_(typ)
+    , moduleScope_(false)
 {
 }
 
@@ -45,6 +46,7 @@ Bexpression::Bexpression(const Bexpression &src)
     , value_(src.value_)
     , btype_(src.btype_)
     , varContext_(src.varContext_)
+    , moduleScope_(false)
 {
 }
 
@@ -35,17 +35,17 @@ class BnodeBuilder;
 class Binstructions {
 public:
   Binstructions() {}
-  explicit Binstructions(const std::vector<llvm::Instruction *> &instructions)
-      : instructions_(instructions) {}
+  explicit Binstructions(llvm::ArrayRef<llvm::Instruction *> instructions)
+      : instructions_(instructions.begin(), instructions.end()) {}
 
-  const std::vector<llvm::Instruction *> &instructions() const {
+  llvm::ArrayRef<llvm::Instruction *> instructions() const {
     return instructions_;
   }
   void appendInstruction(llvm::Instruction *inst) {
     assert(isValidInst(inst));
     instructions_.push_back(inst);
   }
-  void appendInstructions(const std::vector<llvm::Instruction *> &ilist) {
+  void appendInstructions(llvm::ArrayRef<llvm::Instruction *> ilist) {
     for (auto inst : ilist) {
       assert(isValidInst(inst));
       instructions_.push_back(inst);
@@ -55,7 +55,7 @@ public:
   void clear() { instructions_.clear(); }
 
 private:
-  std::vector<llvm::Instruction *> instructions_;
+  llvm::SmallVector<llvm::Instruction *, 2> instructions_;
 
   // Certain classes of instructions should not be hanging off a
   // Bexpression -- they should only appear in a function prolog.
@@ -198,6 +198,13 @@ class Bexpression : public Bnode, public Binstructions {
   // True implies the underlying llvm::Value is llvm::Constant.
   bool isConstant();
 
+  // Return whether the expression is owned at module scope (cached by
+  // Llvm_backend::makeGlobalExpression) as opposed to belonging to a
+  // single tree. Such expressions can appear in any number of trees,
+  // and are never released along with one of them.
+  bool moduleScope() const { return moduleScope_; }
+  void setModuleScope() { moduleScope_ = true; }
+
   // debugging
   void dumpInstructions(llvm::raw_ostream &os, unsigned ilevel,
                         Llvm_linemap *linemap, bool terse) const;
@@ -208,7 +215,7 @@ class Bexpression : public Bnode, public Binstructions {
   friend class BnodeBuilder;
 
  private:
-  Bexpression(NodeFlavor fl, const std::vector<Bnode *> &kids,
+  Bexpression(NodeFlavor fl, llvm::ArrayRef<Bnode *> kids,
               llvm::Value *val, Btype *typ, Location loc);
   Bexpression(const Bexpression &src);
   void setValue(llvm::Value *val);
@@ -217,6 +224,7 @@ class Bexpression : public Bnode, public Binstructions {
   Btype *btype_;
   std::string tag_;
   VarContext varContext_;
+  bool moduleScope_;
 };
 
 #endif // LLVMGOFRONTEND_GO_LLVM_BEXPRESSION_H
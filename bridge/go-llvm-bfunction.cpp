@@ -34,7 +34,7 @@ Bfunction::Bfunction(llvm::Constant *fcnValue,
                      TypeManager *tm)
 
     : fcnType_(fcnType), fcnValue_(fcnValue),
-      abiOracle_(new CABIOracle(fcnType, tm)),
+      abiOracle_(tm->abiOracle(fcnType)),
       rtnValueMem_(nullptr), chainVal_(nullptr),
       paramsRegistered_(0), name_(name), asmName_(asmName),
       location_(location), splitStack_(YesSplit),
@@ -71,7 +71,7 @@ llvm::Function *Bfunction::function() const
 
 std::string Bfunction::namegen(const std::string &tag)
 {
-  return abiOracle_->tm()->tnamegen(tag);
+  return abiOracle_->tm()->vnamegen(tag);
 }
 
 llvm::Instruction *Bfunction::addAlloca(llvm::Type *typ,
@@ -102,6 +102,9 @@ void Bfunction::lazyAbiSetup()
     std::string sretname(namegen("sret.formal"));
     arguments_[argIdx]->setName(sretname);
     arguments_[argIdx]->addAttr(llvm::Attribute::StructRet);
+    llvm::Type *rt = arguments_[argIdx]->getType()->getPointerElementType();
+    llvm::AttrBuilder ab = abiOracle_->tm()->validPointerAttributes(rt);
+    arguments_[argIdx]->addAttrs(ab);
     rtnValueMem_ = arguments_[argIdx];
     argIdx += 1;
   }
@@ -273,7 +276,9 @@ llvm::Value *Bfunction::createTemporary(Btype *btype, const std::string &tag)
 
 llvm::Value *Bfunction::createTemporary(llvm::Type *typ, const std::string &tag)
 {
-  return addAlloca(typ, tag);
+  llvm::Instruction *inst = addAlloca(typ, tag);
+  temporaries_.insert(inst);
+  return inst;
 }
 
 // This implementation uses an alloca instruction as a placeholder
@@ -126,6 +126,11 @@ public:
   llvm::Value *createTemporary(Btype *btype, const std::string &tag);
   llvm::Value *createTemporary(llvm::Type *type, const std::string &tag);
 
+  // Returns true if 'val' is an alloca made by createTemporary.
+  bool isTemporary(llvm::Value *val) const {
+    return temporaries_.count(val) != 0;
+  }
+
   // If the function return value is passing via memory instead of
   // directly, this function returns the location into which the
   // return has to go. Returns NULL if no return or direct return.
@@ -172,13 +177,17 @@ public:
   // Function value for this Bfunction (either llvm::Function or bitcast)
   llvm::Constant *fcnValue_;
 
-  // C ABI oracle for the function
-  std::unique_ptr<CABIOracle> abiOracle_;
+  // C ABI oracle for the function (owned by the type manager)
+  const CABIOracle *abiOracle_;
 
   // This includes all alloca's created for the function, including
   // local variables, temp vars, and spill locations for formal params.
   std::vector<llvm::Instruction *> allocas_;
 
+  // Subset of the above created via createTemporary (ex: storage for
+  // call results returned in memory).
+  std::set<llvm::Value *> temporaries_;
+
   // Label address placeholders. To be deleted prior to finalization
   // of control flow for the function.
   std::set<llvm::Instruction *> labelAddressPlaceholders_;
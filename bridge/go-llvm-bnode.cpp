@@ -68,8 +68,8 @@ static BnodePropVals BnodeProperties[] = {
   /* N_SwitchStmt */    {  "switch", Variadic, IsStmt }
 };
 
-Bnode::Bnode(NodeFlavor flavor, const std::vector<Bnode *> &kids, Location loc)
-    : kids_(kids)
+Bnode::Bnode(NodeFlavor flavor, llvm::ArrayRef<Bnode *> kids, Location loc)
+    : kids_(kids.begin(), kids.end())
     , location_(loc)
     , flavor_(flavor)
     , id_(0xfeedface)
@@ -84,7 +84,7 @@ Bnode::Bnode(const Bnode &src)
     : location_(src.location_)
     , flavor_(src.flavor_)
     , id_(0xfeedface)
-    , flags_(0)
+    , flags_(src.flags_)
 {
   assert(! isStmt());
   memcpy(&u, &src.u, sizeof(u));
@@ -345,6 +345,12 @@ unsigned Bnode::fieldIndex() const
   return u.fieldIndex;
 }
 
+bool Bnode::knownValid() const
+{
+  assert(flavor() == N_Deref);
+  return (flags_ & KnownValidFlag) != 0;
+}
+
 Bfunction *Bnode::getFunction() const
 {
   assert(flavor() == N_FcnAddress ||
@@ -372,6 +378,11 @@ int Bnode::getIndices() const
 BnodeBuilder::BnodeBuilder(Llvm_backend *be)
     : integrityVisitor_(new IntegrityVisitor(be, TreeIntegCtl(DumpPointers, DontReportRepairableSharing, IncrementalMode)))
     , checkIntegrity_(true)
+    , clonedNodes_(0)
+    , reusedConstants_(0)
+    , recycledNodes_(0)
+    , liveNodes_(0)
+    , peakLiveNodes_(0)
 {
 }
 
@@ -395,7 +406,7 @@ BnodeBuilder::~BnodeBuilder()
           todel.push_back(inst);
         }
       }
-      delete expr;
+      expr->~Bexpression();
     }
   }
   for (auto inst : todel)
@@ -412,7 +423,7 @@ void BnodeBuilder::freeStmts()
 {
   for (auto &stmt : sarchive_) {
     if (stmt)
-      delete stmt;
+      stmt->~Bstatement();
   }
   sarchive_.clear();
   for (auto &c : swcases_)
@@ -423,18 +434,61 @@ void BnodeBuilder::freeStmts()
 void BnodeBuilder::freeNode(Bnode *node)
 {
   assert(node);
+  size_t size;
   Bexpression *expr = node->castToBexpression();
   if (expr) {
     earchive_[expr->id()] = nullptr;
     if (expr->id() == earchive_.size()-1)
       earchive_.pop_back();
-    delete expr;
+    size = sizeof(Bexpression);
+    expr->~Bexpression();
   } else {
     Bstatement *stmt = node->castToBstatement();
     sarchive_[stmt->id()] = nullptr;
     if (stmt->id() == sarchive_.size()-1)
       sarchive_.pop_back();
-    delete stmt;
+    size = (stmt->castToBblock() ? sizeof(Bblock) : sizeof(Bstatement));
+    stmt->~Bstatement();
+  }
+  freeNodes_[size].push_back(node);
+  liveNodes_ -= 1;
+}
+
+void BnodeBuilder::releaseLoweredTree(Bstatement *root)
+{
+  std::set<Bnode *> visited;
+  std::vector<Bnode *> worklist;
+  worklist.push_back(root);
+  while (!worklist.empty()) {
+    Bnode *node = worklist.back();
+    worklist.pop_back();
+    if (node->flavor() == N_Error || !visited.insert(node).second)
+      continue;
+    Bexpression *expr = node->castToBexpression();
+    if (expr && (expr->moduleScope() ||
+                 (expr->value() &&
+                  !llvm::isa<llvm::Instruction>(expr->value()))))
+      continue;
+    unsigned idx = 0;
+    for (auto &kid : node->kids_) {
+      integrityVisitor_->unsetParent(kid, node, idx++);
+      worklist.push_back(kid);
+    }
+    if (expr) {
+      // Instructions will normally have been moved into a basic block
+      // by this point; any that weren't are dead.
+      idx = 0;
+      for (auto inst : expr->instructions()) {
+        integrityVisitor_->unsetParent(inst, expr, idx++);
+        if (!inst->getParent()) {
+          inst->dropAllReferences();
+          recordDeadInstruction(inst);
+        }
+      }
+      expr->clear();
+    }
+    integrityVisitor_->deletePending(node);
+    freeNode(node);
   }
 }
 
@@ -446,6 +500,28 @@ void BnodeBuilder::checkTreeInteg(Bnode *node)
   }
 }
 
+// Allocate and construct a node of type T, reusing the storage of a
+// previously freed node of the same size if there is one. Nodes
+// allocated this way must be released via freeNode (or at
+// builder teardown), never by 'delete'.
+
+template<class T, class... Args>
+T *BnodeBuilder::newNode(Args&&... args)
+{
+  void *mem;
+  auto it = freeNodes_.find(sizeof(T));
+  if (it != freeNodes_.end() && !it->second.empty()) {
+    mem = it->second.back();
+    it->second.pop_back();
+    recycledNodes_ += 1;
+  } else {
+    mem = nodeArena_.Allocate(sizeof(T), alignof(T));
+  }
+  liveNodes_ += 1;
+  peakLiveNodes_ = std::max(peakLiveNodes_, liveNodes_);
+  return new (mem) T(std::forward<Args>(args)...);
+}
+
 Bexpression *BnodeBuilder::archive(Bexpression *expr)
 {
   expr->id_ = earchive_.size();
@@ -470,36 +546,36 @@ Bblock *BnodeBuilder::archive(Bblock *bb)
 
 Bexpression *BnodeBuilder::mkError(Btype *errortype)
 {
-  std::vector<Bnode *> kids;
+  llvm::ArrayRef<Bnode *> kids;
   Location loc;
   llvm::Value *noval = nullptr;
-  return archive(new Bexpression(N_Error, kids, noval, errortype, loc));
+  return archive(newNode<Bexpression>(N_Error, kids, noval, errortype, loc));
 }
 
 Bexpression *BnodeBuilder::mkConst(Btype *btype, llvm::Value *value)
 {
   assert(btype);
   assert(value);
-  std::vector<Bnode *> kids;
+  llvm::ArrayRef<Bnode *> kids;
   Location loc;
-  return archive(new Bexpression(N_Const, kids, value, btype, loc));
+  return archive(newNode<Bexpression>(N_Const, kids, value, btype, loc));
 }
 
 Bexpression *BnodeBuilder::mkVoidValue(Btype *btype)
 {
   assert(btype);
-  std::vector<Bnode *> kids;
+  llvm::ArrayRef<Bnode *> kids;
   Location loc;
-  return archive(new Bexpression(N_Const, kids, nullptr, btype, loc));
+  return archive(newNode<Bexpression>(N_Const, kids, nullptr, btype, loc));
 }
 
 Bexpression *BnodeBuilder::mkVar(Bvariable *var, llvm::Value *val, Location loc)
 {
   assert(var);
   Btype *vt = var->btype();
-  std::vector<Bnode *> kids;
+  llvm::ArrayRef<Bnode *> kids;
   Bexpression *rval =
-      new Bexpression(N_Var, kids, val, vt, loc);
+      newNode<Bexpression>(N_Var, kids, val, vt, loc);
   rval->u.var = var;
   return archive(rval);
 }
@@ -557,9 +633,9 @@ Bexpression *BnodeBuilder::mkBinaryOp(Operator op, Btype *typ, llvm::Value *val,
 {
   assert(left);
   assert(right);
-  std::vector<Bnode *> kids = { left, right };
+  Bnode *kids[] = { left, right };
   Bexpression *rval =
-      new Bexpression(N_BinaryOp, kids, val, typ, loc);
+      newNode<Bexpression>(N_BinaryOp, kids, val, typ, loc);
   if (val)
     appendInstIfNeeded(rval, val);
   rval->u.op = op;
@@ -572,9 +648,9 @@ Bexpression *BnodeBuilder::mkBinaryOp(Operator op, Btype *typ, llvm::Value *val,
 {
   assert(left);
   assert(right);
-  std::vector<Bnode *> kids = { left, right };
+  Bnode *kids[] = { left, right };
   Bexpression *rval =
-      new Bexpression(N_BinaryOp, kids, val, typ, loc);
+      newNode<Bexpression>(N_BinaryOp, kids, val, typ, loc);
   for (auto &inst : instructions.instructions())
     rval->appendInstruction(inst);
   rval->u.op = op;
@@ -585,9 +661,9 @@ Bexpression *BnodeBuilder::mkUnaryOp(Operator op, Btype *typ, llvm::Value *val,
                                      Bexpression *src, Location loc)
 {
   assert(src);
-  std::vector<Bnode *> kids = { src };
+  Bnode *kids[] = { src };
   Bexpression *rval =
-      new Bexpression(N_UnaryOp, kids, val, typ, loc);
+      newNode<Bexpression>(N_UnaryOp, kids, val, typ, loc);
   rval->u.op = op;
   appendInstIfNeeded(rval, val);
   return archive(rval);
@@ -596,9 +672,9 @@ Bexpression *BnodeBuilder::mkUnaryOp(Operator op, Btype *typ, llvm::Value *val,
 Bexpression *BnodeBuilder::mkConversion(Btype *typ, llvm::Value *val,
                                         Bexpression *src, Location loc)
 {
-  std::vector<Bnode *> kids = { src };
+  Bnode *kids[] = { src };
   Bexpression *rval =
-      new Bexpression(N_Conversion, kids, val, typ, loc);
+      newNode<Bexpression>(N_Conversion, kids, val, typ, loc);
   appendInstIfNeeded(rval, val);
   return archive(rval);
 }
@@ -606,16 +682,16 @@ Bexpression *BnodeBuilder::mkConversion(Btype *typ, llvm::Value *val,
 Bexpression *BnodeBuilder::mkAddress(Btype *typ, llvm::Value *val,
                                      Bexpression *src, Location loc)
 {
-  std::vector<Bnode *> kids = { src };
-  Bexpression *rval = new Bexpression(N_Address, kids, val, typ, loc);
+  Bnode *kids[] = { src };
+  Bexpression *rval = newNode<Bexpression>(N_Address, kids, val, typ, loc);
   return archive(rval);
 }
 
 Bexpression *BnodeBuilder::mkFcnAddress(Btype *typ, llvm::Value *val,
                                         Bfunction *func, Location loc)
 {
-  std::vector<Bnode *> kids;
-  Bexpression *rval = new Bexpression(N_FcnAddress, kids, val, typ, loc);
+  llvm::ArrayRef<Bnode *> kids;
+  Bexpression *rval = newNode<Bexpression>(N_FcnAddress, kids, val, typ, loc);
   rval->u.func = func;
   return archive(rval);
 }
@@ -625,17 +701,20 @@ Bexpression *BnodeBuilder::mkLabelAddress(Btype *typ,
                                           Blabel *label,
                                           Location loc)
 {
-  std::vector<Bnode *> kids;
-  Bexpression *rval = new Bexpression(N_LabelAddress, kids, val, typ, loc);
+  llvm::ArrayRef<Bnode *> kids;
+  Bexpression *rval = newNode<Bexpression>(N_LabelAddress, kids, val, typ, loc);
   rval->u.label = label;
   return archive(rval);
 }
 
 Bexpression *BnodeBuilder::mkDeref(Btype *typ, llvm::Value *val,
-                                   Bexpression *src, Location loc)
+                                   Bexpression *src, Location loc,
+                                   bool knownValid)
 {
-  std::vector<Bnode *> kids = { src };
-  Bexpression *rval = new Bexpression(N_Deref, kids, val, typ, loc);
+  Bnode *kids[] = { src };
+  Bexpression *rval = newNode<Bexpression>(N_Deref, kids, val, typ, loc);
+  if (knownValid)
+    rval->flags_ |= Bnode::KnownValidFlag;
   return archive(rval);
 }
 
@@ -647,11 +726,11 @@ BnodeBuilder::mkIndexedComposite(Btype *btype,
                                  Binstructions &instructions,
                                  Location loc)
 {
-  std::vector<Bnode *> kids;
+  llvm::SmallVector<Bnode *, 8> kids;
   for (auto &v : vals)
     kids.push_back(v);
   Bexpression *rval =
-      new Bexpression(N_Composite, kids, value, btype, loc);
+      newNode<Bexpression>(N_Composite, kids, value, btype, loc);
   for (auto &inst : instructions.instructions())
     rval->appendInstruction(inst);
   indexvecs_.push_back(indices);
@@ -666,11 +745,11 @@ BnodeBuilder::mkComposite(Btype *btype,
                           Binstructions &instructions,
                           Location loc)
 {
-  std::vector<Bnode *> kids;
+  llvm::SmallVector<Bnode *, 8> kids;
   for (auto &v : vals)
     kids.push_back(v);
   Bexpression *rval =
-      new Bexpression(N_Composite, kids, value, btype, loc);
+      newNode<Bexpression>(N_Composite, kids, value, btype, loc);
   for (auto &inst : instructions.instructions())
     rval->appendInstruction(inst);
   rval->u.indices = -1;
@@ -683,9 +762,9 @@ Bexpression *BnodeBuilder::mkStructField(Btype *typ,
                                          unsigned fieldIndex,
                                          Location loc)
 {
-  std::vector<Bnode *> kids = { structval };
+  Bnode *kids[] = { structval };
   Bexpression *rval =
-      new Bexpression(N_StructField, kids, val, typ, loc);
+      newNode<Bexpression>(N_StructField, kids, val, typ, loc);
   appendInstIfNeeded(rval, val);
   rval->u.fieldIndex = fieldIndex;
   return archive(rval);
@@ -697,9 +776,9 @@ Bexpression *BnodeBuilder::mkArrayIndex(Btype *typ,
                                         Bexpression *index,
                                         Location loc)
 {
-  std::vector<Bnode *> kids = { arval, index };
+  Bnode *kids[] = { arval, index };
   Bexpression *rval =
-      new Bexpression(N_ArrayIndex, kids, val, typ, loc);
+      newNode<Bexpression>(N_ArrayIndex, kids, val, typ, loc);
   appendInstIfNeeded(rval, val);
   return archive(rval);
 }
@@ -710,9 +789,9 @@ Bexpression *BnodeBuilder::mkPointerOffset(Btype *typ,
                                            Bexpression *offset,
                                            Location loc)
 {
-  std::vector<Bnode *> kids = { ptr, offset };
+  Bnode *kids[] = { ptr, offset };
   Bexpression *rval =
-      new Bexpression(N_PointerOffset, kids, val, typ, loc);
+      newNode<Bexpression>(N_PointerOffset, kids, val, typ, loc);
   appendInstIfNeeded(rval, val);
   return archive(rval);
 }
@@ -722,9 +801,9 @@ Bexpression *BnodeBuilder::mkCompound(Bstatement *st,
                                       llvm::Value *val,
                                       Location loc)
 {
-  std::vector<Bnode *> kids = { st, expr };
+  Bnode *kids[] = { st, expr };
   Bexpression *rval =
-      new Bexpression(N_Compound, kids, val, expr->btype(), loc);
+      newNode<Bexpression>(N_Compound, kids, val, expr->btype(), loc);
   rval->setTag(expr->tag());
   return archive(rval);
 }
@@ -738,13 +817,13 @@ Bexpression *BnodeBuilder::mkCall(Btype *btype,
                                   Binstructions &instructions,
                                   Location loc)
 {
-  std::vector<Bnode *> kids;
+  llvm::SmallVector<Bnode *, 8> kids;
   kids.push_back(fnExpr);
   kids.push_back(chainExpr);
   for (auto &a : args)
     kids.push_back(a);
   Bexpression *rval =
-      new Bexpression(N_Call, kids, val, btype, loc);
+      newNode<Bexpression>(N_Call, kids, val, btype, loc);
   bool found = false;
   for (auto &inst : instructions.instructions()) {
     if (inst == val)
@@ -764,13 +843,13 @@ Bexpression *BnodeBuilder::mkConditional(Bfunction *function,
                                          Bexpression *else_expr,
                                          Location loc)
 {
-  std::vector<Bnode *> kids;
+  llvm::SmallVector<Bnode *, 8> kids;
   kids.push_back(condition);
   kids.push_back(then_expr);
   if (else_expr)
     kids.push_back(else_expr);
   Bexpression *rval =
-      new Bexpression(N_Conditional, kids, nullptr, btype, loc);
+      newNode<Bexpression>(N_Conditional, kids, nullptr, btype, loc);
   rval->u.func = function;
   return archive(rval);
 }
@@ -778,7 +857,7 @@ Bexpression *BnodeBuilder::mkConditional(Bfunction *function,
 Bstatement *BnodeBuilder::mkErrorStmt()
 {
   assert(! errorStatement_.get());
-  std::vector<Bnode *> kids;
+  llvm::ArrayRef<Bnode *> kids;
   errorStatement_.reset(new Bstatement(N_Error, nullptr, kids, Location()));
   return errorStatement_.get();
 }
@@ -787,8 +866,8 @@ Bstatement *BnodeBuilder::mkExprStmt(Bfunction *func,
                                      Bexpression *expr,
                                      Location loc)
 {
-  std::vector<Bnode *> kids = { expr };
-  Bstatement *rval = new Bstatement(N_ExprStmt, func, kids, loc);
+  Bnode *kids[] = { expr };
+  Bstatement *rval = newNode<Bstatement>(N_ExprStmt, func, kids, loc);
   return archive(rval);
 }
 
@@ -796,8 +875,8 @@ Bstatement *BnodeBuilder::mkReturn(Bfunction *func,
                                    Bexpression *returnVal,
                                    Location loc)
 {
-  std::vector<Bnode *> kids = { returnVal };
-  Bstatement *rval = new Bstatement(N_ReturnStmt, func, kids, loc);
+  Bnode *kids[] = { returnVal };
+  Bstatement *rval = newNode<Bstatement>(N_ReturnStmt, func, kids, loc);
   return archive(rval);
 }
 
@@ -805,8 +884,8 @@ Bstatement *BnodeBuilder::mkLabelDefStmt(Bfunction *func,
                                          Blabel *label,
                                          Location loc)
 {
-  std::vector<Bnode *> kids;
-  Bstatement *rval = new Bstatement(N_LabelStmt, func, kids, loc);
+  llvm::ArrayRef<Bnode *> kids;
+  Bstatement *rval = newNode<Bstatement>(N_LabelStmt, func, kids, loc);
   rval->u.label = label;
   return archive(rval);
 }
@@ -815,8 +894,8 @@ Bstatement *BnodeBuilder::mkGotoStmt(Bfunction *func,
                                      Blabel *label,
                                      Location loc)
 {
-  std::vector<Bnode *> kids;
-  Bstatement *rval = new Bstatement(N_GotoStmt, func, kids, loc);
+  llvm::ArrayRef<Bnode *> kids;
+  Bstatement *rval = newNode<Bstatement>(N_GotoStmt, func, kids, loc);
   rval->u.label = label;
   return archive(rval);
 }
@@ -827,8 +906,8 @@ Bstatement *BnodeBuilder::mkIfStmt(Bfunction *func,
 {
   if (falseBlock == nullptr)
     falseBlock = mkBlock(func, std::vector<Bvariable *>(), loc);
-  std::vector<Bnode *> kids = { cond, trueBlock, falseBlock };
-  Bstatement *rval = new Bstatement(N_IfStmt, func, kids, loc);
+  Bnode *kids[] = { cond, trueBlock, falseBlock };
+  Bstatement *rval = newNode<Bstatement>(N_IfStmt, func, kids, loc);
   return archive(rval);
 }
 
@@ -840,8 +919,8 @@ Bstatement *BnodeBuilder::mkDeferStmt(Bfunction *func,
   assert(func);
   assert(undefer);
   assert(defer);
-  std::vector<Bnode *> kids = { undefer, defer };
-  Bstatement *rval = new Bstatement(N_DeferStmt, func, kids, loc);
+  Bnode *kids[] = { undefer, defer };
+  Bstatement *rval = newNode<Bstatement>(N_DeferStmt, func, kids, loc);
   return archive(rval);
 }
 
@@ -856,8 +935,8 @@ Bstatement *BnodeBuilder::mkExcepStmt(Bfunction *func,
   assert(onexception);
   assert(finally);
   assert(finTempVar);
-  std::vector<Bnode *> kids = { body, onexception, finally };
-  Bstatement *rval = new Bstatement(N_ExcepStmt, func, kids, loc);
+  Bnode *kids[] = { body, onexception, finally };
+  Bstatement *rval = newNode<Bstatement>(N_ExcepStmt, func, kids, loc);
   rval->u.var = finTempVar;
   return archive(rval);
 }
@@ -882,7 +961,7 @@ Bstatement *BnodeBuilder::mkSwitchStmt(Bfunction *func,
                                        const std::vector<Bstatement *> &stmts,
                                        Location loc)
 {
-  std::vector<Bnode *> kids = { swvalue };
+  llvm::SmallVector<Bnode *, 8> kids = { swvalue };
   for (auto &vvec : vals)
     for (auto &v : vvec)
       kids.push_back(v);
@@ -895,7 +974,7 @@ Bstatement *BnodeBuilder::mkSwitchStmt(Bfunction *func,
 
   SwitchDescriptor *d = new SwitchDescriptor(vals);
   swcases_.push_back(d);
-  Bstatement *rval = new Bstatement(N_SwitchStmt, func, kids, loc);
+  Bstatement *rval = newNode<Bstatement>(N_SwitchStmt, func, kids, loc);
   rval->u.swcases = d;
   return archive(rval);
 
@@ -905,7 +984,7 @@ Bblock *BnodeBuilder::mkBlock(Bfunction *func,
                               const std::vector<Bvariable *> &vars,
                               Location loc)
 {
-  Bblock *rval = new Bblock(func, vars, loc);
+  Bblock *rval = newNode<Bblock>(func, vars, loc);
   return archive(rval);
 }
 
@@ -921,26 +1000,37 @@ BnodeBuilder::cloneSub(Bexpression *expr,
                        std::map<llvm::Value *, llvm::Value *> &vm)
 {
   assert(expr);
-  std::vector<Bnode *> newChildren;
+  // Function address nodes are copied rather than turned into plain
+  // constants: calls find their direct target by looking for an
+  // N_FcnAddress child (see Bnode::getCallTarget).
+  if (expr->flavor() != N_FcnAddress && constantValueReusable(expr)) {
+    reusedConstants_ += 1;
+    return mkConst(expr->btype(), expr->value());
+  }
+
+  llvm::SmallVector<Bnode *, 3> newChildren;
   for (auto &c : expr->children()) {
     assert(c);
     Bexpression *ce = c->castToBexpression();
     assert(ce);
-    Bexpression *clc = cloneSubtree(ce);
+    Bexpression *clc = cloneSub(ce, vm);
     newChildren.push_back(clc);
   }
-  Bexpression *res = new Bexpression(*expr);
+  Bexpression *res = newNode<Bexpression>(*expr);
   res->kids_ = newChildren;
   archive(res);
+  clonedNodes_ += 1;
 
+  // Clone instructions, remapping operands that refer to instructions
+  // already cloned (in this node or in its children).
   llvm::Value *iv = expr->value();
   llvm::Value *newv = nullptr;
   for (auto inst : expr->instructions()) {
+    llvm::Instruction *icl = inst->clone();
     if (inst == iv) {
       assert(! newv);
-      newv = inst;
+      newv = icl;
     }
-    llvm::Instruction *icl = inst->clone();
     unsigned nops = inst->getNumOperands();
     for (unsigned idx = 0; idx < nops; ++idx) {
       llvm::Value *v = inst->getOperand(idx);
@@ -951,10 +1041,13 @@ BnodeBuilder::cloneSub(Bexpression *expr,
       }
     }
     icl->setName(inst->getName());
+    vm[inst] = icl;
     res->appendInstruction(icl);
   }
   if (newv)
     res->setValue(newv);
+  else if (iv && vm.find(iv) != vm.end())
+    res->setValue(vm[iv]);
   return res;
 }
 
@@ -963,6 +1056,31 @@ Bexpression *BnodeBuilder::cloneSubtree(Bexpression *expr) {
   return cloneSub(expr, vm);
 }
 
+bool BnodeBuilder::constantValueReusable(Bexpression *expr) const
+{
+  if (!expr->isConstant())
+    return false;
+  std::vector<Bexpression *> workList;
+  workList.push_back(expr);
+  while (! workList.empty()) {
+    Bexpression *e = workList.back();
+    workList.pop_back();
+    if (e->varExprPending() || e->compositeInitPending() ||
+        !e->instructions().empty())
+      return false;
+    if (e->flavor() == N_Call || e->flavor() == N_Compound ||
+        e->flavor() == N_Conditional)
+      return false;
+    for (auto &c : e->children()) {
+      Bexpression *ce = c->castToBexpression();
+      if (!ce)
+        return false;
+      workList.push_back(ce);
+    }
+  }
+  return true;
+}
+
 std::vector<Bexpression *>
 BnodeBuilder::extractChildenAndDestroy(Bexpression *expr)
 {
@@ -20,6 +20,10 @@
 
 #include "backend.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
+
 namespace llvm {
 class AllocaInst;
 class Instruction;
@@ -167,6 +171,10 @@ class Bnode {
   // Return struct field index for a field expr
   unsigned fieldIndex() const;
 
+  // For deref exprs, returns true if the front end has flagged the
+  // pointer being dereferenced as known to be valid (non-nil).
+  bool knownValid() const;
+
   // Return function associated with this node. Value only for
   // function constants, calls, and conditionals. Note that for calls and
   // conditionals this will be the function containing the construct.
@@ -183,16 +191,17 @@ class Bnode {
   template<class Visitor> friend class UpdatingNodeWalker;
   friend class BnodeBuilder;
   friend class IntegrityVisitor;
+  friend class SharingRepairer;
 
   // TODO: hide this once GenBlocksVisitor is working
-  const std::vector<Bnode *> &children() const { return kids_; }
+  llvm::ArrayRef<Bnode *> children() const { return kids_; }
 
   bool isStmt() const {
     return (flavor() >= N_FirstStmt && flavor() <= N_LastStmt);
   }
 
  protected:
-  Bnode(NodeFlavor flavor, const std::vector<Bnode *> &kids, Location loc);
+  Bnode(NodeFlavor flavor, llvm::ArrayRef<Bnode *> kids, Location loc);
   Bnode(const Bnode &src);
   SwitchDescriptor *getSwitchCases();
 
@@ -200,7 +209,8 @@ class Bnode {
   void replaceChild(unsigned idx, Bnode *newchild);
 
  private:
-  std::vector<Bnode *> kids_;
+  // Most nodes have three or fewer children; those are stored inline.
+  llvm::SmallVector<Bnode *, 3> kids_;
   union {
     Bvariable *var;  // filled in only for Var and ExcepStmt nodes
     Bfunction *func; // filled in only for fcn constants, calls, conditionals
@@ -214,6 +224,9 @@ class Bnode {
   NodeFlavor flavor_;
   unsigned id_;
   unsigned flags_;
+
+  // Bits in flags_
+  enum : unsigned { KnownValidFlag = 1 << 0 };
 };
 
 // This helper class handles construction for all Bnode objects.
@@ -223,9 +236,20 @@ class Bnode {
 // function before moving on to the next function. Putting this into
 // practice is tricky, however, since some Bexpressions (for example,
 // var exprs and function addresses) wind up being held over and
-// reused else where (for example, in emitted GC descriptors). For the
-// moment we don't try to free Bexpressions at intermediate points
-// in the compilation, but we do free Bstatements.
+// reused else where (for example, in emitted GC descriptors). Once a
+// function body has been lowered we therefore release only the nodes
+// in its tree that are known to be function-local, and leave two kinds
+// of expressions alone: those tagged as module scope (see
+// Bexpression::moduleScope; these are cached by the backend and handed
+// out to many trees), and those whose value is not an instruction (for
+// example var exprs for globals, which refer to the global itself).
+// See releaseLoweredTree below.
+//
+// Bnodes are carved out of a bump-pointer arena owned by the builder
+// rather than being heap-allocated one at a time. Freeing a node runs
+// its destructor and places its storage on a free list (bucketed by
+// size) from which later nodes are allocated; the arena memory itself
+// is released in bulk when the builder is destroyed.
 
 class BnodeBuilder {
  public:
@@ -243,7 +267,8 @@ class BnodeBuilder {
   Bexpression *mkConversion(Btype *btype, llvm::Value *val,
                             Bexpression *src, Location loc);
   Bexpression *mkDeref(Btype *typ, llvm::Value *val,
-                       Bexpression *src, Location loc);
+                       Bexpression *src, Location loc,
+                       bool knownValid = false);
   Bexpression *mkAddress(Btype *typ, llvm::Value *val,
                          Bexpression *src, Location loc);
   Bexpression *mkFcnAddress(Btype *typ, llvm::Value *val,
@@ -353,9 +378,33 @@ class BnodeBuilder {
   // If recursive is true, also delete its children recursively.
   void destroy(Bnode *node, WhichDel which = DelWrappers, bool recursive = true);
 
-  // Clone an expression subtree.
+  // Release the Bnode tree for a function body once it has been
+  // lowered to LLVM IR. Module-scope expressions (see
+  // Bexpression::moduleScope) and expressions with a non-instruction
+  // value may be shared with other trees or held over, so they and
+  // their children are left in place; everything else reachable from
+  // 'root' is freed.
+  void releaseLoweredTree(Bstatement *root);
+
+  // Clone an expression subtree. Any portion of the subtree that has
+  // already been lowered to a constant (see constantValueReusable) is
+  // not copied; the clone gets a single node reusing the constant.
+  // Everything else, including function addresses and side-effect-free
+  // subtrees that are not yet lowered, is copied node by node.
   Bexpression *cloneSubtree(Bexpression *expr);
 
+  // Returns TRUE if the expression subtree 'expr' has already been
+  // lowered to a constant and has no pending work, in which case
+  // additional references to it can simply reuse that constant.
+  // Non-constant values are never reused in this way: repair runs
+  // before it is known whether one reference dominates the others.
+  bool constantValueReusable(Bexpression *expr) const;
+
+  // Counts of nodes created by cloning, and of shared subtrees
+  // replaced by constant-reuse nodes (for statistics and unit testing).
+  unsigned long clonedNodeCount() const { return clonedNodes_; }
+  unsigned long reusedConstantCount() const { return reusedConstants_; }
+
   // Get the indices of a composite expression.
   const std::vector<unsigned long> *getIndices(Bexpression *expr) const;
 
@@ -382,11 +431,20 @@ class BnodeBuilder {
   bool integrityChecksEnabled() const { return checkIntegrity_; }
   void setIntegrityChecks(bool val) { checkIntegrity_ = val; }
 
+  // Number of bytes of arena storage allocated for Bnodes so far,
+  // number of node allocations satisfied from freed node storage, and
+  // number of nodes currently live (plus the high-water mark).
+  size_t nodeBytesAllocated() const { return nodeArena_.getBytesAllocated(); }
+  unsigned long recycledNodeCount() const { return recycledNodes_; }
+  unsigned long liveNodeCount() const { return liveNodes_; }
+  unsigned long peakLiveNodeCount() const { return peakLiveNodes_; }
+
  private:
   void appendInstIfNeeded(Bexpression *rval, llvm::Value *val);
   Bexpression *archive(Bexpression *expr);
   Bstatement *archive(Bstatement *stmt);
   Bblock *archive(Bblock *bb);
+  template<class T, class... Args> T *newNode(Args&&... args);
   Bexpression *cloneSub(Bexpression *expr,
                         std::map<llvm::Value *, llvm::Value *> &vm);
   void checkTreeInteg(Bnode *node);
@@ -395,6 +453,8 @@ class BnodeBuilder {
   void recordDeadInstruction(llvm::Instruction *inst);
 
  private:
+  llvm::BumpPtrAllocator nodeArena_;
+  std::unordered_map<size_t, std::vector<void *> > freeNodes_;
   std::unique_ptr<Bstatement> errorStatement_;
   std::vector<Bexpression *> earchive_;
   std::vector<Bstatement *> sarchive_;
@@ -404,6 +464,11 @@ class BnodeBuilder {
   std::unique_ptr<IntegrityVisitor> integrityVisitor_;
   bool checkIntegrity_;
   std::vector<llvm::Instruction*> deadInstructions_;
+  unsigned long clonedNodes_;
+  unsigned long reusedConstants_;
+  unsigned long recycledNodes_;
+  unsigned long liveNodes_;
+  unsigned long peakLiveNodes_;
 };
 
 // This class helps automate walking of a Bnode subtree; it invokes
@@ -459,7 +524,8 @@ public:
     if (pairPre.first == StopWalk)
       return std::make_pair(StopWalk, node);
 
-    std::vector<Bnode *> children = node->children();
+    llvm::SmallVector<Bnode *, 3> children(node->children().begin(),
+                                           node->children().end());
     for (unsigned idx = 0; idx < children.size(); ++idx) {
       Bnode *child = children[idx];
 
@@ -110,7 +110,7 @@ class Bstatement : public Bnode {
  protected:
   friend class BnodeBuilder;
   Bstatement(NodeFlavor fl, Bfunction *func,
-             const std::vector<Bnode *> &kids, Location loc);
+             llvm::ArrayRef<Bnode *> kids, Location loc);
 
  private:
   Bexpression *getNthChildAsExpr(NodeFlavor fl, unsigned cidx);
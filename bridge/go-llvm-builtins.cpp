@@ -94,6 +94,7 @@ BuiltinEntry *BuiltinTable::lookup(const std::string &name)
 
 void BuiltinTable::defineAllBuiltins() {
   defineSyncFetchAndAddBuiltins();
+  defineAtomicBuiltins();
   defineIntrinsicBuiltins();
   defineTrigBuiltins();
   defineExprBuiltins();
@@ -107,8 +108,11 @@ void BuiltinTable::defineIntrinsicBuiltins() {
   unsigned bitsInPtr = tman_->datalayout()->getPointerSizeInBits();
   Btype *uintPtrType = tman_->integerType(true, bitsInPtr);
   Btype *sizeType = uintPtrType;
+  Btype *uint16Type = tman_->integerType(true, 16);
   Btype *uint64Type = tman_->integerType(true, 64);
   Btype *int64Type = tman_->integerType(false, 64);
+  Btype *doubleType = tman_->floatType(64);
+  Btype *longDoubleType = tman_->floatType(128);
 
   // A note on the types below:
   // - for intrinsic builtins, return type is implicitly defined
@@ -163,6 +167,48 @@ void BuiltinTable::defineIntrinsicBuiltins() {
   // equivalent is named just "bswap"
   defineIntrinsicBuiltin("__builtin_bswap64", "bswap64", llvm::Intrinsic::bswap,
                          uint64Type, nullptr);
+
+  defineIntrinsicBuiltin("__builtin_bswap16", nullptr, llvm::Intrinsic::bswap,
+                         uint16Type, nullptr);
+
+  // Used by the front end for math/bits LeadingZeros* and OnesCount*.
+  defineIntrinsicBuiltin("__builtin_clz", nullptr, llvm::Intrinsic::ctlz,
+                         uint32Type, nullptr);
+  defineIntrinsicBuiltin("__builtin_clzll", nullptr, llvm::Intrinsic::ctlz,
+                         uint64Type, nullptr);
+  defineIntrinsicBuiltin("__builtin_popcount", nullptr, llvm::Intrinsic::ctpop,
+                         uint32Type, nullptr);
+  defineIntrinsicBuiltin("__builtin_popcountll", nullptr,
+                         llvm::Intrinsic::ctpop, uint64Type, nullptr);
+
+  // Math routines that have an LLVM intrinsic equivalent. These are
+  // mapped to the intrinsic (rather than a libcall, see
+  // defineTrigBuiltins) so that they can be lowered to a single
+  // instruction where the target has one, and vectorized.
+  static const struct {
+    const char *name;
+    llvm::Intrinsic::ID id;
+  } mathIntrinsics[] = {
+    { "ceil", llvm::Intrinsic::ceil },
+    { "copysign", llvm::Intrinsic::copysign },
+    { "fabs", llvm::Intrinsic::fabs },
+    { "floor", llvm::Intrinsic::floor },
+    { "fma", llvm::Intrinsic::fma },
+    { "round", llvm::Intrinsic::round },
+    { "sqrt", llvm::Intrinsic::sqrt },
+    { "trunc", llvm::Intrinsic::trunc },
+  };
+  for (auto &mi : mathIntrinsics) {
+    char bbuf[128];
+    char lbuf[128];
+    sprintf(bbuf, "__builtin_%s", mi.name);
+    defineIntrinsicBuiltin(bbuf, mi.name, mi.id, doubleType, nullptr);
+    if (addLongDouble_) {
+      sprintf(lbuf, "%sl", mi.name);
+      sprintf(bbuf, "__builtin_%s", lbuf);
+      defineIntrinsicBuiltin(bbuf, lbuf, mi.id, longDoubleType, nullptr);
+    }
+  }
 }
 
 namespace {
@@ -223,21 +269,16 @@ void BuiltinTable::defineTrigBuiltins() {
       {"asin", OneArg, llvm::LibFunc::LibFunc_asin},
       {"atan", OneArg, llvm::LibFunc::LibFunc_atan},
       {"atan2", TwoArgs, llvm::LibFunc::LibFunc_atan2},
-      {"ceil", OneArg, llvm::LibFunc::LibFunc_ceil},
       {"cos", OneArg, llvm::LibFunc::LibFunc_cos},
       {"exp", OneArg, llvm::LibFunc::LibFunc_exp},
       {"expm1", OneArg, llvm::LibFunc::LibFunc_expm1},
-      {"fabs", OneArg, llvm::LibFunc::LibFunc_fabs},
-      {"floor", OneArg, llvm::LibFunc::LibFunc_floor},
       {"fmod", TwoArgs, llvm::LibFunc::LibFunc_fmod},
       {"log", OneArg, llvm::LibFunc::LibFunc_log},
       {"log1p", OneArg, llvm::LibFunc::LibFunc_log1p},
       {"log10", OneArg, llvm::LibFunc::LibFunc_log10},
       {"log2", OneArg, llvm::LibFunc::LibFunc_log2},
       {"sin", OneArg, llvm::LibFunc::LibFunc_sin},
-      {"sqrt", OneArg, llvm::LibFunc::LibFunc_sqrt},
       {"tan", OneArg, llvm::LibFunc::LibFunc_tan},
-      {"trunc", OneArg, llvm::LibFunc::LibFunc_trunc},
       {"ldexp", TwoMixed, llvm::LibFunc::LibFunc_trunc},
   };
 
@@ -259,6 +300,16 @@ void BuiltinTable::defineTrigBuiltins() {
   }
 }
 
+static llvm::Value *syncFetchAndAddMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                         BinstructionsLIRBuilder *builder,
+                                         llvm::Module *module)
+{
+  // __sync_fetch_and_add_N(ptr, val): sequentially consistent add.
+  assert(args.size() == 2);
+  return builder->CreateAtomicRMW(llvm::AtomicRMWInst::Add, args[0], args[1],
+                                  llvm::AtomicOrdering::SequentiallyConsistent);
+}
+
 void BuiltinTable::defineSyncFetchAndAddBuiltins() {
   std::vector<unsigned> sizes = {1, 2, 4, 8};
   for (auto sz : sizes) {
@@ -266,11 +317,211 @@ void BuiltinTable::defineSyncFetchAndAddBuiltins() {
     sprintf(nbuf, "__sync_fetch_and_add_%u", sz);
     Btype *it = tman_->integerType(true,  sz << 3);
     Btype *pit = tman_->pointerType(it);
-    defineLibcallBuiltin(nullptr, nbuf,  // libname, name
-                         BuiltinEntry::NotInTargetLib, // Libfunc ID
-                         tman_->voidType(),  // result type
-                         pit, it,        // param types
-                         nullptr);
+    BuiltinEntryTypeVec typeVec = { tman_->voidType(), pit, it };
+    registerExprBuiltin(nbuf, nullptr, typeVec, syncFetchAndAddMaker);
+  }
+}
+
+// Convert a GCC-style memory order argument (__ATOMIC_RELAXED=0 through
+// __ATOMIC_SEQ_CST=5) to an LLVM ordering. Anything we can't make sense
+// of (for example a non-constant order) is treated as seq_cst.
+static llvm::AtomicOrdering atomicOrdering(llvm::Value *order)
+{
+  llvm::ConstantInt *ci = llvm::dyn_cast<llvm::ConstantInt>(order);
+  if (!ci)
+    return llvm::AtomicOrdering::SequentiallyConsistent;
+  switch (ci->getZExtValue()) {
+    case 0: return llvm::AtomicOrdering::Monotonic;
+    case 1: // consume
+    case 2: return llvm::AtomicOrdering::Acquire;
+    case 3: return llvm::AtomicOrdering::Release;
+    case 4: return llvm::AtomicOrdering::AcquireRelease;
+    default: return llvm::AtomicOrdering::SequentiallyConsistent;
+  }
+}
+
+static llvm::AtomicOrdering loadOrdering(llvm::Value *order)
+{
+  llvm::AtomicOrdering ao = atomicOrdering(order);
+  if (ao == llvm::AtomicOrdering::Release ||
+      ao == llvm::AtomicOrdering::AcquireRelease)
+    return llvm::AtomicOrdering::SequentiallyConsistent;
+  return ao;
+}
+
+static llvm::AtomicOrdering storeOrdering(llvm::Value *order)
+{
+  llvm::AtomicOrdering ao = atomicOrdering(order);
+  if (ao == llvm::AtomicOrdering::Acquire ||
+      ao == llvm::AtomicOrdering::AcquireRelease)
+    return llvm::AtomicOrdering::SequentiallyConsistent;
+  return ao;
+}
+
+static unsigned atomicAlignment(llvm::Value *ptr)
+{
+  llvm::Type *elt = ptr->getType()->getPointerElementType();
+  return elt->getIntegerBitWidth() / 8;
+}
+
+static llvm::Value *atomicLoadMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                    BinstructionsLIRBuilder *builder,
+                                    llvm::Module *module)
+{
+  // __atomic_load_N(ptr, order)
+  assert(args.size() == 2);
+  llvm::LoadInst *load = builder->CreateLoad(args[0]);
+  load->setAtomic(loadOrdering(args[1]));
+  load->setAlignment(atomicAlignment(args[0]));
+  return load;
+}
+
+static llvm::Value *atomicStoreMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                     BinstructionsLIRBuilder *builder,
+                                     llvm::Module *module)
+{
+  // __atomic_store_N(ptr, val, order)
+  assert(args.size() == 3);
+  llvm::StoreInst *store = builder->CreateStore(args[1], args[0]);
+  store->setAtomic(storeOrdering(args[2]));
+  store->setAlignment(atomicAlignment(args[0]));
+  return store;
+}
+
+static llvm::Value *atomicRMW(llvm::SmallVector<llvm::Value*, 16> &args,
+                              BinstructionsLIRBuilder *builder,
+                              llvm::AtomicRMWInst::BinOp op)
+{
+  // __atomic_<op>_N(ptr, val, order), returning the old value
+  assert(args.size() == 3);
+  return builder->CreateAtomicRMW(op, args[0], args[1],
+                                  atomicOrdering(args[2]));
+}
+
+static llvm::Value *atomicExchangeMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                        BinstructionsLIRBuilder *builder,
+                                        llvm::Module *module)
+{
+  return atomicRMW(args, builder, llvm::AtomicRMWInst::Xchg);
+}
+
+static llvm::Value *atomicFetchAddMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                        BinstructionsLIRBuilder *builder,
+                                        llvm::Module *module)
+{
+  return atomicRMW(args, builder, llvm::AtomicRMWInst::Add);
+}
+
+static llvm::Value *atomicFetchAndMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                        BinstructionsLIRBuilder *builder,
+                                        llvm::Module *module)
+{
+  return atomicRMW(args, builder, llvm::AtomicRMWInst::And);
+}
+
+static llvm::Value *atomicFetchOrMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                       BinstructionsLIRBuilder *builder,
+                                       llvm::Module *module)
+{
+  return atomicRMW(args, builder, llvm::AtomicRMWInst::Or);
+}
+
+// The <op>_fetch variants return the new value, which we recompute
+// from the old value returned by the atomicrmw.
+
+static llvm::Value *atomicAddFetchMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                        BinstructionsLIRBuilder *builder,
+                                        llvm::Module *module)
+{
+  llvm::Value *old = atomicRMW(args, builder, llvm::AtomicRMWInst::Add);
+  return builder->CreateAdd(old, args[1]);
+}
+
+static llvm::Value *atomicAndFetchMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                        BinstructionsLIRBuilder *builder,
+                                        llvm::Module *module)
+{
+  llvm::Value *old = atomicRMW(args, builder, llvm::AtomicRMWInst::And);
+  return builder->CreateAnd(old, args[1]);
+}
+
+static llvm::Value *atomicOrFetchMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                       BinstructionsLIRBuilder *builder,
+                                       llvm::Module *module)
+{
+  llvm::Value *old = atomicRMW(args, builder, llvm::AtomicRMWInst::Or);
+  return builder->CreateOr(old, args[1]);
+}
+
+static llvm::Value *atomicCmpXchgMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                       BinstructionsLIRBuilder *builder,
+                                       llvm::Module *module)
+{
+  // __atomic_compare_exchange_N(ptr, expected, desired, weak,
+  //                             success_order, failure_order)
+  // If *ptr == *expected, stores desired to *ptr and returns true;
+  // otherwise copies *ptr to *expected and returns false.
+  assert(args.size() == 6);
+  llvm::AtomicOrdering success = atomicOrdering(args[4]);
+  llvm::AtomicOrdering failure = loadOrdering(args[5]);
+  if (llvm::isStrongerThan(failure, success))
+    success = failure;
+  llvm::Value *expected = builder->CreateLoad(args[1]);
+  llvm::AtomicCmpXchgInst *cas =
+      builder->CreateAtomicCmpXchg(args[0], expected, args[2],
+                                   success, failure);
+  llvm::ConstantInt *weak = llvm::dyn_cast<llvm::ConstantInt>(args[3]);
+  cas->setWeak(weak && !weak->isZero());
+  llvm::Value *prev = builder->CreateExtractValue(cas, 0);
+  builder->CreateStore(prev, args[1]);
+  llvm::Value *ok = builder->CreateExtractValue(cas, 1);
+  return builder->CreateZExt(ok, builder->getInt8Ty());
+}
+
+void BuiltinTable::defineAtomicBuiltins() {
+  Btype *boolType = tman_->boolType();
+  Btype *int32Type = tman_->integerType(false, 32);
+  Btype *voidType = tman_->voidType();
+
+  // These are the sized libatomic entry points that the front end
+  // emits calls to for runtime/internal/atomic and sync/atomic; expand
+  // them inline rather than calling out to libatomic.
+  std::vector<unsigned> sizes = {1, 2, 4, 8};
+  for (auto sz : sizes) {
+    Btype *it = tman_->integerType(true, sz << 3);
+    Btype *pit = tman_->pointerType(it);
+    char nbuf[64];
+
+    BuiltinEntryTypeVec loadTypes = { it, pit, int32Type };
+    sprintf(nbuf, "__atomic_load_%u", sz);
+    registerExprBuiltin(nbuf, nullptr, loadTypes, atomicLoadMaker);
+
+    BuiltinEntryTypeVec storeTypes = { voidType, pit, it, int32Type };
+    sprintf(nbuf, "__atomic_store_%u", sz);
+    registerExprBuiltin(nbuf, nullptr, storeTypes, atomicStoreMaker);
+
+    BuiltinEntryTypeVec rmwTypes = { it, pit, it, int32Type };
+    static const struct {
+      const char *name;
+      BuiltinExprMaker maker;
+    } rmws[] = {
+      { "__atomic_exchange_%u", atomicExchangeMaker },
+      { "__atomic_fetch_add_%u", atomicFetchAddMaker },
+      { "__atomic_add_fetch_%u", atomicAddFetchMaker },
+      { "__atomic_fetch_and_%u", atomicFetchAndMaker },
+      { "__atomic_and_fetch_%u", atomicAndFetchMaker },
+      { "__atomic_fetch_or_%u", atomicFetchOrMaker },
+      { "__atomic_or_fetch_%u", atomicOrFetchMaker },
+    };
+    for (auto &rmw : rmws) {
+      sprintf(nbuf, rmw.name, sz);
+      registerExprBuiltin(nbuf, nullptr, rmwTypes, rmw.maker);
+    }
+
+    BuiltinEntryTypeVec casTypes = { boolType, pit, pit, it, boolType,
+                                     int32Type, int32Type };
+    sprintf(nbuf, "__atomic_compare_exchange_%u", sz);
+    registerExprBuiltin(nbuf, nullptr, casTypes, atomicCmpXchgMaker);
   }
 }
 
@@ -317,7 +568,8 @@ void BuiltinTable::defineIntrinsicBuiltin(const char *name,
 }
 
 static llvm::Value *builtinExtractReturnAddrMaker(llvm::SmallVector<llvm::Value*, 16> args,
-                                                  BinstructionsLIRBuilder *builder)
+                                                  BinstructionsLIRBuilder *builder,
+                                                  llvm::Module *module)
 {
   // __builtin_extract_return_addr(uintptr) uintptr
   // extracts the actual encoded address from the address as returned
@@ -331,17 +583,46 @@ static llvm::Value *builtinExtractReturnAddrMaker(llvm::SmallVector<llvm::Value*
 }
 
 static llvm::Value *builtinUnreachableMaker(llvm::SmallVector<llvm::Value*, 16> args,
-                                            BinstructionsLIRBuilder *builder)
+                                            BinstructionsLIRBuilder *builder,
+                                            llvm::Module *module)
 {
   llvm::UnreachableInst *unr = builder->CreateUnreachable();
   return unr;
 }
 
+static llvm::Value *builtinRotateLeftMaker(llvm::SmallVector<llvm::Value*, 16> args,
+                                           BinstructionsLIRBuilder *builder,
+                                           llvm::Module *module)
+{
+  // __builtin_rotateleftN(x, k) is a funnel shift of x with itself,
+  // llvm.fshl(x, x, k). The shift count is taken modulo N, as in
+  // math/bits, so no masking is needed; the intrinsic is lowered to
+  // a single rotate instruction where the target has one. This is
+  // done here rather than through an intrinsic builtin entry since x
+  // has to be passed twice, but its expression evaluated only once.
+  assert(args.size() == 2);
+  llvm::Value *x = args[0];
+  llvm::Function *fshl =
+      llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::fshl,
+                                      { x->getType() });
+  llvm::Value *fargs[] = { x, x, args[1] };
+  return builder->CreateCall(fshl->getFunctionType(), fshl, fargs);
+}
+
 void BuiltinTable::defineExprBuiltins()
 {
   unsigned bitsInPtr = tman_->datalayout()->getPointerSizeInBits();
   Btype *uintPtrType = tman_->integerType(true, bitsInPtr);
 
+  std::vector<unsigned> rotateSizes = {8, 16, 32, 64};
+  for (auto bits : rotateSizes) {
+    char nbuf[64];
+    sprintf(nbuf, "__builtin_rotateleft%u", bits);
+    Btype *it = tman_->integerType(true, bits);
+    BuiltinEntryTypeVec typeVec = { it, it, it };
+    registerExprBuiltin(nbuf, nullptr, typeVec, builtinRotateLeftMaker);
+  }
+
   {
     BuiltinEntryTypeVec typeVec(2);
     typeVec[0] = uintPtrType;
@@ -26,7 +26,8 @@ class TypeManager;
 typedef std::vector<Btype*> BuiltinEntryTypeVec;
 
 typedef llvm::Value *(*BuiltinExprMaker)(llvm::SmallVector<llvm::Value*, 16> args,
-                                         BinstructionsLIRBuilder *builder);
+                                         BinstructionsLIRBuilder *builder,
+                                         llvm::Module *module);
 
 // An entry in a table of interesting builtin functions. A given entry
 // is either an intrinsic or a libcall builtin.
@@ -115,6 +116,7 @@ class BuiltinTable {
 
  private:
   void defineSyncFetchAndAddBuiltins();
+  void defineAtomicBuiltins();
   void defineIntrinsicBuiltins();
   void defineTrigBuiltins();
   void defineExprBuiltins();
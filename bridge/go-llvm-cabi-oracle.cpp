@@ -401,7 +401,7 @@ llvm::Type *CABIParamInfo::computeABIStructType(TypeManager *tm) const
   return llst;
 }
 
-void CABIParamInfo::dump()
+void CABIParamInfo::dump() const
 {
   std::string s;
   llvm::raw_string_ostream os(s);
@@ -409,7 +409,7 @@ void CABIParamInfo::dump()
   std::cerr << os.str();
 }
 
-void CABIParamInfo::osdump(llvm::raw_ostream &os)
+void CABIParamInfo::osdump(llvm::raw_ostream &os) const
 {
   os << (disp() == ParmDirect ? "Direct" :
          (disp() == ParmIgnore ? "Ignore" :
@@ -506,13 +506,13 @@ const llvm::DataLayout *CABIOracle::datalayout() const
   return typeManager_->datalayout();
 }
 
-llvm::FunctionType *CABIOracle::getFunctionTypeForABI()
+llvm::FunctionType *CABIOracle::getFunctionTypeForABI() const
 {
   assert(supported());
   return fcnTypeForABI_;
 }
 
-const CABIParamInfo &CABIOracle::paramInfo(unsigned idx)
+const CABIParamInfo &CABIOracle::paramInfo(unsigned idx) const
 {
   assert(supported());
   // Slot 0: return info
@@ -523,7 +523,7 @@ const CABIParamInfo &CABIOracle::paramInfo(unsigned idx)
   return infov_[pidx];
 }
 
-const CABIParamInfo &CABIOracle::returnInfo()
+const CABIParamInfo &CABIOracle::returnInfo() const
 {
   assert(supported());
   unsigned ridx = 0;
@@ -531,7 +531,7 @@ const CABIParamInfo &CABIOracle::returnInfo()
   return infov_[ridx];
 }
 
-const CABIParamInfo &CABIOracle::chainInfo()
+const CABIParamInfo &CABIOracle::chainInfo() const
 {
   assert(supported());
   unsigned ridx = 1;
@@ -539,12 +539,12 @@ const CABIParamInfo &CABIOracle::chainInfo()
   return infov_[ridx];
 }
 
-void CABIOracle::dump()
+void CABIOracle::dump() const
 {
   std::cerr << toString();
 }
 
-std::string CABIOracle::toString()
+std::string CABIOracle::toString() const
 {
   std::string s;
   llvm::raw_string_ostream os(s);
@@ -552,7 +552,7 @@ std::string CABIOracle::toString()
   return os.str();
 }
 
-void CABIOracle::osdump(llvm::raw_ostream &os)
+void CABIOracle::osdump(llvm::raw_ostream &os) const
 {
   os << "Return: ";
   infov_[0].osdump(os);
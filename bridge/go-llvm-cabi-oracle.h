@@ -125,8 +125,8 @@ class CABIParamInfo {
   // for this param (may be a 1-element struct or a 2-element struct).
   llvm::Type *computeABIStructType(TypeManager *tm) const;
 
-  void dump();
-  void osdump(llvm::raw_ostream &os);
+  void dump() const;
+  void osdump(llvm::raw_ostream &os) const;
 
  private:
   std::vector<llvm::Type *> abiTypes_;
@@ -161,25 +161,25 @@ class CABIOracle {
 
   // Return the appropriate "cooked" LLVM function type for this
   // abstract function type.
-  llvm::FunctionType *getFunctionTypeForABI();
+  llvm::FunctionType *getFunctionTypeForABI() const;
 
   // Given the index of a parameter in the abstract function type,
   // return info on how the param is handled with respects to the ABI.
-  const CABIParamInfo &paramInfo(unsigned idx);
+  const CABIParamInfo &paramInfo(unsigned idx) const;
 
   // Return info on transmission of return value.
-  const CABIParamInfo &returnInfo();
+  const CABIParamInfo &returnInfo() const;
 
   // Return info on the static chain parameter for the function.
-  const CABIParamInfo &chainInfo();
+  const CABIParamInfo &chainInfo() const;
 
   // Type manager used with this oracle.
   TypeManager *tm() const { return typeManager_; }
 
   // Various dump methods.
-  void dump();
-  std::string toString();
-  void osdump(llvm::raw_ostream &os);
+  void dump() const;
+  std::string toString() const;
+  void osdump(llvm::raw_ostream &os) const;
 
  private:
   std::vector<Btype *> fcnParamTypes_;
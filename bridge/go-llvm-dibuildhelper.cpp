@@ -30,7 +30,9 @@ DIBuildHelper::DIBuildHelper(llvm::Module *module,
                              Llvm_linemap *linemap)
     : module_(module), typemanager_(typemanager), linemap_(linemap), moduleScope_(nullptr),
       dibuilder_(new llvm::DIBuilder(*module)), topblock_(nullptr),
-      entryBlock_(nullptr), known_locations_(0)
+      entryBlock_(nullptr), known_locations_(0),
+      debugInfoForProfiling_(false), lastLocHandle_(0),
+      lastLocScope_(nullptr), lastDILocation_(nullptr)
 {
 }
 
@@ -50,7 +52,12 @@ void DIBuildHelper::createCompileUnitIfNeeded()
   moduleScope_ =
       dibuilder_->createCompileUnit(llvm::dwarf::DW_LANG_Go, primaryFile,
                                     "llvm-goc", isOptimized,
-                                    compileFlags, runtimeVersion);
+                                    compileFlags, runtimeVersion,
+                                    /*SplitName=*/"",
+                                    llvm::DICompileUnit::FullDebug,
+                                    /*DWOId=*/0,
+                                    /*SplitDebugInlining=*/true,
+                                    debugInfoForProfiling_);
   pushDIScope(moduleScope_);
 }
 
@@ -252,11 +259,12 @@ void DIBuildHelper::beginLexicalBlock(Bblock *block)
 
   // Register block with DIBuilder
   Location bloc = block->location();
-  llvm::DIFile *file = diFileFromLocation(block->location());
+  Llvm_linemap::FLC flc = linemap()->decode(bloc);
+  llvm::DIFile *file =
+      diFileForIndex(flc.fidx, linemap()->is_predeclared(bloc));
   llvm::DILexicalBlock *dilb =
       dibuilder().createLexicalBlock(currentDIScope(), file,
-                                     linemap()->location_line(bloc),
-                                     linemap()->location_column(bloc));
+                                     flc.line, flc.column);
   pushDIScope(dilb);
 }
 
@@ -298,6 +306,7 @@ void DIBuildHelper::addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef> p
   std::string from(pref.first);
   std::string to(pref.second);
   debugPrefixMap_[from] = to;
+  difiles_.clear();
 }
 
 std::string DIBuildHelper::applyDebugPrefix(llvm::StringRef path) {
@@ -308,14 +317,28 @@ std::string DIBuildHelper::applyDebugPrefix(llvm::StringRef path) {
   return path.str();
 }
 
-llvm::DIFile *DIBuildHelper::diFileFromLocation(Location location)
+llvm::DIFile *DIBuildHelper::diFileForIndex(unsigned fidx, bool predeclared)
 {
-  std::string locfile = applyDebugPrefix(linemap()->location_file(location));
+  // The predeclared location has a file index of its own, so caching
+  // by index alone is safe here.
+  if (fidx < difiles_.size() && difiles_[fidx])
+    return difiles_[fidx];
+  if (fidx >= difiles_.size())
+    difiles_.resize(fidx + 1, nullptr);
+
+  std::string locfile = applyDebugPrefix(linemap()->file_name(fidx));
   llvm::StringRef locdir = llvm::sys::path::parent_path(locfile);
   llvm::StringRef locfilename = llvm::sys::path::filename(locfile);
-  if (linemap()->is_predeclared(location))
+  if (predeclared)
     locdir = "";
-  return dibuilder().createFile(locfilename, locdir);
+  difiles_[fidx] = dibuilder().createFile(locfilename, locdir);
+  return difiles_[fidx];
+}
+
+llvm::DIFile *DIBuildHelper::diFileFromLocation(Location location)
+{
+  Llvm_linemap::FLC flc = linemap()->decode(location);
+  return diFileForIndex(flc.fidx, linemap()->is_predeclared(location));
 }
 
 llvm::DebugLoc DIBuildHelper::debugLocFromLocation(Location loc)
@@ -325,8 +348,10 @@ llvm::DebugLoc DIBuildHelper::debugLocFromLocation(Location loc)
   // In the (somewhat unusual) case of a file/line directive, create a new
   // pseudo-scope to capture the fact that the file has changed. Pop off
   // any previously created file scope prior to doing this.
+  Llvm_linemap::FLC flc = linemap()->decode(loc);
   llvm::DIFile *curFile = currentDIScope()->getFile();
-  llvm::DIFile *locFile = diFileFromLocation(loc);
+  llvm::DIFile *locFile =
+      diFileForIndex(flc.fidx, linemap()->is_predeclared(loc));
   if (curFile != locFile) {
     cleanFileScope();
     llvm::DILexicalBlockFile *dilbf =
@@ -334,9 +359,18 @@ llvm::DebugLoc DIBuildHelper::debugLocFromLocation(Location loc)
     pushDIScope(dilbf);
   }
 
-  return llvm::DILocation::get(context, linemap()->location_line(loc),
-                               linemap()->location_column(loc),
-                               currentDIScope());
+  // Consecutive instructions frequently share a location; reuse the
+  // previous DILocation if nothing has changed.
+  llvm::DIScope *scope = currentDIScope();
+  if (lastDILocation_ && loc.handle() == lastLocHandle_ &&
+      scope == lastLocScope_)
+    return lastDILocation_;
+
+  lastLocHandle_ = loc.handle();
+  lastLocScope_ = scope;
+  lastDILocation_ = llvm::DILocation::get(context, flc.line, flc.column,
+                                          scope);
+  return lastDILocation_;
 }
 
 llvm::DIScope *DIBuildHelper::currentDIScope()
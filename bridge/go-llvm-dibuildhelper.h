@@ -71,6 +71,9 @@ class DIBuildHelper {
   // Support for -fdebug-prefix
   void addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef>);
 
+  // Mark the compile unit as carrying debug info for sample profiling.
+  void setDebugInfoForProfiling(bool b) { debugInfoForProfiling_ = b; }
+
   // Return module scope
   llvm::DIScope *moduleScope() const { return moduleScope_; }
 
@@ -111,10 +114,21 @@ class DIBuildHelper {
   Bblock *topblock_;
   llvm::BasicBlock *entryBlock_;
   unsigned known_locations_;
+  bool debugInfoForProfiling_;
+
+  // DIFile for each linemap file index, created on first use.
+  std::vector<llvm::DIFile*> difiles_;
+
+  // Most recently created DILocation and the location/scope it was
+  // created for.
+  unsigned lastLocHandle_;
+  llvm::DIScope *lastLocScope_;
+  llvm::DILocation *lastDILocation_;
 
  private:
   void createCompileUnitIfNeeded();
   llvm::DebugLoc debugLocFromLocation(Location location);
+  llvm::DIFile *diFileForIndex(unsigned fidx, bool predeclared);
   void insertVarDecl(Bvariable *var, llvm::DILocalVariable *dilv);
   bool interestingBlock(Bblock *block);
   void processVarsInBLock(const std::vector<Bvariable*> &vars,
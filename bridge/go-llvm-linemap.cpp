@@ -7,6 +7,7 @@
 #include "go-location.h"
 #include "go-llvm-linemap.h"
 
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/LEB128.h"
 
 #include <sstream>
@@ -14,63 +15,219 @@
 
 static constexpr unsigned NoHandle = 0xffffffff;
 
+// Pack the first handle and file ID of a shard's open segment.
+static uint64_t packOpenSegment(unsigned first, unsigned fidx)
+{
+  return (static_cast<uint64_t>(first) << 32) | fidx;
+}
+
+// Used to give each linemap a distinct identity in the per-thread
+// caches (addresses can be reused once a linemap is deleted).
+static std::atomic<uint64_t> linemapSerial(0);
+
+// Per-thread decode cache. Consumers tend to decode the same location
+// several times in a row (for example, for each instruction generated
+// for an expression), and look up nearby locations after that. The
+// decode counts are folded into the linemap's totals every so often,
+// rather than on each decode, to keep threads off a shared cache line.
+namespace {
+struct DecodeCache {
+  static constexpr unsigned FlushInterval = 1024;
+
+  // Serial number of the linemap the cached state refers to.
+  uint64_t serial = 0;
+  // Most recently decoded handle and its file/line/column.
+  unsigned handle = NoHandle;
+  Llvm_linemap::FLC flc = Llvm_linemap::FLC(0, 0, 0);
+  // Shard and index of the segment most recently looked up.
+  unsigned segShard = NoHandle;
+  unsigned segment = 0;
+  // Decodes (and cache hits) not yet added to the linemap's totals.
+  unsigned decodes = 0;
+  unsigned hits = 0;
+};
+}
+
+static thread_local DecodeCache decodeCache;
+
 Linemap* Linemap::instance_ = NULL;
 
+Llvm_linemap::Shard::Shard(unsigned idx, bool isShared)
+    : index(idx)
+    , shared(isShared)
+    , open(packOpenSegment(NoHandle, 0))
+    , firsthandle(NoHandle)
+    , lasthandle(NoHandle)
+    , open_fidx(0)
+    , lookups(0)
+{
+}
+
+Llvm_linemap::Writer::Writer()
+    : current_fidx(0)
+    , current_line(0xffffffff)
+    , in_file(false)
+    , shard(nullptr)
+{
+}
+
 Llvm_linemap::Llvm_linemap()
     : Linemap()
+    , nshards_(0)
+    , decodes_(0)
+    , decodeHits_(0)
+    , serial_(++linemapSerial)
     , unknown_fidx_(0)
     , builtin_fidx_(1)
-    , current_fidx_(0)
-    , current_line_(0xffffffff)
     , builtin_handle_(NoHandle)
     , unknown_handle_(NoHandle)
-    , firsthandle_(NoHandle)
-    , lasthandle_(NoHandle)
-    , lookups_(0)
-    , in_file_(false)
 {
+  for (auto &s : shards_)
+    s.store(nullptr, std::memory_order_relaxed);
   files_.push_back("");
   files_.push_back("<built-in>");
-  unknown_handle_ = add_encoded_location(FLC(unknown_fidx_, 0, 0));
-  builtin_handle_ = add_encoded_location(FLC(builtin_fidx_, 1, 1));
-  segments_.push_back(Segment(unknown_handle_, unknown_handle_, unknown_fidx_));
-  segments_.push_back(Segment(builtin_handle_, builtin_handle_, builtin_fidx_));
+
+  // Shard 0 holds the predefined locations, and is not handed out.
+  Shard *sh = new Shard(nshards_, false);
+  shards_[nshards_++].store(sh, std::memory_order_release);
+  add_encoded_location(sh, FLC(unknown_fidx_, 0, 0), &unknown_handle_);
+  add_encoded_location(sh, FLC(builtin_fidx_, 1, 1), &builtin_handle_);
+  sh->segments.push_back(Segment(unknown_handle_, unknown_handle_,
+                                 unknown_fidx_));
+  sh->segments.push_back(Segment(builtin_handle_, builtin_handle_,
+                                 builtin_fidx_));
 }
 
 Llvm_linemap::~Llvm_linemap()
 {
+  for (auto &s : shards_)
+    delete s.load(std::memory_order_relaxed);
+  for (auto &w : writers_)
+    delete w.second;
 }
 
-unsigned Llvm_linemap::add_encoded_location(const FLC &flc)
+Llvm_linemap::Writer *Llvm_linemap::writer()
+{
+  // Fast path: this thread has already looked up its cursor.
+  static thread_local uint64_t cachedSerial = 0;
+  static thread_local Writer *cachedWriter = nullptr;
+  if (cachedSerial == serial_)
+    return cachedWriter;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Writer *&w = writers_[std::this_thread::get_id()];
+  if (!w)
+    w = new Writer();
+  cachedSerial = serial_;
+  cachedWriter = w;
+  return w;
+}
+
+Llvm_linemap::Shard *Llvm_linemap::acquireShard()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (nshards_ < MaxShards - 1) {
+    Shard *sh = new Shard(nshards_, false);
+    shards_[nshards_++].store(sh, std::memory_order_release);
+    return sh;
+  }
+  if (nshards_ == MaxShards - 1) {
+    Shard *sh = new Shard(nshards_, true);
+    shards_[nshards_++].store(sh, std::memory_order_release);
+  }
+  return shards_[MaxShards - 1].load(std::memory_order_relaxed);
+}
+
+bool Llvm_linemap::add_encoded_location(Shard *sh, const FLC &flc,
+                                        unsigned *handle)
 {
   unsigned char buf[64];
   unsigned l1 = llvm::encodeULEB128(flc.line, buf);
   unsigned l2 = llvm::encodeULEB128(flc.column, &buf[l1]);
-  unsigned tot = l1 + l2;
-  unsigned handle = encoded_locations_.size();
-  for (unsigned i = 0; i < tot; ++i)
-    encoded_locations_.push_back(buf[i]);
-  return handle;
+  uint64_t offset = sh->encoded.append(buf, l1 + l2);
+  if (offset == sh->encoded.Capacity)
+    return false;
+  *handle = (sh->index << OffsetBits) | static_cast<unsigned>(offset);
+  return true;
+}
+
+void Llvm_linemap::close_segment(Shard *sh)
+{
+  if (sh->firsthandle == NoHandle)
+    return;
+  Segment seg(sh->firsthandle, sh->lasthandle, sh->open_fidx);
+  if (sh->segments.push_back(seg) == sh->segments.Capacity)
+    llvm::report_fatal_error("linemap segment table full");
+  sh->firsthandle = NoHandle;
+  sh->lasthandle = NoHandle;
 }
 
 Llvm_linemap::FLC Llvm_linemap::decode_location(unsigned handle)
 {
-  assert(handle < encoded_locations_.size());
+  DecodeCache &cache = decodeCache;
+  if (cache.serial != serial_) {
+    cache = DecodeCache();
+    cache.serial = serial_;
+  }
+  if (++cache.decodes == DecodeCache::FlushInterval) {
+    decodes_.fetch_add(cache.decodes, std::memory_order_relaxed);
+    decodeHits_.fetch_add(cache.hits, std::memory_order_relaxed);
+    cache.decodes = cache.hits = 0;
+  }
+
+  // The file ID for a given handle never changes (handles in the open
+  // segment belong to the file of that segment, and the segment is
+  // closed out with that same file ID), so it's safe to cache the
+  // result.
+  if (handle == cache.handle) {
+    cache.hits++;
+    return cache.flc;
+  }
+
+  unsigned sidx = handle >> OffsetBits;
+  unsigned offset = handle & ((1u << OffsetBits) - 1);
+  assert(sidx < MaxShards);
+  Shard *owner = shards_[sidx].load(std::memory_order_acquire);
+  assert(owner && offset < owner->encoded.size());
 
   // Read line/col from encoded array
   FLC rval(0, 0, 0);
-  unsigned char *lptr = &encoded_locations_[handle];
+  const unsigned char *lptr = &owner->encoded[offset];
   unsigned c1;
   rval.line = llvm::decodeULEB128(lptr, &c1);
   unsigned c2;
   rval.column = llvm::decodeULEB128(&lptr[c1], &c2);
-  assert(handle + c1 + c2 <= encoded_locations_.size());
+  assert(offset + c1 + c2 <= owner->encoded.size());
+
+  // Determine file ID: first check the owner's open segment, then the
+  // segment we found last time, and finally search the owner's segment
+  // table. The open segment has to be read first: a writer closes out
+  // a segment before publishing a new open one.
+  uint64_t open = owner->open.load(std::memory_order_acquire);
+  const auto &segments = owner->segments;
+  if (handle >= static_cast<unsigned>(open >> 32)) {
+    rval.fidx = static_cast<unsigned>(open);
+  } else if (cache.segShard == sidx &&
+             segments[cache.segment].lo <= handle &&
+             handle <= segments[cache.segment].hi) {
+    rval.fidx = segments[cache.segment].fidx;
+  } else {
+    unsigned lo = 0, hi = segments.size();
+    while (lo < hi) {
+      unsigned mid = lo + (hi - lo) / 2;
+      if (segments[mid].hi < handle)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    assert(lo < segments.size());
+    rval.fidx = segments[lo].fidx;
+    cache.segShard = sidx;
+    cache.segment = lo;
+  }
 
-  // Determine file ID by looking up handle in segment table
-  Segment s(handle, handle, 0);
-  auto it = std::lower_bound(segments_.begin(), segments_.end(), s,
-                             Segment::cmp);
-  rval.fidx = (it == segments_.end() ? current_fidx_ : it->fidx);
+  cache.handle = handle;
+  cache.flc = rval;
   return rval;
 }
 
@@ -79,25 +236,26 @@ Llvm_linemap::FLC Llvm_linemap::decode_location(unsigned handle)
 void
 Llvm_linemap::start_file(const char *file_name, unsigned line_begin)
 {
-  if (firsthandle_ != NoHandle) {
-    // Close out the current segment
-    segments_.push_back(Segment(firsthandle_, lasthandle_, current_fidx_));
-  }
-  firsthandle_ = NoHandle;
-  lasthandle_ = NoHandle;
+  Writer *w = writer();
 
   // Locate the file in the file table, adding new entry if needed
-  auto it = fmap_.find(std::string(file_name));
-  unsigned fidx = files_.size();
-  if (it != fmap_.end())
-    fidx = it->second;
-  else {
-    files_.push_back(std::string(file_name));
-    fmap_[file_name] = fidx;
+  unsigned fidx;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fmap_.find(std::string(file_name));
+    if (it != fmap_.end())
+      fidx = it->second;
+    else {
+      uint64_t idx = files_.push_back(std::string(file_name));
+      if (idx == files_.Capacity)
+        llvm::report_fatal_error("linemap file table full");
+      fidx = static_cast<unsigned>(idx);
+      fmap_[file_name] = fidx;
+    }
   }
-  current_fidx_ = fidx;
-  current_line_ = line_begin;
-  in_file_ = true;
+  w->current_fidx = fidx;
+  w->current_line = line_begin;
+  w->in_file = true;
 }
 
 // Stringify a location
@@ -143,7 +301,7 @@ Llvm_linemap::location_column(Location loc)
 void
 Llvm_linemap::stop()
 {
-  in_file_ = false;
+  writer()->in_file = false;
 }
 
 // Start a new line.
@@ -151,7 +309,7 @@ Llvm_linemap::stop()
 void
 Llvm_linemap::start_line(unsigned lineno, unsigned linesize)
 {
-  current_line_ = lineno;
+  writer()->current_line = lineno;
 }
 
 // Get a location.
@@ -159,15 +317,42 @@ Llvm_linemap::start_line(unsigned lineno, unsigned linesize)
 Location
 Llvm_linemap::get_location(unsigned column)
 {
-  assert(in_file_);
-
-  lookups_++;
-  FLC flc(current_fidx_, current_line_, column);
-  unsigned handle = add_encoded_location(flc);
-  if (firsthandle_ == NoHandle)
-    firsthandle_ = handle;
-  lasthandle_ = handle;
-  return Location(handle);
+  Writer *w = writer();
+  assert(w->in_file);
+
+  FLC flc(w->current_fidx, w->current_line, column);
+  for (;;) {
+    if (!w->shard)
+      w->shard = acquireShard();
+    Shard *sh = w->shard;
+    std::unique_lock<std::mutex> lock(sharedMutex_, std::defer_lock);
+    if (sh->shared)
+      lock.lock();
+
+    unsigned handle;
+    if (add_encoded_location(sh, flc, &handle)) {
+      sh->lookups++;
+      // Handles within a segment have to come from a single file; a
+      // shard switches files when its writer starts a new one, or
+      // when another writer appends to the shared shard.
+      if (sh->firsthandle != NoHandle && sh->open_fidx != flc.fidx)
+        close_segment(sh);
+      if (sh->firsthandle == NoHandle) {
+        sh->firsthandle = handle;
+        sh->open_fidx = flc.fidx;
+        sh->open.store(packOpenSegment(handle, flc.fidx),
+                       std::memory_order_release);
+      }
+      sh->lasthandle = handle;
+      return Location(handle);
+    }
+
+    // This shard is full; retire it and move on to another.
+    if (sh->shared)
+      llvm::report_fatal_error("linemap location table full");
+    close_segment(sh);
+    w->shard = nullptr;
+  }
 }
 
 std::string
@@ -210,16 +395,38 @@ Llvm_linemap::is_unknown(Location loc)
   return loc.handle() == unknown_handle_;
 }
 
+// Statistics are summed over all shards; this is expected to be
+// called once the threads using the linemap are done with it. Decode
+// counts from threads other than the caller may be short by up to a
+// flush interval per thread.
+
 std::string Llvm_linemap::statistics()
 {
-  double nbl = (encoded_locations_.size() ?
-                ((double)encoded_locations_.size())/((double)lookups_) : 0);
+  unsigned lookups = 0, segments = 0, locmem = 0;
+  unsigned decodes = decodes_.load(std::memory_order_relaxed);
+  unsigned decode_hits = decodeHits_.load(std::memory_order_relaxed);
+  if (decodeCache.serial == serial_) {
+    decodes += decodeCache.decodes;
+    decode_hits += decodeCache.hits;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (unsigned ii = 0; ii < nshards_; ++ii) {
+      Shard *sh = shards_[ii].load(std::memory_order_acquire);
+      lookups += sh->lookups;
+      segments += sh->segments.size();
+      locmem += sh->encoded.size();
+    }
+  }
+  double nbl = (locmem ? ((double)locmem)/((double)lookups) : 0);
   std::stringstream ss;
-  ss << "accesses=" << lookups_
+  ss << "accesses=" << lookups
      << " files=" << files_.size()
-     << " segments=" << segments_.size()
-     << " locmem=" << encoded_locations_.size()
-     << " bytes/location=" << std::setprecision(2) << nbl;
+     << " segments=" << segments
+     << " locmem=" << locmem
+     << " bytes/location=" << std::setprecision(2) << nbl
+     << " decodes=" << decodes
+     << " decodehits=" << decode_hits;
   return ss.str();
 }
 
@@ -239,16 +446,21 @@ void Llvm_linemap::dump()
   std::cerr << "Files:\n";
   for (unsigned ii = 0; ii < files_.size(); ++ii)
     std::cerr << ii << ": " << files_[ii] << "\n";
-  std::cerr << "Segments:\n";
-  for (unsigned ii = 0; ii < segments_.size(); ++ii) {
-    unsigned lo = segments_[ii].lo;
-    unsigned hi = segments_[ii].hi;
-    std::cerr << ii << ": [" << lo << "," << hi << "] lo='"
-              << to_string(Location(lo)) << "' hi='"
-              << to_string(Location(hi)) << "'\n";
+  for (unsigned si = 0; si < MaxShards; ++si) {
+    Shard *sh = shards_[si].load(std::memory_order_acquire);
+    if (!sh)
+      break;
+    std::cerr << "Shard " << si << " segments:\n";
+    for (unsigned ii = 0; ii < sh->segments.size(); ++ii) {
+      unsigned lo = sh->segments[ii].lo;
+      unsigned hi = sh->segments[ii].hi;
+      std::cerr << ii << ": [" << lo << "," << hi << "] lo='"
+                << to_string(Location(lo)) << "' hi='"
+                << to_string(Location(hi)) << "'\n";
+    }
+    std::cerr << "open: "
+              << static_cast<unsigned>(sh->open.load() >> 32) << "\n";
   }
-  std::cerr << "firsthandle: " << firsthandle_ << "\n";
-  std::cerr << "lasthandle: " << lasthandle_ << "\n";
 }
 
 // Return the singleton Linemap to use for the backend.
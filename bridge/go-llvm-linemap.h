@@ -19,12 +19,32 @@
 // common line/column pairs, meaning that there can be some redundancy
 // in the encodings.
 //
+// To allow several threads to read source files at the same time,
+// the encoded pairs and file ranges are kept in shards: the top bits
+// of a handle select the shard, the remaining bits give the offset
+// within the shard. A thread is given a shard of its own the first
+// time it asks for a location; if it fills that shard it moves on to
+// a fresh one. Once all but the last shard have been handed out, the
+// remaining writers share the last one, serializing their appends
+// with a mutex. Shard storage is append-only and never moved, so
+// handles can be decoded from any thread without locking, and
+// decoding never allocates. The file table is shared, and is guarded
+// by a mutex.
+//
 
 #ifndef GO_LLVM_LINEMAP_H
 #define GO_LLVM_LINEMAP_H
 
 #include "go-linemap.h"
 
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
 class Llvm_linemap : public Linemap
 {
  public:
@@ -77,8 +97,6 @@ class Llvm_linemap : public Linemap
   static Llvm_linemap*
   instance();
 
- private:
-
   // File/line/column container
   struct FLC {
     unsigned fidx;
@@ -89,6 +107,18 @@ class Llvm_linemap : public Linemap
     { }
   };
 
+  // Return the file index, line and column for a location with a
+  // single lookup (as opposed to calling location_file, location_line
+  // and location_column, each of which decodes the location).
+  FLC
+  decode(Location loc) { return decode_location(loc.handle()); }
+
+  // Return the path of the file with the specified index.
+  const std::string &
+  file_name(unsigned fidx) const { return files_[fidx]; }
+
+ private:
+
   // Stores the file ID associated with a range of handle
   struct Segment {
     // lo/hi handles in this range
@@ -96,6 +126,7 @@ class Llvm_linemap : public Linemap
     // file id for this collection of handles
     unsigned fidx;
 
+    Segment() : lo(0), hi(0), fidx(0) { }
     Segment(unsigned low, unsigned high, unsigned fileid)
         : lo(low), hi(high), fidx(fileid) { }
 
@@ -104,9 +135,127 @@ class Llvm_linemap : public Linemap
     }
   };
 
-  // Given a file/line/column triple, add an entry to the linemap for
-  // the triple and return a handle for it.
-  unsigned add_encoded_location(const FLC &flc);
+  // Append-only table made up of fixed-size chunks, so that elements
+  // never move once added. Appends have to be serialized by the
+  // caller; elements below size() can be read from any thread.
+  template<typename T, unsigned ChunkBits, unsigned MaxChunks>
+  class StableTable {
+   public:
+    StableTable() : size_(0) {
+      for (auto &c : chunks_)
+        c.store(nullptr, std::memory_order_relaxed);
+    }
+    ~StableTable() {
+      for (auto &c : chunks_)
+        delete [] c.load(std::memory_order_relaxed);
+    }
+
+    static constexpr unsigned ChunkSize = 1u << ChunkBits;
+    static constexpr uint64_t Capacity = (uint64_t) ChunkSize * MaxChunks;
+
+    unsigned size() const { return size_.load(std::memory_order_acquire); }
+
+    const T &operator[](unsigned idx) const {
+      T *chunk = chunks_[idx >> ChunkBits].load(std::memory_order_acquire);
+      return chunk[idx & (ChunkSize - 1)];
+    }
+
+    // Append 'n' elements, which are placed in a single chunk (padding
+    // out the current chunk if need be), and return the index of the
+    // first one. Returns Capacity if the table is full.
+    uint64_t append(const T *vals, unsigned n) {
+      assert(n <= ChunkSize);
+      unsigned idx = size_.load(std::memory_order_relaxed);
+      if ((idx & (ChunkSize - 1)) + n > ChunkSize)
+        idx = (idx + ChunkSize) & ~(ChunkSize - 1);
+      if ((uint64_t) idx + n > Capacity)
+        return Capacity;
+      T *chunk = chunkFor(idx);
+      for (unsigned i = 0; i < n; ++i)
+        chunk[(idx & (ChunkSize - 1)) + i] = vals[i];
+      size_.store(idx + n, std::memory_order_release);
+      return idx;
+    }
+    uint64_t push_back(const T &val) { return append(&val, 1); }
+
+   private:
+    T *chunkFor(unsigned idx) {
+      std::atomic<T*> &slot = chunks_[idx >> ChunkBits];
+      T *chunk = slot.load(std::memory_order_relaxed);
+      if (!chunk) {
+        chunk = new T[ChunkSize]();
+        slot.store(chunk, std::memory_order_release);
+      }
+      return chunk;
+    }
+
+    std::atomic<T*> chunks_[MaxChunks];
+    std::atomic<unsigned> size_;
+  };
+
+  // Handles are made up of a shard index and an offset within the shard.
+  static constexpr unsigned ShardBits = 6;
+  static constexpr unsigned OffsetBits = 32 - ShardBits;
+  static constexpr unsigned MaxShards = 1u << ShardBits;
+
+  // Location storage.
+  struct Shard {
+    Shard(unsigned idx, bool isShared);
+
+    // Index of this shard in shards_.
+    unsigned index;
+    // Whether this is the overflow shard used by several threads.
+    bool shared;
+    // ULEB-encoded line/col pairs.
+    StableTable<unsigned char, 16, (1u << (OffsetBits - 16))> encoded;
+    // Sorted table of closed segments, recording the file id for
+    // ranges of handles.
+    StableTable<Segment, 10, 1024> segments;
+    // First handle and file id of the segment we are building (not
+    // yet in the segment table), packed into a single word so that
+    // other threads see a consistent pair. The first handle may be
+    // NoHandle if there are no locations in the segment yet.
+    std::atomic<uint64_t> open;
+
+    // Remaining fields are only used by the writer(s) of the shard.
+
+    // First/last handle and file ID of the segment we are building.
+    unsigned firsthandle;
+    unsigned lasthandle;
+    unsigned open_fidx;
+    // Number of locations handed out from this shard.
+    unsigned lookups;
+  };
+
+  // Per-thread cursor state for a thread reading a source file.
+  struct Writer {
+    Writer();
+
+    // Current file ID (most recent file passed to start_file)
+    unsigned current_fidx;
+    // Current line.
+    unsigned current_line;
+    // Whether we are currently reading a file.
+    bool in_file;
+    // Shard that locations are added to (allocated on first use).
+    Shard *shard;
+  };
+
+  // Return the cursor state for the calling thread, creating it if
+  // needed.
+  Writer *writer();
+
+  // Return a fresh shard for a writer, or the shared shard if they
+  // have all been handed out.
+  Shard *acquireShard();
+
+  // Add an entry to shard 'sh' for the file/line/column triple, and
+  // store a handle for it in 'handle'. Returns false if the shard is
+  // full. Caller must hold sharedMutex_ if the shard is shared.
+  bool add_encoded_location(Shard *sh, const FLC &flc, unsigned *handle);
+
+  // Move the segment that 'sh' is building into its segment table.
+  void close_segment(Shard *sh);
 
   // Given a handle, return the associated file/line/column triple.
   FLC decode_location(unsigned handle);
@@ -118,35 +267,32 @@ class Llvm_linemap : public Linemap
 
  private:
   // Source files we've seen so far.
-  std::vector<std::string> files_;
+  StableTable<std::string, 8, 4096> files_;
   // Maps source file to index in the files_ array.
   std::map<std::string, unsigned> fmap_;
-  // Sorted table of segments, used to record file id for ranges of handles.
-  std::vector<Segment> segments_;
-  // Array of ULEB-encoded line/col pairs.
-  std::vector<unsigned char> encoded_locations_;
+  // Shards, indexed by the shard bits of a handle.
+  std::atomic<Shard*> shards_[MaxShards];
+  // Number of shards created so far.
+  unsigned nshards_;
+  // Cursor state for each thread that has started a file.
+  std::unordered_map<std::thread::id, Writer*> writers_;
+  // Guards files_/fmap_ updates and writer/shard creation.
+  std::mutex mutex_;
+  // Serializes appends to the shared shard.
+  std::mutex sharedMutex_;
+  // Decode statistics, accumulated from the per-thread decode caches.
+  std::atomic<unsigned> decodes_;
+  std::atomic<unsigned> decodeHits_;
+  // Identifies this linemap in the per-thread caches.
+  uint64_t serial_;
   // Predefined "unknown file" file ID.
   unsigned unknown_fidx_;
   // Predefined file ID for predeclared or builtin locations.
   unsigned builtin_fidx_;
-  // Current file ID (most recent file passed to start_file)
-  unsigned current_fidx_;
-  // Current line.
-  unsigned current_line_;
   // Special handle for predeclared location.
   unsigned builtin_handle_;
   // Special handle for unknown location.
   unsigned unknown_handle_;
-  // First handle in the segment we are building (not yet in segment table).
-  // May be set to NoHandle if there are no locations in the segment yet.
-  unsigned firsthandle_;
-  // Last handle in the segment we are building (not yet in segment table).
-  // May be set to NoHandle if there are no locations in the segment yet.
-  unsigned lasthandle_;
-  // Number of lookups made into the linemap.
-  unsigned lookups_;
-  // Whether we are currently reading a file.
-  bool in_file_;
 };
 
 // Main hook for linemap creation
@@ -34,6 +34,7 @@ Bexpression *Llvm_backend::materializeIndirect(Bexpression *indExpr, bool isLHS)
 {
   Location location = indExpr->location();
   Btype *btype = indExpr->btype();
+  bool knownValid = indExpr->knownValid();
   std::vector<Bexpression *> iexprs =
       nbuilder_.extractChildenAndDestroy(indExpr);
   assert(iexprs.size() == 1);
@@ -45,6 +46,8 @@ Bexpression *Llvm_backend::materializeIndirect(Bexpression *indExpr, bool isLHS)
   //
   // where we have a LHS expression intended to cause a crash or fault.
   if (isLHS && !expr->varExprPending()) {
+    if (knownValid)
+      annotateKnownValidPointer(expr->value(), btype);
     Bexpression *rval = nbuilder_.mkDeref(btype, expr->value(), expr,
                                           location);
     return rval;
@@ -64,6 +67,12 @@ Bexpression *Llvm_backend::materializeIndirect(Bexpression *indExpr, bool isLHS)
 
   std::string tag(expr->tag().size() == 0 ? "deref" : expr->tag());
   Bexpression *rval = genLoad(expr, btype, location, tag);
+
+  // When 'expr' is a pending var expression, the load above produces
+  // the pointer being dereferenced (the load through it comes later,
+  // when the result is resolved); otherwise 'expr' is the pointer.
+  if (knownValid)
+    annotateKnownValidPointer(vc ? rval->value() : expr->value(), btype);
   if (vc) {
     if (rval->varExprPending())
       rval->resetVarExprContext();
@@ -211,8 +220,10 @@ Bexpression *Llvm_backend::materializeConversion(Bexpression *convExpr)
   }
 
   // For pointer conversions (ex: *int32 => *int64) create an
-  // appropriate bitcast.
+  // appropriate bitcast. Such conversions (typically via unsafe.Pointer)
+  // may let memory be accessed as a different type; see notePointerCast.
   if (valType->isPointerTy() && toType->isPointerTy()) {
+    notePointerCast(val, toType);
     std::string tag(namegen("cast"));
     llvm::Value *bitcast = builder.CreateBitCast(val, toType, tag);
     rval = nbuilder_.mkConversion(type, bitcast, expr, location);
@@ -1035,7 +1046,7 @@ Bexpression *Llvm_backend::materializeArrayIndex(Bexpression *arindExpr)
 }
 
 struct GenCallState {
-  CABIOracle oracle;
+  const CABIOracle &oracle;
   Binstructions instructions;
   BinstructionsLIRBuilder builder;
   std::vector<Bexpression *> resolvedArgs;
@@ -1049,7 +1060,7 @@ struct GenCallState {
                Bfunction *callerFunc,
                BFunctionType *calleeFcnTyp,
                TypeManager *tm)
-      : oracle(calleeFcnTyp, tm),
+      : oracle(*tm->abiOracle(calleeFcnTyp)),
         instructions(),
         builder(context, &instructions),
         chainVal(nullptr),
@@ -1231,8 +1242,12 @@ void Llvm_backend::genCallAttributes(GenCallState &state, llvm::CallInst *call)
 {
   // Sret attribute if needed
   const CABIParamInfo &returnInfo = state.oracle.returnInfo();
-  if (returnInfo.disp() == ParmIndirect)
+  if (returnInfo.disp() == ParmIndirect) {
     call->addAttribute(1, llvm::Attribute::StructRet);
+    llvm::Type *rt = state.sretTemp->getType()->getPointerElementType();
+    llvm::AttrBuilder ab = validPointerAttributes(rt);
+    call->setAttributes(call->getAttributes().addAttributes(context_, 1, ab));
+  }
 
   // Nest attribute if needed
   const CABIParamInfo &chainInfo = state.oracle.chainInfo();
@@ -1309,17 +1324,18 @@ Bexpression *Llvm_backend::materializeCall(Bexpression *callExpr)
   llvm::Value *fnval = fn_expr->value();
 
   // Some intrinsic functions need additional args. Add them.
-  // TODO: currently this is specific to llvm.cttz, llvm.memmove, and
-  // llvm.memcpy; if the list expands too much more it might make
-  // sense to incorporate a description of the extra args into the
-  // builtin table entry.
+  // TODO: currently this is specific to llvm.cttz/ctlz, llvm.memmove,
+  // llvm.memcpy and llvm.prefetch; if the list expands too much more
+  // it might make sense to incorporate a description of the extra
+  // args into the builtin table entry.
   if (llvm::isa<llvm::Function>(fnval)) {
     llvm::Function *fcn = llvm::cast<llvm::Function>(fnval);
     switch (fcn->getIntrinsicID()) {
-      case llvm::Intrinsic::cttz: {
+      case llvm::Intrinsic::cttz:
+      case llvm::Intrinsic::ctlz: {
         // @llvm.cttz.i32  (i32 <src>, i1 <is_zero_undef>)
         // Add the <is_zero_undef> arg.
-        // GCC's __builtin_ctz results undefined for 0 input.
+        // GCC's __builtin_ctz/__builtin_clz results undefined for 0 input.
         llvm::Value *con = llvm::ConstantInt::getTrue(context_);
         Btype *bt = makeAuxType(llvmBoolType());
         Bexpression *conexpr = nbuilder_.mkConst(bt, con);
@@ -1379,7 +1395,7 @@ Bexpression *Llvm_backend::materializeCall(Bexpression *callExpr)
     if (be) {
       BuiltinExprMaker makerfn = be->exprMaker();
       if (makerfn)
-        callValue = makerfn(state.llargs, &state.builder);
+        callValue = makerfn(state.llargs, &state.builder, &module());
     }
   }
   if (!callValue) {
@@ -1505,9 +1521,12 @@ Llvm_backend::convertForAssignment(Btype *srcBType,
 
   // Case 8: also when creating slice values it's common for the
   // frontend to assign pointer-to-X to unsafe.Pointer (and vice versa)
-  // without an explicit cast. Allow this for now.
+  // without an explicit cast. Allow this for now. Of the casts made
+  // here, this is the only one that can turn an unsafe.Pointer back
+  // into a typed data pointer.
   if ((dstToType == llvmPtrType() && llvm::isa<llvm::PointerType>(srcType)) ||
       (srcType == llvmPtrType() && llvm::isa<llvm::PointerType>(dstToType))) {
+    notePointerCast(srcVal, dstToType);
     std::string tag(namegen("cast"));
     llvm::Value *bitcast = builder->CreateBitCast(srcVal, dstToType, tag);
     return bitcast;
@@ -1676,7 +1695,7 @@ class VarContextVisitor {
   }
 
   Bexpression *memArg(Bexpression *expr) {
-    const std::vector<Bnode *> &kids = expr->children();
+    llvm::ArrayRef<Bnode *> kids = expr->children();
     switch(expr->flavor()) {
       case N_StructField:
       case N_ArrayIndex:
@@ -0,0 +1,168 @@
+//===-- go-llvm-runtime-attrs.cpp - attributes for runtime functions ------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Table of LLVM attributes for known libgo runtime entry points.
+//
+//===----------------------------------------------------------------------===//
+
+#include "go-llvm-runtime-attrs.h"
+#include "go-llvm-btype.h"
+#include "go-llvm-cabi-oracle.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/Function.h"
+
+namespace {
+
+enum RuntimeAttrFlags : unsigned {
+  RA_NoUnwind    = 1 << 0,
+  RA_ReadOnly    = 1 << 1,
+  RA_ArgMemOnly  = 1 << 2,
+  RA_Cold        = 1 << 3,
+  RA_NoReturn    = 1 << 4,
+  RA_NoAliasRet  = 1 << 5,
+  RA_NonNullRet  = 1 << 6,
+
+  // Frequently used combinations.
+  RA_Allocator  = RA_NoAliasRet | RA_NonNullRet,
+  RA_Comparator = RA_ReadOnly | RA_ArgMemOnly,
+  RA_Panic      = RA_Cold | RA_NoReturn,
+};
+
+struct RuntimeAttrEntry {
+  const char *asmName;
+  unsigned numParams;  // number of Go params expected
+  unsigned flags;      // RA_* bits
+  int allocSizeParam;  // Go param holding the allocation size, or -1
+};
+
+// Entries track the libgo runtime built alongside this bridge; both
+// the pre-Go 1.13 (panicindex/panicslice) and the later
+// (goPanicIndex, etc) bounds-check helpers are listed. Entries whose
+// parameter count doesn't match the declaration are skipped.
+//
+// Notes:
+//
+// - most runtime routines can panic, which in gollvm means unwinding
+//   through the caller, so nounwind is limited to routines that can
+//   only fail by throwing (a fatal error). In particular the
+//   comparators are not marked nounwind, since a fault while reading
+//   through a bad pointer has to be able to turn into a panic.
+//
+// - allocsize only applies where the byte count is passed directly;
+//   newobject/makeslice/etc compute the size from a type descriptor.
+//
+// - panic helpers are cold and noreturn, but must unwind.
+
+const RuntimeAttrEntry runtimeAttrTable[] = {
+  // Allocators
+  { "runtime.newobject", 1, RA_Allocator | RA_NoUnwind, -1 },
+  { "runtime.mallocgc", 3, RA_Allocator | RA_NoUnwind, 0 },
+  { "runtime.makeslice", 3, RA_Allocator, -1 },
+  { "runtime.makeslice64", 3, RA_Allocator, -1 },
+  { "runtime.makechan", 2, RA_Allocator, -1 },
+  { "runtime.makechan64", 2, RA_Allocator, -1 },
+  { "runtime.makemap_small", 0, RA_Allocator, -1 },
+
+  // Comparators
+  { "runtime.memequal", 3, RA_Comparator, -1 },
+  { "runtime.memequal0", 2, RA_Comparator, -1 },
+  { "runtime.memequal8", 2, RA_Comparator, -1 },
+  { "runtime.memequal16", 2, RA_Comparator, -1 },
+  { "runtime.memequal32", 2, RA_Comparator, -1 },
+  { "runtime.memequal64", 2, RA_Comparator, -1 },
+  { "runtime.memequal128", 2, RA_Comparator, -1 },
+  { "runtime.cmpstring", 2, RA_Comparator, -1 },
+
+  // Panics
+  { "runtime.gopanic", 1, RA_Panic, -1 },
+  { "runtime.throw", 1, RA_Panic, -1 },
+  { "runtime.panicmem", 0, RA_Panic, -1 },
+  { "runtime.panicdivide", 0, RA_Panic, -1 },
+  { "runtime.panicshift", 0, RA_Panic, -1 },
+  { "runtime.panicindex", 0, RA_Panic, -1 },
+  { "runtime.panicslice", 0, RA_Panic, -1 },
+  { "runtime.panicdottype", 3, RA_Panic, -1 },
+  { "runtime.panicnildottype", 1, RA_Panic, -1 },
+  { "runtime.panicmakeslicelen", 0, RA_Panic, -1 },
+  { "runtime.panicmakeslicecap", 0, RA_Panic, -1 },
+  { "runtime.goPanicIndex", 2, RA_Panic, -1 },
+  { "runtime.goPanicIndexU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSliceAlen", 2, RA_Panic, -1 },
+  { "runtime.goPanicSliceAlenU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSliceAcap", 2, RA_Panic, -1 },
+  { "runtime.goPanicSliceAcapU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSliceB", 2, RA_Panic, -1 },
+  { "runtime.goPanicSliceBU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3Alen", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3AlenU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3Acap", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3AcapU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3B", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3BU", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3C", 2, RA_Panic, -1 },
+  { "runtime.goPanicSlice3CU", 2, RA_Panic, -1 },
+};
+
+const RuntimeAttrEntry *lookupRuntimeAttrEntry(const std::string &asmName)
+{
+  static const llvm::StringMap<const RuntimeAttrEntry *> index = [] {
+    llvm::StringMap<const RuntimeAttrEntry *> m;
+    for (const RuntimeAttrEntry &e : runtimeAttrTable)
+      m[e.asmName] = &e;
+    return m;
+  }();
+  auto it = index.find(asmName);
+  return (it == index.end() ? nullptr : it->second);
+}
+
+} // namespace
+
+bool addRuntimeFunctionAttributes(llvm::Function *fcn,
+                                  const std::string &asmName,
+                                  BFunctionType *ft,
+                                  const CABIOracle &oracle)
+{
+  const RuntimeAttrEntry *e = lookupRuntimeAttrEntry(asmName);
+  if (e == nullptr || e->numParams != ft->paramTypes().size())
+    return false;
+
+  if (e->flags & RA_NoUnwind)
+    fcn->addFnAttr(llvm::Attribute::NoUnwind);
+  if (e->flags & RA_ReadOnly)
+    fcn->addFnAttr(llvm::Attribute::ReadOnly);
+  if (e->flags & RA_ArgMemOnly)
+    fcn->addFnAttr(llvm::Attribute::ArgMemOnly);
+  if (e->flags & RA_Cold)
+    fcn->addFnAttr(llvm::Attribute::Cold);
+  if (e->flags & RA_NoReturn)
+    fcn->addFnAttr(llvm::Attribute::NoReturn);
+
+  // Return and allocation size attributes only make sense if the
+  // result is returned directly as a pointer.
+  const unsigned retIdx = llvm::AttributeList::ReturnIndex;
+  if (fcn->getReturnType()->isPointerTy()) {
+    if (e->flags & RA_NoAliasRet)
+      fcn->addAttribute(retIdx, llvm::Attribute::NoAlias);
+    if (e->flags & RA_NonNullRet)
+      fcn->addAttribute(retIdx, llvm::Attribute::NonNull);
+    if (e->allocSizeParam >= 0) {
+      const CABIParamInfo &pinfo = oracle.paramInfo(e->allocSizeParam);
+      if (pinfo.disp() == ParmDirect && pinfo.numArgSlots() == 1 &&
+          pinfo.abiType()->isIntegerTy()) {
+        llvm::Attribute as =
+            llvm::Attribute::getWithAllocSizeArgs(fcn->getContext(),
+                                                  pinfo.sigOffset(),
+                                                  llvm::None);
+        fcn->addFnAttr(as);
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,37 @@
+//===-- go-llvm-runtime-attrs.h - attributes for runtime functions --------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the table of LLVM attributes for known libgo runtime
+// entry points.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVMGOFRONTEND_GO_LLVM_RUNTIME_ATTRS_H
+#define LLVMGOFRONTEND_GO_LLVM_RUNTIME_ATTRS_H
+
+#include <string>
+
+namespace llvm {
+class Function;
+}
+
+class BFunctionType;
+class CABIOracle;
+
+// If 'asmName' is a runtime entry point described by the table, add
+// the attributes it lists to 'fcn', whose Go signature is 'ft' (with
+// ABI details in 'oracle'). Each entry records the number of Go
+// params it expects; if the function being declared doesn't match
+// (for example, when compiling against a different libgo), the entry
+// is ignored. Returns true if attributes were added.
+bool addRuntimeFunctionAttributes(llvm::Function *fcn,
+                                  const std::string &asmName,
+                                  BFunctionType *ft,
+                                  const CABIOracle &oracle);
+
+#endif // LLVMGOFRONTEND_GO_LLVM_RUNTIME_ATTRS_H
@@ -15,26 +15,75 @@
 #include "go-llvm-tree-integrity.h"
 #include "go-llvm.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Instruction.h"
 
+#include <algorithm>
+
 IntegrityVisitor::IntegrityVisitor(Llvm_backend *be,
                                    TreeIntegCtl control)
     : be_(be), ss_(str_), control_(control),
       instShareCount_(0), stmtShareCount_(0), exprShareCount_(0)
 {
-  acceptableNodes_.insert(N_Const);
-  acceptableNodes_.insert(N_Call); // subject to acceptable target
-  acceptableNodes_.insert(N_FcnAddress);
-  acceptableNodes_.insert(N_Conditional);
-  acceptableNodes_.insert(N_Var);
-  acceptableNodes_.insert(N_Conversion);
-  acceptableNodes_.insert(N_Deref);
-  acceptableNodes_.insert(N_StructField);
-  acceptableNodes_.insert(N_BinaryOp); // subject to acceptableOpcodes
-  acceptableOpcodes_.insert(OPERATOR_PLUS);
-  acceptableOpcodes_.insert(OPERATOR_MINUS);
-  acceptableOpcodes_.insert(OPERATOR_EQEQ);
-  acceptableOpcodes_.insert(OPERATOR_NOTEQ);
+}
+
+// Returns TRUE if the specified expression node is one of the kinds
+// that we're willing to replicate when repairing sharing (the subtree
+// check below applies this to each node in a shared subtree).
+
+static bool repairableNode(Bexpression *e)
+{
+  switch (e->flavor()) {
+    case N_Const:
+    case N_FcnAddress:
+    case N_Conditional:
+    case N_Var:
+    case N_Conversion:
+    case N_Deref:
+    case N_StructField:
+      return true;
+    case N_Call: {
+      // ok to duplicate runtime error calls, but not other calls
+      Bfunction *target = e->getCallTarget();
+      return (target && target->name() == "__go_runtime_error");
+    }
+    case N_BinaryOp:
+      switch (e->op()) {
+        case OPERATOR_PLUS:
+        case OPERATOR_MINUS:
+        case OPERATOR_EQEQ:
+        case OPERATOR_NOTEQ:
+          return true;
+        default:
+          return false;
+      }
+    default:
+      return false;
+  }
+}
+
+static bool repairableSubTreeAt(Bexpression *root)
+{
+  std::set<Bexpression *> visited;
+  visited.insert(root);
+  std::vector<Bexpression *> workList;
+  workList.push_back(root);
+
+  while (! workList.empty()) {
+    Bexpression *e = workList.back();
+    workList.pop_back();
+    if (!repairableNode(e))
+      return false;
+    for (auto &c : e->children()) {
+      Bexpression *ce = c->castToBexpression();
+      assert(ce);
+      if (visited.find(ce) == visited.end()) {
+        visited.insert(ce);
+        workList.push_back(ce);
+      }
+    }
+  }
+  return true;
 }
 
 void IntegrityVisitor::dumpTag(const char *tag, void *ptr) {
@@ -204,35 +253,8 @@ void IntegrityVisitor::setParent(llvm::Instruction *inst,
 
 bool IntegrityVisitor::repairableSubTree(Bexpression *root)
 {
-  std::set<Bexpression *> visited;
-  visited.insert(root);
-  std::vector<Bexpression *> workList;
-  workList.push_back(root);
-
-  while (! workList.empty()) {
-    Bexpression *e = workList.back();
-    workList.pop_back();
-    if (acceptableNodes_.find(e->flavor()) == acceptableNodes_.end())
-      return false;
-    if (e->flavor() == N_Call) {
-      // ok to duplicate runtime error calls, but not other calls
-      Bfunction *target = e->getCallTarget();
-      if (!target || target->name() != "__go_runtime_error")
-        return false;
-    }
-    if (e->flavor() == N_BinaryOp &&
-        acceptableOpcodes_.find(e->op()) == acceptableOpcodes_.end())
-      return false;
-    for (auto &c : e->children()) {
-      Bexpression *ce = c->castToBexpression();
-      assert(ce);
-      if (visited.find(ce) == visited.end()) {
-        visited.insert(ce);
-        workList.push_back(ce);
-      }
-    }
-  }
-  return true;
+  return (be_->nodeBuilder().constantValueReusable(root) ||
+          repairableSubTreeAt(root));
 }
 
 class ScopedIntegrityCheckDisabler {
@@ -256,7 +278,7 @@ bool IntegrityVisitor::repair(Bnode *node)
   for (auto &ps : sharing_) {
     Bnode *parent = ps.first;
     unsigned slot = ps.second;
-    const std::vector<Bnode *> &pkids = parent->children();
+    llvm::ArrayRef<Bnode *> pkids = parent->children();
     Bexpression *child = pkids[slot]->castToBexpression();
     assert(child);
 
@@ -278,7 +300,11 @@ void IntegrityVisitor::visit(Bnode *node)
 {
   unsigned idx = 0;
   for (auto &child : node->children()) {
-    if (visitMode() == BatchMode)
+    // In batch mode walk the child's subtree, unless we've already
+    // been there via some other parent (no need to revisit shared
+    // subtrees, which can be costly if sharing is nested).
+    if (visitMode() == BatchMode &&
+        (!shouldBeTracked(child) || nparent_.find(child) == nparent_.end()))
       visit(child);
     setParent(child, node, idx++);
   }
@@ -320,3 +346,100 @@ bool IntegrityVisitor::examine(Bnode *node)
   // Repair failed -- return failure
   return false;
 }
+
+//......................................................................
+
+SharingRepairer::SharingRepairer(Llvm_backend *be)
+    : be_(be), epoch_(0)
+{
+}
+
+// Error nodes and module-scope expressions (see
+// Bexpression::moduleScope) are shared by design and never tracked.
+// The tag is set by makeGlobalExpression on the expressions it caches,
+// so checking it avoids a module-scope value table lookup per node.
+
+bool SharingRepairer::shouldBeTracked(Bnode *node)
+{
+  if (node->flavor() == N_Error)
+    return false;
+  Bexpression *expr = node->castToBexpression();
+  if (expr && expr->moduleScope())
+    return false;
+  return true;
+}
+
+// Record a visit to the specified node, returning FALSE if it has
+// already been visited during the current walk.
+
+bool SharingRepairer::markVisited(Bnode *node)
+{
+  std::vector<unsigned> &tab = (node->isStmt() ? stmtVisited_ : exprVisited_);
+  unsigned id = node->id();
+  if (id >= tab.size())
+    tab.resize(std::max<size_t>(id + 1, tab.size() * 2), 0);
+  if (tab[id] == epoch_)
+    return false;
+  tab[id] = epoch_;
+  return true;
+}
+
+bool SharingRepairer::repair(Bnode *root)
+{
+  // Start a new walk; on the (unlikely) wraparound of the epoch
+  // counter, reset the tables so that stale stamps can't match.
+  if (++epoch_ == 0) {
+    std::fill(exprVisited_.begin(), exprVisited_.end(), 0);
+    std::fill(stmtVisited_.begin(), stmtVisited_.end(), 0);
+    epoch_ = 1;
+  }
+
+  // Error nodes and module-scope expressions are never tracked (nor
+  // given proper ids), so there is nothing to do for them.
+  if (!shouldBeTracked(root))
+    return true;
+
+  std::vector<Bnode *> workList;
+  llvm::SmallPtrSet<Bexpression *, 8> repairable;
+  instVisited_.clear();
+  markVisited(root);
+  workList.push_back(root);
+  while (! workList.empty()) {
+    Bnode *node = workList.back();
+    workList.pop_back();
+
+    // Instruction sharing can't be repaired by cloning; leave it for
+    // the full checker to diagnose.
+    if (Bexpression *expr = node->castToBexpression())
+      for (auto inst : expr->instructions())
+        if (!instVisited_.insert(inst).second)
+          return false;
+
+    llvm::ArrayRef<Bnode *> kids = node->children();
+    for (unsigned idx = 0; idx < kids.size(); ++idx) {
+      Bnode *child = kids[idx];
+      if (!shouldBeTracked(child))
+        continue;
+      if (markVisited(child)) {
+        workList.push_back(child);
+        continue;
+      }
+
+      // Shared. Only expression subtrees of certain kinds can be
+      // replicated; leave anything else for the full checker.
+      Bexpression *expr = child->castToBexpression();
+      if (!expr)
+        return false;
+      if (!repairable.count(expr)) {
+        if (!be_->nodeBuilder().constantValueReusable(expr) &&
+            !repairableSubTreeAt(expr))
+          return false;
+        repairable.insert(expr);
+      }
+      ScopedIntegrityCheckDisabler disabler(be_);
+      Bexpression *clone = be_->nodeBuilder().cloneSubtree(expr);
+      node->replaceChild(idx, clone);
+    }
+  }
+  return true;
+}
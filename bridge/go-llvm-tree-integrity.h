@@ -13,10 +13,13 @@
 #ifndef LLVMGOFRONTEND_GO_LLVM_TREE_INTEGRITY_H
 #define LLVMGOFRONTEND_GO_LLVM_TREE_INTEGRITY_H
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "go-llvm-containertypes.h"
 
+#include <vector>
+
 namespace llvm {
 class Instruction;
 }
@@ -30,6 +33,20 @@ enum CkTreePtrDisp { DumpPointers, NoDumpPointers };
 enum CkTreeRepairDisp { DontReportRepairableSharing, ReportRepairableSharing };
 enum CkTreeVisitDisp { BatchMode, IncrementalMode };
 
+// How much checking/repair to apply when a function body (or an
+// expression about to be materialized) is handed to the bridge. The
+// full mode runs IntegrityVisitor over the tree, looking for all kinds
+// of sharing; repair-only mode just repairs the expression sharing
+// the front end is known to create (see SharingRepairer below),
+// falling back on the full checker if it encounters anything else;
+// off mode does neither.
+
+enum TreeIntegrityMode {
+  TreeIntegrityOff,
+  TreeIntegrityRepairOnly,
+  TreeIntegrityFull
+};
+
 // Options/controls for the tree integrity checker.
 
 struct TreeIntegCtl {
@@ -108,8 +125,6 @@ class IntegrityVisitor {
   std::unordered_map<llvm::Instruction *, parslot> iparent_;
   std::unordered_map<Bnode *, parslot> nparent_;
   pairhashset<Bnode *, unsigned> sharing_;
-  std::set<NodeFlavor> acceptableNodes_;
-  std::set<Operator> acceptableOpcodes_;
   std::string str_;
   llvm::raw_string_ostream ss_;
   TreeIntegCtl control_;
@@ -133,4 +148,36 @@ class IntegrityVisitor {
   friend BnodeBuilder;
 };
 
+// Lightweight sharing repair, used in place of IntegrityVisitor in
+// repair-only mode. Nodes visited during a walk are recorded in flat
+// tables indexed by Bnode id (one for expressions, one for statements)
+// that are stamped with a per-walk epoch, so no per-walk setup or
+// hashing is needed. When an expression is reached a second time and
+// the shared subtree is of a kind we know how to replicate, the
+// second reference is replaced with a clone. Instructions are tracked
+// as well (in a hash set, since they have no ids); an instruction
+// owned by more than one expression is never repaired here.
+
+class SharingRepairer {
+ public:
+  explicit SharingRepairer(Llvm_backend *be);
+
+  // Walk the tree rooted at "root", repairing any repairable
+  // expression sharing. Returns FALSE if some other form of sharing
+  // was encountered, in which case the caller should run the full
+  // checker to diagnose it.
+  bool repair(Bnode *root);
+
+ private:
+  bool shouldBeTracked(Bnode *node);
+  bool markVisited(Bnode *node);
+
+ private:
+  Llvm_backend *be_;
+  std::vector<unsigned> exprVisited_;
+  std::vector<unsigned> stmtVisited_;
+  llvm::DenseSet<llvm::Instruction *> instVisited_;
+  unsigned epoch_;
+};
+
 #endif // LLVMGOFRONTEND_GO_LLVM_TREE_INTEGRITY_H
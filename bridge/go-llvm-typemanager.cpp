@@ -20,6 +20,9 @@
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
 
 TypeManager::TypeManager(llvm::LLVMContext &context, llvm::CallingConv::ID conv)
@@ -28,6 +31,9 @@ TypeManager::TypeManager(llvm::LLVMContext &context, llvm::CallingConv::ID conv)
     , cconv_(conv)
     , addressSpace_(0)
     , traceLevel_(0)
+    , strictAliasing_(false)
+    , tbaaRoot_(nullptr)
+    , tbaaChar_(nullptr)
     , nametags_(nullptr)
     , errorExpression_(nullptr)
     , errorType_(nullptr)
@@ -84,6 +90,10 @@ TypeManager::~TypeManager()
     delete kv.second;
   for (auto &t : namedTypes_)
     delete t;
+  for (auto &kv : abiOracles_)
+    delete kv.second;
+  for (auto &o : retiredAbiOracles_)
+    delete o;
 }
 
 void TypeManager::initializeTypeManager(Bexpression *errorExpression,
@@ -734,6 +744,16 @@ Btype *TypeManager::placeholderArrayType(const std::string &name,
   return pat;
 }
 
+const CABIOracle *TypeManager::abiOracle(BFunctionType *ft)
+{
+  auto it = abiOracles_.find(ft);
+  if (it != abiOracles_.end())
+    return it->second;
+  CABIOracle *oracle = new CABIOracle(ft, this);
+  abiOracles_[ft] = oracle;
+  return oracle;
+}
+
 // Here "typ" is assumed to be the Btype of the "function" expression
 // feeding into a call, which can either be raw pointer-to-function or
 // pointer-to-function-descriptor. This helper picks out and returns
@@ -887,9 +907,15 @@ void TypeManager::postProcessResolvedFunctionPlaceholder(BFunctionType *bft,
   assert(bft);
   assert(bft->isPlaceholder());
 
+  // Any oracle computed for the unresolved form is now stale.
+  auto oit = abiOracles_.find(bft);
+  if (oit != abiOracles_.end()) {
+    retiredAbiOracles_.push_back(oit->second);
+    abiOracles_.erase(oit);
+  }
+
   // Create a new resolved LLVM function type.
-  CABIOracle abiOracle(bft, this);
-  llvm::FunctionType *newllft = abiOracle.getFunctionTypeForABI();
+  llvm::FunctionType *newllft = abiOracle(bft)->getFunctionTypeForABI();
 
   // pluck out of anonTypes if stored there
   bool wasHashed = removeAnonType(bft);
@@ -1964,3 +1990,151 @@ llvm::DIType *TypeManager::buildDIType(Btype *typ, DIBuildHelper &helper)
   typeCache[typ] = rval;
   return rval;
 }
+
+llvm::MDNode *TypeManager::tbaaTypeNode(llvm::Type *t)
+{
+  auto it = tbaaNodes_.find(t);
+  if (it != tbaaNodes_.end())
+    return it->second;
+
+  llvm::MDBuilder mdb(context_);
+  if (tbaaRoot_ == nullptr) {
+    tbaaRoot_ = mdb.createTBAARoot("Go TBAA");
+    tbaaChar_ = mdb.createTBAAScalarTypeNode("omnipotent char", tbaaRoot_);
+  }
+
+  llvm::MDNode *node = nullptr;
+  if (t->isPointerTy()) {
+    // All pointers share a node, since the bridge (and unsafe.Pointer
+    // conversions) freely convert between pointer types.
+    node = mdb.createTBAAScalarTypeNode("any pointer", tbaaChar_);
+  } else if (t->isIntegerTy()) {
+    std::string name("int" + std::to_string(t->getIntegerBitWidth()));
+    node = mdb.createTBAAScalarTypeNode(name, tbaaChar_);
+  } else if (t->isFloatTy()) {
+    node = mdb.createTBAAScalarTypeNode("float32", tbaaChar_);
+  } else if (t->isDoubleTy()) {
+    node = mdb.createTBAAScalarTypeNode("float64", tbaaChar_);
+  } else if (t->isStructTy() && !llvm::cast<llvm::StructType>(t)->isOpaque()) {
+    // Struct nodes list their (non-empty) fields; arrays can't be
+    // described in a struct-path type node, so a struct that contains
+    // one (at any depth) gets no node. Nodes are uniqued by content,
+    // so structs with identical layouts share a node.
+    llvm::StructType *st = llvm::cast<llvm::StructType>(t);
+    const llvm::StructLayout *sl = datalayout_->getStructLayout(st);
+    llvm::SmallVector<std::pair<llvm::MDNode *, uint64_t>, 8> fields;
+    bool ok = true;
+    for (unsigned idx = 0; idx < st->getNumElements(); ++idx) {
+      llvm::Type *et = st->getElementType(idx);
+      if (llvmTypeSize(et) == 0)
+        continue;
+      llvm::MDNode *fnode = tbaaTypeNode(et);
+      if (fnode == nullptr) {
+        ok = false;
+        break;
+      }
+      fields.push_back(std::make_pair(fnode, sl->getElementOffset(idx)));
+    }
+    if (ok && !fields.empty())
+      node = mdb.createTBAAStructTypeNode("struct", fields);
+  }
+
+  tbaaNodes_[t] = node;
+  return node;
+}
+
+// Returns true if all indices of 'gep' (other than the leading zero
+// pointer index) are constant struct field indices.
+
+static bool isStructFieldGEP(llvm::GEPOperator *gep)
+{
+  if (gep->getNumIndices() < 2)
+    return false;
+  auto it = gep->idx_begin();
+  llvm::ConstantInt *ci = llvm::dyn_cast<llvm::ConstantInt>(*it);
+  if (ci == nullptr || !ci->isZero())
+    return false;
+  llvm::Type *cur = gep->getSourceElementType();
+  for (++it; it != gep->idx_end(); ++it) {
+    llvm::StructType *st = llvm::dyn_cast<llvm::StructType>(cur);
+    ci = llvm::dyn_cast<llvm::ConstantInt>(*it);
+    if (st == nullptr || ci == nullptr)
+      return false;
+    cur = st->getElementType(ci->getZExtValue());
+  }
+  return true;
+}
+
+llvm::MDNode *TypeManager::tbaaAccessTag(llvm::Value *ptr)
+{
+  if (!strictAliasing_)
+    return nullptr;
+  llvm::Type *at = ptr->getType()->getPointerElementType();
+  if (at->isAggregateType() || at->isVectorTy())
+    return nullptr;
+  llvm::MDNode *accessNode = tbaaTypeNode(at);
+  if (accessNode == nullptr)
+    return nullptr;
+
+  // For field references, walk back through the chain of field
+  // address computations to find the outermost struct, so as to
+  // create a struct-path tag.
+  llvm::MDNode *baseNode = accessNode;
+  uint64_t offset = 0;
+  llvm::Value *base = ptr;
+  while (llvm::GEPOperator *gep = llvm::dyn_cast<llvm::GEPOperator>(base)) {
+    if (!isStructFieldGEP(gep))
+      break;
+    llvm::MDNode *snode = tbaaTypeNode(gep->getSourceElementType());
+    if (snode == nullptr)
+      break;
+    llvm::APInt off(datalayout_->getPointerSizeInBits(addressSpace_), 0);
+    if (!gep->accumulateConstantOffset(*datalayout_, off))
+      break;
+    offset += off.getZExtValue();
+    baseNode = snode;
+    base = gep->getPointerOperand();
+  }
+
+  llvm::MDBuilder mdb(context_);
+  return mdb.createTBAAStructTagNode(baseNode, accessNode, offset);
+}
+
+void TypeManager::annotateValidPointerLoad(llvm::LoadInst *ld, Btype *pointee)
+{
+  llvm::MDNode *empty = llvm::MDNode::get(context_, llvm::None);
+  ld->setMetadata(llvm::LLVMContext::MD_nonnull, empty);
+  if (pointee == nullptr || pointee == errorType_)
+    return;
+
+  // Zero-sized objects may share an address with some other object
+  // (or sit one past the end of one), so say nothing about them.
+  int64_t size = typeSize(pointee);
+  if (size <= 0)
+    return;
+  llvm::Type *i64t = llvm::Type::getInt64Ty(context_);
+  auto i64md = [&](uint64_t v) {
+    llvm::Metadata *c =
+        llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(i64t, v));
+    return llvm::MDNode::get(context_, c);
+  };
+  ld->setMetadata(llvm::LLVMContext::MD_dereferenceable, i64md(size));
+
+  // A pointer to T may point to a struct field of type T, so use the
+  // field alignment (smaller than the ABI alignment in some cases,
+  // ex: float64 on 386).
+  int64_t align = typeFieldAlignment(pointee);
+  if (align > 1)
+    ld->setMetadata(llvm::LLVMContext::MD_align, i64md(align));
+}
+
+llvm::AttrBuilder TypeManager::validPointerAttributes(llvm::Type *t)
+{
+  llvm::AttrBuilder ab;
+  ab.addAttribute(llvm::Attribute::NonNull);
+  uint64_t size = llvmTypeAllocSize(t);
+  if (size != 0)
+    ab.addDereferenceableAttr(size);
+  ab.addAlignmentAttr(datalayout_->getABITypeAlignment(t));
+  return ab;
+}
@@ -20,6 +20,7 @@
 #include "namegen.h"
 #include "backend.h"
 
+#include "llvm/IR/Attributes.h"
 #include "llvm/IR/CallingConv.h"
 
 namespace llvm {
@@ -27,6 +28,8 @@ class DataLayout;
 class DIType;
 class Instruction;
 class LLVMContext;
+class LoadInst;
+class MDNode;
 class Module;
 class Value;
 class raw_ostream;
@@ -34,6 +37,7 @@ class FunctionType;
 class StructType;
 }
 
+class CABIOracle;
 class DIBuildHelper;
 
 using Btyped_identifier = Backend::Btyped_identifier;
@@ -162,6 +166,11 @@ class TypeManager {
   llvm::Type *makeLLVMFunctionType(const std::vector<Btype *> &paramTypes,
                                    Btype *rbtype, bool followsCabi);
 
+  // Return the C ABI oracle for the specified function type. Oracles
+  // are computed once per function type and then shared by every
+  // function and call site with that type.
+  const CABIOracle *abiOracle(BFunctionType *ft);
+
   // Returns field type from composite (struct/array) type and index.
   Btype *elementTypeByIndex(Btype *type, unsigned element_index);
 
@@ -245,6 +254,26 @@ class TypeManager {
   // Debug meta-data generation
   llvm::DIType *buildDIType(Btype *typ, DIBuildHelper &helper);
 
+  // Type-based alias analysis. Returns the TBAA access tag for a scalar
+  // load or store through 'ptr' (a struct-path tag if 'ptr' is the
+  // address of a struct field), or nullptr if the access should not
+  // be tagged (strict aliasing disabled, aggregate access, etc).
+  llvm::MDNode *tbaaAccessTag(llvm::Value *ptr);
+
+  // Enable/disable TBAA meta-data generation (off by default).
+  void setStrictAliasing(bool b) { strictAliasing_ = b; }
+  bool strictAliasing() const { return strictAliasing_; }
+
+  // Attach !nonnull meta-data to 'ld', a load producing a pointer
+  // known to be valid. If 'pointee' is non-null, also attach
+  // !dereferenceable and !align for an object of that type.
+  void annotateValidPointerLoad(llvm::LoadInst *ld, Btype *pointee);
+
+  // Parameter attributes (nonnull, dereferenceable, align) for a
+  // pointer that always refers to a live object of LLVM type 't',
+  // such as the hidden struct return parameter.
+  llvm::AttrBuilder validPointerAttributes(llvm::Type *t);
+
   // For debugging
   unsigned traceLevel() const { return traceLevel_; }
   void setTypeManagerTraceLevel(unsigned level) { traceLevel_ = level; }
@@ -253,7 +282,13 @@ class TypeManager {
   std::string tnamegen(const std::string &tag,
                        unsigned expl = NameGen::ChooseVer) {
     assert(nametags_);
-    return nametags_->namegen(tag, expl);
+    return nametags_->uniqueName(tag, expl);
+  }
+
+  // for value name generation (empty if value names are discarded)
+  std::string vnamegen(const std::string &tag) {
+    assert(nametags_);
+    return nametags_->namegen(tag);
   }
 
  private:
@@ -273,6 +308,10 @@ class TypeManager {
   // otherwise returns the LLVM type for the specified Btype.
   llvm::Type *getPlaceholderProxyIfNeeded(Btype *btype);
 
+  // Returns the TBAA type node for a scalar or struct type, or nullptr
+  // if the type can't be described.
+  llvm::MDNode *tbaaTypeNode(llvm::Type *t);
+
   // Context information needed for the LLVM backend.
   llvm::LLVMContext &context_;
   const llvm::DataLayout *datalayout_;
@@ -280,6 +319,14 @@ class TypeManager {
   unsigned addressSpace_;
   unsigned traceLevel_;
 
+  // TBAA type nodes are keyed by LLVM type, not Btype: Go permits
+  // conversions between pointers to types with identical underlying
+  // types, so those types have to share a node.
+  bool strictAliasing_;
+  llvm::MDNode *tbaaRoot_;
+  llvm::MDNode *tbaaChar_;
+  std::unordered_map<llvm::Type *, llvm::MDNode *> tbaaNodes_;
+
   class btype_hash {
   public:
     unsigned int operator()(const Btype *t) const {
@@ -344,6 +391,13 @@ class TypeManager {
   // function types created from placeholders.
   std::unordered_set<llvm::Type *> circularFunctionTypes_;
 
+  // Memoized C ABI oracles, keyed by function type. Oracles computed
+  // for a placeholder function type are moved to the retired list
+  // when the placeholder is resolved, since functions created earlier
+  // may still refer to them.
+  std::unordered_map<BFunctionType *, CABIOracle *> abiOracles_;
+  std::vector<CABIOracle *> retiredAbiOracles_;
+
   // Name generation helper
   NameGen *nametags_;
 
@@ -21,6 +21,7 @@
 #include "go-llvm-dibuildhelper.h"
 #include "go-llvm-cabi-oracle.h"
 #include "go-llvm-irbuilders.h"
+#include "go-llvm-runtime-attrs.h"
 #include "gogo.h"
 
 #include "llvm/Analysis/TargetLibraryInfo.h"
@@ -39,6 +40,8 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 Llvm_backend::Llvm_backend(llvm::LLVMContext &context,
                            llvm::Module *module,
@@ -54,8 +57,16 @@ Llvm_backend::Llvm_backend(llvm::LLVMContext &context,
     , noInline_(false)
     , noFpElim_(false)
     , checkIntegrity_(true)
+#ifdef NDEBUG
+    , treeIntegrityMode_(TreeIntegrityRepairOnly)
+#else
+    , treeIntegrityMode_(TreeIntegrityFull)
+#endif
+    , sharingRepairer_(this)
+    , integrityCheckFallbacks_(0)
     , createDebugMetaData_(true)
-    , exportDataStarted_(false)
+    , pointerConversions_(0)
+    , pointerConversionsAtLastBody_(0)
     , exportDataFinalized_(false)
     , errorCount_(0u)
     , compositeSizeThreshold_(8u) // TODO: adjust later to larger value
@@ -64,6 +75,9 @@ Llvm_backend::Llvm_backend(llvm::LLVMContext &context,
     , errorFunction_(nullptr)
     , personalityFunction_(nullptr)
 {
+  // Don't bother generating names that the context will discard.
+  setDiscardValueNames(context_.shouldDiscardValueNames());
+
   // If nobody passed in a linemap, create one for internal use (unit testing)
   if (!linemap_) {
     ownLinemap_.reset(new Llvm_linemap());
@@ -140,6 +154,12 @@ void Llvm_backend::addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef> pr
   dibuildhelper_->addDebugPrefix(prefix);
 }
 
+void Llvm_backend::setDebugInfoForProfiling(bool b)
+{
+  if (dibuildhelper_)
+    dibuildhelper_->setDebugInfoForProfiling(b);
+}
+
 void Llvm_backend::setTargetCpuAttr(const std::string &cpu)
 {
   targetCpuAttr_ = cpu;
@@ -212,6 +232,18 @@ void Llvm_backend::disableIntegrityChecks()
 
 void Llvm_backend::enforceTreeIntegrity(Bnode *n)
 {
+  if (treeIntegrityMode_ == TreeIntegrityOff)
+    return;
+
+  // In repair-only mode, fix up the sharing that the front end is
+  // known to introduce; anything else gets handed to the full checker
+  // below so that it can be diagnosed.
+  if (treeIntegrityMode_ == TreeIntegrityRepairOnly) {
+    if (sharingRepairer_.repair(n))
+      return;
+    integrityCheckFallbacks_++;
+  }
+
   Llvm_backend *be = const_cast<Llvm_backend *>(this);
   TreeIntegCtl control(DumpPointers, DontReportRepairableSharing, BatchMode);
   IntegrityVisitor iv(be, control);
@@ -495,6 +527,7 @@ Bexpression *Llvm_backend::makeGlobalExpression(Bexpression *expr,
     nbuilder_.freeNode(expr);
     return it->second;
   }
+  expr->setModuleScope();
   valueExprmap_[vbt] = expr;
   return expr;
 }
@@ -543,6 +576,24 @@ Bexpression *Llvm_backend::genCircularConversion(Btype *toType,
   return nbuilder_.mkConversion(toType, bitcast, expr, loc);
 }
 
+void Llvm_backend::notePointerCast(llvm::Value *val, llvm::Type *toType)
+{
+  // Converting to unsafe.Pointer is harmless by itself, since an
+  // unsafe.Pointer can't be dereferenced; what matters is converting
+  // back to a pointer to some other type. Nil, and the result of an
+  // allocator call (ex: runtime.newobject, whose return is marked
+  // noalias), can't refer to memory of any other type either.
+  if (toType == llvmPtrType() || val->getType() == toType)
+    return;
+  if (llvm::isa<llvm::ConstantPointerNull>(val) ||
+      llvm::isa<llvm::UndefValue>(val))
+    return;
+  if (llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(val))
+    if (call->returnDoesNotAlias())
+      return;
+  pointerConversions_++;
+}
+
 Bexpression *Llvm_backend::genLoad(Bexpression *expr,
                                    Btype *btype,
                                    Location loc,
@@ -574,6 +625,7 @@ Bexpression *Llvm_backend::genLoad(Bexpression *expr,
     llvm::Function *dummyFcn = errorFunction_->function();
     BlockLIRBuilder builder(dummyFcn, this);
     llvm::Type *spaceTyp = llvm::PointerType::get(loadResultType->type(), addressSpace_);
+    notePointerCast(spaceVal, spaceTyp);
     std::string tag(namegen("cast"));
     spaceVal = builder.CreateBitCast(spaceVal, spaceTyp, tag);
     space->appendInstructions(builder.instructions());
@@ -594,6 +646,8 @@ Bexpression *Llvm_backend::genLoad(Bexpression *expr,
     ldname += ".ld";
     ldname = namegen(ldname);
     llvm::Instruction *loadInst = new llvm::LoadInst(spaceVal, ldname);
+    if (llvm::MDNode *tag = tbaaAccessTag(spaceVal))
+      loadInst->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
     rval = nbuilder_.mkDeref(loadResultType, loadInst, space, loc);
     rval->appendInstruction(loadInst);
   } else {
@@ -608,6 +662,29 @@ Bexpression *Llvm_backend::genLoad(Bexpression *expr,
   return rval;
 }
 
+void Llvm_backend::annotateKnownValidPointer(llvm::Value *ptr, Btype *btype)
+{
+  // Look through offset/field/index GEPs: if the front end vouches
+  // for the derived address (ex: a slice element after a bounds
+  // check), the base pointer is non-nil as well, but nothing can be
+  // said about its extent.
+  bool direct = true;
+  while (llvm::GetElementPtrInst *gep =
+         llvm::dyn_cast<llvm::GetElementPtrInst>(ptr)) {
+    if (gep->getNumUses() > 1)
+      return;
+    ptr = gep->getPointerOperand();
+    direct = false;
+  }
+
+  // Only annotate a load whose sole user is this indirection; a
+  // load that also feeds a nil check must not be marked non-null.
+  llvm::LoadInst *ld = llvm::dyn_cast<llvm::LoadInst>(ptr);
+  if (!ld || ld->getNumUses() > 1)
+    return;
+  annotateValidPointerLoad(ld, direct ? btype : nullptr);
+}
+
 // An expression that indirectly references an expression.
 
 Bexpression *Llvm_backend::indirect_expression(Btype *btype,
@@ -621,7 +698,8 @@ Bexpression *Llvm_backend::indirect_expression(Btype *btype,
 
   assert(expr->btype()->type()->isPointerTy());
 
-  Bexpression *rval = nbuilder_.mkDeref(btype, nullptr, expr, location);
+  Bexpression *rval = nbuilder_.mkDeref(btype, nullptr, expr, location,
+                                        known_valid);
   return rval;
 }
 
@@ -689,7 +767,7 @@ Bvariable *Llvm_backend::genVarForConstant(llvm::Constant *conval,
   if (it != genVarConstMap_.end())
     return it->second;
 
-  std::string ctag(namegen("const"));
+  std::string ctag(uniqueName("const"));
   Bvariable *rv = makeModuleVar(type, ctag, "", Location(),
                                 MV_Constant, MV_DefaultSection,
                                 MV_NotInComdat,
@@ -730,7 +808,10 @@ llvm::Value *Llvm_backend::genStore(BlockLIRBuilder *builder,
     assert(srcVal->getType() == dpt->getElementType());
 
     // Create and return store
-    return builder->CreateStore(srcVal, dstLoc);
+    llvm::StoreInst *store = builder->CreateStore(srcVal, dstLoc);
+    if (llvm::MDNode *tag = tbaaAccessTag(dstLoc))
+      store->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    return store;
   }
 
   // destination should be pointer
@@ -1137,7 +1218,7 @@ Bexpression *Llvm_backend::string_constant_expression(const std::string &val)
 
   // New string. Manufacture a module-scope var to hold the constant,
   // then install various maps.
-  std::string ctag(namegen("const"));
+  std::string ctag(uniqueName("const"));
   Bvariable *svar =
       makeModuleVar(makeAuxType(scon->getType()),
                     ctag, "", Location(), MV_Constant, MV_DefaultSection,
@@ -2155,6 +2236,8 @@ Bvariable *Llvm_backend::temporary_variable(Bfunction *function,
     return tvar;
   }
   tvar->markAsTemporary();
+  if (bblock)
+    bblock->addTemporaryVariable(tvar);
   Bstatement *is = init_statement(function, tvar, binit);
   *pstatement = is;
   return tvar;
@@ -2461,6 +2544,9 @@ Bfunction *Llvm_backend::function(Btype *fntype, const std::string &name,
     fcn->addFnAttr("target-cpu", targetCpuAttr_);
     fcn->addFnAttr("target-features", targetFeaturesAttr_);
 
+    // attributes for known runtime entry points
+    addRuntimeFunctionAttributes(fcn, fns, ft, *abiOracle(ft));
+
     fcnValue = fcn;
 
     // Fix up references to declaration of old type.
@@ -2611,6 +2697,8 @@ class GenBlocks {
                                      llvm::Instruction *insertBefore,
                                      llvm::BasicBlock *llbb,
                                      bool isStart);
+  void startCallTemporary(llvm::AllocaInst *ai, llvm::BasicBlock *curblock);
+  void endCallTemporaries(llvm::BasicBlock *curblock);
   DIBuildHelper *dibuildhelper() const { return dibuildhelper_; }
   Llvm_linemap *linemap() { return be_->linemap(); }
 
@@ -2624,6 +2712,12 @@ class GenBlocks {
   std::vector<llvm::BasicBlock*> padBlockStack_;
   std::set<llvm::AllocaInst *> temporariesDiscovered_;
   std::vector<llvm::AllocaInst *> newTemporaries_;
+  // Call temporaries started within the current outermost expression
+  // statement, and all call temporaries encountered so far; see
+  // startCallTemporary.
+  std::vector<llvm::AllocaInst *> liveCallTemps_;
+  std::set<llvm::AllocaInst *> callTempsSeen_;
+  unsigned exprStmtDepth_;
   llvm::BasicBlock *finallyBlock_;
   Bstatement *cachedReturn_;
 };
@@ -2635,8 +2729,8 @@ GenBlocks::GenBlocks(llvm::LLVMContext &context,
                      DIBuildHelper *dibuildhelper,
                      llvm::BasicBlock *entryBlock)
     : context_(context), be_(be), function_(function),
-      dibuildhelper_(dibuildhelper), finallyBlock_(nullptr),
-      cachedReturn_(nullptr)
+      dibuildhelper_(dibuildhelper), exprStmtDepth_(0),
+      finallyBlock_(nullptr), cachedReturn_(nullptr)
 {
   if (dibuildhelper_)
     dibuildhelper_->beginFunction(function, topNode, entryBlock);
@@ -2724,9 +2818,13 @@ void GenBlocks::appendLifetimeIntrinsic(llvm::Value *alloca,
 //
 // A couple of items to note:
 //
-// - the front end also manufactures compiler temporaries, however at the
-//   moment it doesn't try to associate temps with a given block (the code
-//   below doesn't address these sorts of variables)
+// - the front end also manufactures compiler temporaries; these are
+//   tacked onto the block passed to temporary_variable(), so they
+//   are handled along with the block's other vars. Temporaries created
+//   by the bridge to hold call results are scoped to the expression
+//   statement containing the call instead; see startCallTemporary below.
+//   Other bridge temporaries (composite initializers, complex
+//   arithmetic) don't yet get markers.
 //
 // - if there are no lifetime intrinsics for a given stack-allocated
 //   variable, the back end will assume that it is live throughout the
@@ -2764,6 +2862,33 @@ void GenBlocks::insertLifetimeMarkersForBlock(Bblock *block,
   }
 }
 
+// A call temporary (storage for a call result returned in memory) is
+// only referenced by the call and by the expression consuming its
+// result, so if a temp is first used within an expression statement,
+// start its lifetime just before that use and end it when the
+// outermost expression statement completes. Temps that first appear
+// elsewhere (ex: in an 'if' condition) get no markers, meaning they
+// are treated as live throughout the function.
+
+void GenBlocks::startCallTemporary(llvm::AllocaInst *ai,
+                                   llvm::BasicBlock *curblock)
+{
+  if (!callTempsSeen_.insert(ai).second)
+    return;
+  if (!exprStmtDepth_ || !curblock)
+    return;
+  appendLifetimeIntrinsic(ai, nullptr, curblock, true);
+  liveCallTemps_.push_back(ai);
+}
+
+void GenBlocks::endCallTemporaries(llvm::BasicBlock *curblock)
+{
+  if (curblock)
+    for (auto ai : liveCallTemps_)
+      appendLifetimeIntrinsic(ai, nullptr, curblock, false);
+  liveCallTemps_.clear();
+}
+
 // This helper routine takes a garden variety call instruction and
 // rewrites it to an equivalent llvm::InvokeInst that may throw an
 // exception (with associated explicit EH control flow). The helper is
@@ -2830,6 +2955,8 @@ GenBlocks::postProcessInst(llvm::Instruction *inst,
         temporariesDiscovered_.insert(ai);
         newTemporaries_.push_back(ai);
         delete tvar;
+      } else if (function_->isTemporary(ai)) {
+        startCallTemporary(ai, curblock);
       }
     }
   }
@@ -2854,7 +2981,7 @@ llvm::BasicBlock *GenBlocks::walkExpr(llvm::BasicBlock *curblock,
     be_->nodeBuilder().destroy(expr, DelInstructions, false);
 
   // Visit children first
-  const std::vector<Bnode *> &kids = expr->children();
+  llvm::ArrayRef<Bnode *> kids = expr->children();
   for (auto &child : kids)
     curblock = walk(child, containingStmt, curblock);
 
@@ -3405,7 +3532,10 @@ llvm::BasicBlock *GenBlocks::walk(Bnode *node,
   assert(stmt);
   switch (stmt->flavor()) {
     case N_ExprStmt: {
+      exprStmtDepth_ += 1;
       curblock = walkExpr(curblock, stmt, stmt->getExprStmtExpr());
+      if (--exprStmtDepth_ == 0)
+        endCallTemporaries(curblock);
       break;
     }
     case N_BlockStmt: {
@@ -3513,7 +3643,8 @@ bool Llvm_backend::function_set_body(Bfunction *function,
 
   // Invoke the tree integrity checker. We do this even if
   // checkIntegrity_ is false so to deal with any repairable
-  // sharing that the front end may have introduced.
+  // sharing that the front end may have introduced (how thorough
+  // a job is done depends on treeIntegrityMode_).
   enforceTreeIntegrity(code_stmt);
 
   // Create and populate entry block
@@ -3534,6 +3665,17 @@ bool Llvm_backend::function_set_body(Bfunction *function,
   if (block)
     fixupEpilogBlock(function, block);
 
+  // If any type-punning pointer casts were made while this function
+  // was being built, memory may be accessed as more than one type, so
+  // drop the TBAA tags on its loads and stores.
+  if (pointerConversions_ != pointerConversionsAtLastBody_) {
+    if (strictAliasing())
+      for (llvm::BasicBlock &bb : *function->function())
+        for (llvm::Instruction &inst : bb)
+          inst.setMetadata(llvm::LLVMContext::MD_tbaa, nullptr);
+    pointerConversionsAtLastBody_ = pointerConversions_;
+  }
+
   // debugging
   if (traceLevel() > 0) {
     std::cerr << "LLVM function dump:\n";
@@ -3543,6 +3685,9 @@ bool Llvm_backend::function_set_body(Bfunction *function,
     std::cerr << os.str();
   }
 
+  // The statement tree for the function is no longer needed.
+  nbuilder_.releaseLoweredTree(code_stmt);
+
   return true;
 }
 
@@ -3563,28 +3708,60 @@ void Llvm_backend::write_global_definitions(
 
 }
 
-// Post-process export data to escape quotes, etc, writing bytes
-// to the specified stringstream.
-static void postProcessExportDataChunk(const char *bytes,
-                                       unsigned int size,
-                                       std::stringstream &ss)
+// Directive that starts the export data section.
+
+static const char *exportSectionDirective =
+    "\t.section \".go_export\",\"e\",@progbits\n";
+
+// Escape export data bytes for use within an assembler ".ascii"
+// string, appending the result to 'out'. Runs of bytes that need no
+// escaping are copied over in one piece.
+
+static void escapeExportDataChunk(const char *bytes,
+                                  unsigned int size,
+                                  std::string &out)
 {
-  std::map<char, std::string> rewrites = { { '\\', "\\\\" },
-                                           { '\0', "\\000" },
-                                           { '\n', "\\n" },
-                                           { '"', "\\\"" } };
+  const char *end = bytes + size;
+  const char *run = bytes;
+  for (const char *p = bytes; p != end; ++p) {
+    const char *rewrite;
+    switch (*p) {
+      case '\\': rewrite = "\\\\"; break;
+      case '\0': rewrite = "\\000"; break;
+      case '\n': rewrite = "\\n"; break;
+      case '"': rewrite = "\\\""; break;
+      default: continue;
+    }
+    out.append(run, p - run);
+    out.append(rewrite);
+    run = p + 1;
+  }
+  out.append(run, end - run);
+}
 
-  for (unsigned idx = 0; idx < size; ++idx) {
-    const char byte = bytes[idx];
-    auto it = rewrites.find(byte);
-    if (it != rewrites.end())
-      ss << it->second;
-    else
-      ss << byte;
+// Write raw export data to 'path', returning false on failure.
+
+static bool writeExportDataFile(const std::string &path,
+                                const std::string &bytes)
+{
+  std::error_code EC;
+  llvm::raw_fd_ostream os(path, EC, llvm::sys::fs::F_None);
+  if (EC)
+    return false;
+  os << bytes;
+  os.close();
+  if (os.has_error()) {
+    os.clear_error();
+    return false;
   }
+  return true;
 }
 
-// Finalize export data.
+// Finalize export data. The directives accumulated by
+// write_export_data are added to the module inline asm in one go.
+// If an export data file was requested, the raw bytes collected so far
+// are written out to it and included with ".incbin"; should the file
+// not be writable, they are escaped as usual instead.
 
 void Llvm_backend::finalizeExportData()
 {
@@ -3594,7 +3771,26 @@ void Llvm_backend::finalizeExportData()
 
   assert(! exportDataFinalized_);
   exportDataFinalized_ = true;
-  module().appendModuleInlineAsm("\t.text\n");
+
+  if (!exportDataFile_.empty() && !exportData_.empty()) {
+    std::string bytes;
+    bytes.swap(exportData_);
+    exportData_.append(exportSectionDirective);
+    if (writeExportDataFile(exportDataFile_, bytes)) {
+      exportData_.append("\t.incbin \"");
+      escapeExportDataChunk(exportDataFile_.data(), exportDataFile_.size(),
+                            exportData_);
+      exportData_.append("\"\n");
+    } else {
+      exportData_.append("\t.ascii \"");
+      escapeExportDataChunk(bytes.data(), bytes.size(), exportData_);
+      exportData_.append("\"\n");
+    }
+  }
+
+  exportData_.append("\t.text\n");
+  module().appendModuleInlineAsm(exportData_);
+  std::string().swap(exportData_);
 
   if (traceLevel() > 1) {
     std::cerr << "Export data emitted:\n";
@@ -3608,21 +3804,26 @@ void Llvm_backend::finalizeExportData()
 void Llvm_backend::write_export_data(const char *bytes, unsigned int size)
 {
   // FIXME: this is hacky and currently very ELF-specific. Better to
-  // add real support in MC object file layer.
+  // add real support in MC object file layer. Note that the section
+  // has to be created via an assembler directive (as opposed to
+  // placing a global in it), since that is the only way to get the
+  // "e" (SHF_EXCLUDE) flag, which keeps export data out of linked
+  // executables.
 
   assert(! exportDataFinalized_);
 
-  if (! exportDataStarted_) {
-    exportDataStarted_ = true;
-    const char *preamble = "\t.section \".go_export\",\"e\",@progbits";
-    module().appendModuleInlineAsm(preamble);
+  // Raw bytes, for an ".incbin" (see finalizeExportData).
+  if (!exportDataFile_.empty()) {
+    exportData_.append(bytes, size);
+    return;
   }
 
-  std::stringstream ss;
-  ss << "\t.ascii \"";
-  postProcessExportDataChunk(bytes, size, ss);
-  ss << "\"\n";
-  module().appendModuleInlineAsm(ss.str());
+  if (exportData_.empty())
+    exportData_.append(exportSectionDirective);
+
+  exportData_.append("\t.ascii \"");
+  escapeExportDataChunk(bytes, size, exportData_);
+  exportData_.append("\"\n");
 }
 
 
@@ -341,6 +341,15 @@ public:
   // Support for -fdebug-prefix=
   void addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef> prefix);
 
+  // Support for -fdebug-info-for-profiling / -fprofile-sample-use=
+  void setDebugInfoForProfiling(bool b);
+
+  // Hand export data to the assembler as raw bytes, by writing it to
+  // the specified file and emitting an ".incbin" of that file, rather
+  // than as escaped ".ascii" directives. Only usable if the module is
+  // assembled while the file still exists (integrated assembler).
+  void setExportDataFile(const std::string &path) { exportDataFile_ = path; }
+
   // Bnode builder
   BnodeBuilder &nodeBuilder() { return nbuilder_; }
 
@@ -375,6 +384,18 @@ public:
   // so that we can unit test the integrity checker.
   void disableIntegrityChecks();
 
+  // Select how much tree integrity checking/repair to perform
+  // prior to lowering (see TreeIntegrityMode).
+  void setTreeIntegrityMode(TreeIntegrityMode mode) {
+    treeIntegrityMode_ = mode;
+  }
+
+  // Number of times repair-only mode had to fall back on the full
+  // integrity checker (for unit testing).
+  unsigned long integrityCheckFallbacks() const {
+    return integrityCheckFallbacks_;
+  }
+
   // Disable debug meta-data generation. Should be used only during
   // unit testing, where we're manufacturing IR that might not verify
   // if meta-data is created.
@@ -511,6 +532,13 @@ public:
                        Location loc,
                        const std::string &tag);
 
+  // Called for an indirection of type 'btype' through 'ptr' that the
+  // front end has flagged as known-valid (already nil-checked or
+  // bounds-checked). If 'ptr' was loaded from memory and has no other
+  // uses, attach !nonnull (plus !dereferenceable and !align when the
+  // pointer is used directly) to that load.
+  void annotateKnownValidPointer(llvm::Value *ptr, Btype *btype);
+
   // Store generation helper. Creates store or memcpy call.
   Bexpression *genStore(Bfunction *func,
                         Bexpression *srcExpr,
@@ -647,6 +675,12 @@ public:
   Bexpression *genCircularConversion(Btype *toType, Bexpression *expr,
                                      Location loc);
 
+  // Called for each pointer-to-pointer cast of 'val' to 'toType' made
+  // while lowering a function. Casts that can let memory be reached
+  // through a differently typed pointer (unsafe.Pointer round trips)
+  // are counted in pointerConversions_.
+  void notePointerCast(llvm::Value *val, llvm::Type *toType);
+
   // Helpers for call sequence generation.
   void genCallProlog(GenCallState &state);
   void genCallAttributes(GenCallState &state, llvm::CallInst *call);
@@ -737,12 +771,31 @@ public:
   // or statement pointed to by multiple parents).
   bool checkIntegrity_;
 
+  // How much tree integrity checking/repair to do on function bodies
+  // and expressions prior to lowering. Full checking by default in
+  // assert-enabled builds, repair-only otherwise.
+  TreeIntegrityMode treeIntegrityMode_;
+
+  // Helper for repair-only integrity mode; keeps its visited tables
+  // around between walks.
+  SharingRepairer sharingRepairer_;
+  unsigned long integrityCheckFallbacks_;
+
   // Whether to create debug meta data. On by default, can be
   // disabled for unit testing.
   bool createDebugMetaData_;
 
-  // Whether we've started / finalized export data for the module.
-  bool exportDataStarted_;
+  // Number of type-punning pointer casts created so far (see
+  // notePointerCast), and the count as of the end of the last
+  // function_set_body call. If the two differ once a function is
+  // lowered, TBAA tags are dropped from the function.
+  unsigned pointerConversions_;
+  unsigned pointerConversionsAtLastBody_;
+
+  // Export data accumulated so far (as assembler directives, or raw
+  // bytes if exportDataFile_ is set), and whether we've finalized it.
+  std::string exportData_;
+  std::string exportDataFile_;
   bool exportDataFinalized_;
 
   // This counter gets incremented when the FE requests an error
@@ -15,13 +15,23 @@
 
 class NameGen {
  public:
-  NameGen() { }
+  NameGen() : discardValueNames_(false) { }
 
   // Tells namegen to choose its own version number for the created name
   static constexpr unsigned ChooseVer = 0xffffffff;
 
-  // For creating useful type, inst and block names.
+  // For creating useful inst and block names. If value names are
+  // being discarded (they will be thrown away by the LLVMContext in
+  // any case) this skips the work and returns an empty string.
   std::string namegen(const std::string &tag, unsigned expl = ChooseVer) {
+    if (discardValueNames_)
+      return std::string();
+    return uniqueName(tag, expl);
+  }
+
+  // Same as above, but always creates a name. For use with types and
+  // global values, whose names are kept regardless.
+  std::string uniqueName(const std::string &tag, unsigned expl = ChooseVer) {
     auto it = nametags_.find(tag);
     unsigned count = 0;
     if (it != nametags_.end())
@@ -39,11 +49,15 @@ class NameGen {
     return const_cast<NameGen*>(this);
   }
 
+  // Get/set whether names for non-global values are being discarded.
+  bool discardValueNames() const { return discardValueNames_; }
+  void setDiscardValueNames(bool b) { discardValueNames_ = b; }
+
  private:
   // Key is tag (ex: "add") and val is counter to uniquify.
   std::unordered_map<std::string, unsigned> nametags_;
+  bool discardValueNames_;
 };
 
 
-
 #endif // LLVMGOFRONTEND_TYPEMANAGER_H
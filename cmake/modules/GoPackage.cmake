@@ -55,27 +55,30 @@ function(add_go_package pkgpath dest)
   # Mangle packagepath (convert golang_org => vendor/golang_org).
   string(REPLACE "golang_org" "vendor/golang_org" pkgpath "${pkgpath}")
 
-  # Command to build non-PIC object file
-  add_custom_command(
-    OUTPUT ${package_ofile}
-    COMMAND ${CMAKE_COMMAND} -E make_directory "./${pdir}"
-    COMMAND "${gocompiler}" "-c" "-o" ${package_ofile} "-fgo-pkgpath=${pkgpath}" ${ARG_GOCFLAGS} -I . ${ARG_GOSRC}
-    DEPENDS ${ARG_GOSRC} ${godeps} ${gocdep}
-    COMMENT "Building Go package '${pkgpath}' (non-PIC)"
-    VERBATIM)
-  list(APPEND pkg_outputs "${package_ofile}")
-
-  # Command to build PIC object file
+  # Command to build the object files. When both PIC and non-PIC
+  # objects are needed, a single compiler invocation produces both
+  # (via -fgo-dual-pic-output), so that parsing, type checking and
+  # lowering of the package is only done once.
   if(NOT ARG_NOPIC)
     add_custom_command(
-      OUTPUT "${package_picofile}"
+      OUTPUT ${package_ofile} "${package_picofile}"
+      COMMAND ${CMAKE_COMMAND} -E make_directory "./${pdir}"
       COMMAND ${CMAKE_COMMAND} -E make_directory "./${pdir}/.pic"
-      COMMAND "${gocompiler}" "-c" "-o" ${package_picofile} -fPIC "-fgo-pkgpath=${pkgpath}" ${ARG_GOCFLAGS} -I . ${ARG_GOSRC}
+      COMMAND "${gocompiler}" "-c" "-o" ${package_ofile} "-fgo-dual-pic-output=${package_picofile}" "-fgo-pkgpath=${pkgpath}" ${ARG_GOCFLAGS} -I . ${ARG_GOSRC}
       DEPENDS ${ARG_GOSRC} ${godeps} ${gocdep}
-      COMMENT "Building Go package '${pkgpath}' (PIC)"
+      COMMENT "Building Go package '${pkgpath}' (non-PIC and PIC)"
       VERBATIM)
+    list(APPEND pkg_outputs "${package_ofile}")
     list(APPEND pkg_outputs "${package_picofile}")
   else()
+    add_custom_command(
+      OUTPUT ${package_ofile}
+      COMMAND ${CMAKE_COMMAND} -E make_directory "./${pdir}"
+      COMMAND "${gocompiler}" "-c" "-o" ${package_ofile} "-fgo-pkgpath=${pkgpath}" ${ARG_GOCFLAGS} -I . ${ARG_GOSRC}
+      DEPENDS ${ARG_GOSRC} ${godeps} ${gocdep}
+      COMMENT "Building Go package '${pkgpath}' (non-PIC)"
+      VERBATIM)
+    list(APPEND pkg_outputs "${package_ofile}")
     set(package_picofile)
   endif()
 
@@ -21,6 +21,7 @@
 #include "GollvmConfig.h"
 
 #include "Compilation.h"
+#include "CompileServer.h"
 #include "Driver.h"
 #include "ToolChain.h"
 #include "Tool.h"
@@ -173,22 +174,34 @@ bool CommandLineParser::parseCommandLine(int argc, char **argv)
   return true;
 }
 
-int main(int argc, char **argv)
+// The option table is created once per process. Compiles carried out
+// by a compile server (each in a process forked from the server) share
+// the one created by the server.
+static opt::OptTable *driverOptTable()
 {
-  // Print a stack trace if we signal out.
-  sys::PrintStackTraceOnErrorSignal(argv[0]);
-  PrettyStackTraceProgram X(argc, argv);
-  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+  static std::unique_ptr<opt::OptTable> opts =
+      gollvm::options::createGollvmDriverOptTable();
+  return opts.get();
+}
 
+// Carry out a single driver invocation.
+static int runDriver(int argc, char **argv)
+{
   // Parse command line.
-  std::unique_ptr<opt::OptTable> opts =
-      gollvm::options::createGollvmDriverOptTable();
-  CommandLineParser clp(opts.get());
+  opt::OptTable *opts = driverOptTable();
+  CommandLineParser clp(opts);
   if (!clp.parseCommandLine(argc, argv))
     return 1;
 
+  // Honor --compile-server: from here on we serve compile requests
+  // forwarded by other invocations of this driver.
+  opt::Arg *serverArg =
+      clp.args().getLastArg(gollvm::options::OPT_compile_server_EQ);
+  if (serverArg != nullptr)
+    return runCompileServer(argv[0], serverArg->getValue(), runDriver);
+
   // Create driver.
-  Driver driver(clp.args(), opts.get(), argv[0]);
+  Driver driver(clp.args(), opts, argv[0]);
 
   // Set up driver, select target and toolchain.
   ToolChain *toolchain = driver.setup();
@@ -214,3 +227,38 @@ int main(int argc, char **argv)
   // We're done.
   return 0;
 }
+
+// Returns true if the command line asks to start a compile server.
+// The command line is parsed with the driver's option table, so only
+// the --compile-server= option itself counts (not an option or input
+// that merely starts with the same characters).
+static bool startingCompileServer(int argc, char **argv)
+{
+  unsigned missingArgIndex, missingArgCount;
+  ArrayRef<const char *> argvv = makeArrayRef(argv, argc);
+  opt::InputArgList args =
+      driverOptTable()->ParseArgs(argvv.slice(1), missingArgIndex,
+                                  missingArgCount);
+  return args.hasArg(gollvm::options::OPT_compile_server_EQ);
+}
+
+int main(int argc, char **argv)
+{
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  // If a compile server is available, hand this invocation off to it;
+  // fall back on compiling locally if the server can't take it.
+  const char *serverSocket = ::getenv(GOLLVM_COMPILE_SERVER_ENV);
+  if (serverSocket != nullptr && *serverSocket != '\0' &&
+      !startingCompileServer(argc, argv)) {
+    llvm::Optional<int> status =
+        forwardToCompileServer(serverSocket, argc, argv);
+    if (status)
+      return *status;
+  }
+
+  return runDriver(argc, argv);
+}
@@ -29,17 +29,20 @@ Command::Command(const Action &srcAction,
 {
 }
 
-int Command::execute(std::string *errMsg)
+int Command::execute(std::string *errMsg, llvm::StringRef stderrPath)
 {
   std::vector<llvm::StringRef> argv;
   size_t n = arguments_.size() - 1;
   argv.reserve(n);
   for (size_t i = 0; i < n; ++i)
     argv.push_back(arguments_[i]);
+  llvm::SmallVector<llvm::Optional<llvm::StringRef>, 3> redirects;
+  if (!stderrPath.empty())
+    redirects = { llvm::None, llvm::None, stderrPath };
   return llvm::sys::ExecuteAndWait(executable_,
                                    argv,
                                    /*env=*/llvm::None,
-                                   /*Redirects*/{},
+                                   redirects,
                                    /*secondsToWait=*/0,
                                    /*memoryLimit=*/0,
                                    errMsg);
@@ -45,7 +45,12 @@ class Command {
           llvm::opt::ArgStringList &args);
 
   // Execute the command. Returns 0 on success, non-zero on error.
-  int execute(std::string *errMsg);
+  // If 'stderrPath' is non-empty, the standard error of the command
+  // is redirected to that file.
+  int execute(std::string *errMsg, llvm::StringRef stderrPath = "");
+
+  // Action that this command carries out.
+  const Action &action() const { return action_; }
 
   // Print to string
   void print(llvm::raw_ostream &OS, bool quoteArgs);
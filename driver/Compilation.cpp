@@ -10,10 +10,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "Compilation.h"
 
 #include "Artifact.h"
@@ -114,12 +122,15 @@ Artifact *Compilation::createOutputFileArtifact(Action *act)
   return newFileArtifact(ofn.c_str(), false);
 }
 
-llvm::Optional<Artifact*> Compilation::createTemporaryFileArtifact(Action *act)
+llvm::Optional<Artifact*>
+Compilation::createTemporaryFileArtifact(const Action *act,
+                                         const char *suffix)
 {
   llvm::SmallString<128> tempFileName;
   std::error_code tfcEC =
       llvm::sys::fs::createTemporaryFile(act->getName(),
-                                         act->resultFileSuffix(),
+                                         (suffix ? suffix :
+                                          act->resultFileSuffix()),
                                          tempFileName);
   if (tfcEC) {
     llvm::errs() << driver_.progname() << ": error: "
@@ -129,6 +140,14 @@ llvm::Optional<Artifact*> Compilation::createTemporaryFileArtifact(Action *act)
   return newFileArtifact(tempFileName.c_str(), true);
 }
 
+ArtifactList Compilation::supplementalOutputs(const Action *act) const
+{
+  auto it = supplementalOutputs_.find(act);
+  if (it == supplementalOutputs_.end())
+    return ArtifactList();
+  return it->second;
+}
+
 void Compilation::addCommand(const Action &srcAction,
                              const Tool &creatingTool,
                              const char *executable,
@@ -141,11 +160,44 @@ void Compilation::addCommand(const Action &srcAction,
   commands_.push_back(ownedCommands_.back().get());
 }
 
+// Returns the maximum number of commands to run concurrently: the
+// value of -j if present, otherwise that of the GOLLVM_DRIVER_JOBS
+// environment variable, otherwise 1. Zero means one job per core.
+
+llvm::Optional<unsigned> Compilation::maxParallelJobs()
+{
+  llvm::Optional<unsigned> jobs =
+      driver_.getLastArgAsInteger(gollvm::options::OPT_j, 1u);
+  if (!jobs)
+    return llvm::None;
+  if (!driver_.args().hasArg(gollvm::options::OPT_j)) {
+    llvm::Optional<std::string> env =
+        llvm::sys::Process::GetEnv("GOLLVM_DRIVER_JOBS");
+    if (env && llvm::StringRef(*env).getAsInteger(10, *jobs)) {
+      llvm::errs() << driver_.progname() << ": invalid value '" << *env
+                   << "' for GOLLVM_DRIVER_JOBS\n";
+      return llvm::None;
+    }
+  }
+  if (*jobs == 0)
+    jobs = llvm::heavyweight_hardware_concurrency();
+  return jobs;
+}
+
 bool Compilation::executeCommands()
 {
   llvm::opt::ArgList &args = driver().args();
 
   bool hashHashHash = args.hasArg(gollvm::options::OPT__HASH_HASH_HASH);
+  if (!hashHashHash && commands_.size() > 1) {
+    llvm::Optional<unsigned> jobs = maxParallelJobs();
+    if (!jobs)
+      return false;
+    if (*jobs > 1)
+      return executeCommandsInParallel(*jobs,
+                                       args.hasArg(gollvm::options::OPT_v));
+  }
+
   for (auto cmd : commands_) {
 
     // Support -v and/or -###
@@ -169,5 +221,127 @@ bool Compilation::executeCommands()
   return true;
 }
 
+// Run commands concurrently, up to 'jobs' at a time. A command may
+// start once all earlier commands it depends on have completed
+// successfully, where a command depends on the commands carrying out
+// the actions that feed into its own action (directly or indirectly),
+// and on earlier commands for the same action (a tool may emit more
+// than one command per action). Standard error of each command is
+// captured in a temp file and replayed (along with the -v echo of the
+// command line) in command order, so output doesn't interleave. Once
+// a command fails no new commands are started; the ones already
+// running are allowed to finish.
+
+bool Compilation::executeCommandsInParallel(unsigned jobs, bool verbose)
+{
+  enum State { Pending, Running, Done };
+  struct CommandState {
+    CommandState() : state(Pending), rc(0) { }
+    State state;
+    int rc;
+    std::string errMsg;
+    llvm::SmallString<128> stderrPath;
+    std::vector<unsigned> deps;
+  };
+  size_t ncmds = commands_.size();
+  std::vector<CommandState> cstate(ncmds);
+
+  // Compute dependencies.
+  for (unsigned idx = 0; idx < ncmds; ++idx) {
+    const Action *act = &commands_[idx]->action();
+    llvm::SmallPtrSet<const Action *, 8> feeders;
+    llvm::SmallVector<const Action *, 8> worklist(act->inputs().begin(),
+                                                  act->inputs().end());
+    while (!worklist.empty()) {
+      const Action *in = worklist.pop_back_val();
+      if (feeders.insert(in).second)
+        worklist.append(in->inputs().begin(), in->inputs().end());
+    }
+    for (unsigned pidx = 0; pidx < idx; ++pidx) {
+      const Action *pact = &commands_[pidx]->action();
+      if (pact == act || feeders.count(pact))
+        cstate[idx].deps.push_back(pidx);
+    }
+  }
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<std::thread> threads;
+  unsigned running = 0;
+  bool failed = false;
+  size_t nextToReport = 0;
+
+  // Echo the command (for -v), its captured stderr and any error
+  // message from the launch itself.
+  auto report = [&](unsigned idx) {
+    CommandState &cs = cstate[idx];
+    if (verbose)
+      commands_[idx]->print(llvm::errs(), false);
+    auto bufOrErr = llvm::MemoryBuffer::getFile(cs.stderrPath);
+    if (bufOrErr)
+      llvm::errs() << (*bufOrErr)->getBuffer();
+    llvm::sys::fs::remove(cs.stderrPath);
+    if (cs.rc != 0 && !cs.errMsg.empty())
+      llvm::errs() << cs.errMsg << "\n";
+  };
+
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true) {
+    while (nextToReport < ncmds && cstate[nextToReport].state == Done)
+      report(nextToReport++);
+    if (nextToReport == ncmds)
+      break;
+
+    // Launch whatever is ready.
+    for (unsigned idx = 0; idx < ncmds && !failed && running < jobs; ++idx) {
+      CommandState &cs = cstate[idx];
+      if (cs.state != Pending)
+        continue;
+      bool ready = true;
+      for (unsigned dep : cs.deps)
+        if (cstate[dep].state != Done)
+          ready = false;
+      if (!ready)
+        continue;
+      if (llvm::sys::fs::createTemporaryFile("gollvm-cmd", "err",
+                                             cs.stderrPath)) {
+        llvm::errs() << driver_.progname()
+                     << ": error: unable to create temp file\n";
+        failed = true;
+        break;
+      }
+      cs.state = Running;
+      running += 1;
+      Command *cmd = commands_[idx];
+      threads.emplace_back([&, cmd, idx]() {
+        std::string errMsg;
+        int rc = cmd->execute(&errMsg, cstate[idx].stderrPath);
+        std::lock_guard<std::mutex> guard(mtx);
+        cstate[idx].rc = rc;
+        cstate[idx].errMsg = errMsg;
+        cstate[idx].state = Done;
+        if (rc != 0)
+          failed = true;
+        running -= 1;
+        cv.notify_all();
+      });
+    }
+
+    if (running == 0)
+      break;
+    cv.wait(lock);
+  }
+  lock.unlock();
+  for (auto &t : threads)
+    t.join();
+
+  // Flush output from any commands that completed after the failure.
+  for (unsigned idx = nextToReport; idx < ncmds; ++idx)
+    if (cstate[idx].state == Done)
+      report(idx);
+
+  return !failed;
+}
+
 } // end namespace driver
 } // end namespace gollvm
@@ -14,7 +14,9 @@
 #define GOLLVM_DRIVER_COMPILATION_H
 
 #include <string>
+#include <unordered_map>
 #include "Action.h"
+#include "Artifact.h"
 #include "Command.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Option/OptTable.h"
@@ -38,14 +40,18 @@ class Compilation {
               ToolChain &toolChain);
   ~Compilation();
 
-  // Execute queued commands to invoke external tools.
+  // Execute queued commands to invoke external tools. Independent
+  // commands may be run concurrently (see maxParallelJobs below).
   // Return is true for success, false for error;
   bool executeCommands();
 
   // Generate a new temp file and return an artifact for it. Here
   // llvm::Optional is used in case the temp file creation fails for
-  // some reason.
-  llvm::Optional<Artifact*> createTemporaryFileArtifact(Action *act);
+  // some reason. If 'suffix' is null, the result file suffix for the
+  // action is used.
+  llvm::Optional<Artifact*>
+  createTemporaryFileArtifact(const Action *act,
+                              const char *suffix = nullptr);
 
     // Create new artifact based on file name. If 'isTempfile' is set,
   // the file should be scheduled for deletion after compilation finishes.
@@ -92,6 +98,19 @@ class Compilation {
     actions_.push_back(act);
   }
 
+  // Record an additional object file produced as a side effect of
+  // carrying out an internal-tool action (for example, extra code
+  // generation partitions written by a parallel compile). Tools
+  // consuming the output of the action are expected to fold these
+  // objects into their own result.
+  void addSupplementalOutput(const Action *act, Artifact *art) {
+    supplementalOutputs_[act].push_back(art);
+  }
+
+  // Return supplemental outputs recorded for the specified action
+  // (empty list if none).
+  ArtifactList supplementalOutputs(const Action *act) const;
+
   // Create a new command and add to the commands list.
   void addCommand(const Action &srcAction,
                   const Tool &creatingTool,
@@ -109,6 +128,10 @@ class Compilation {
   llvm::SmallVector<std::unique_ptr<Command>, 8> ownedCommands_;
   llvm::SmallVector<const char *, 8> tempFileNames_;
   llvm::SmallVector<std::string, 8> paths_;
+  std::unordered_map<const Action *, ArtifactList> supplementalOutputs_;
+
+  llvm::Optional<unsigned> maxParallelJobs();
+  bool executeCommandsInParallel(unsigned jobs, bool verbose);
 };
 
 } // end namespace driver
@@ -16,22 +16,33 @@
 #include "go-llvm-diagnostics.h"
 #include "go-llvm.h"
 #include "go-c.h"
+#include "go-export-data.h"
 #include "mpfr.h"
 #include "GollvmOptions.h"
 #include "GollvmConfig.h"
 
 #include "Action.h"
 #include "Artifact.h"
+#include "Compilation.h"
 #include "Driver.h"
+#include "GnuTools.h"
+#include "SplitStackLeaf.h"
+#include "Tool.h"
 #include "ToolChain.h"
 
 namespace gollvm { namespace arch {
 #include "ArchCpusAttrs.h"
 } }
 
+#include "llvm/ADT/Any.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/IR/DiagnosticInfo.h"
@@ -39,6 +50,8 @@ namespace gollvm { namespace arch {
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Option/Arg.h"
@@ -60,12 +73,16 @@ namespace gollvm { namespace arch {
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
-#include "llvm/Transforms/IPO.h"
-#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 
+#include <chrono>
+#include <map>
 #include <sstream>
 
 using namespace llvm;
@@ -73,6 +90,191 @@ using namespace llvm;
 namespace gollvm {
 namespace driver {
 
+// Settings used to create the target machine for a compile. Target
+// options are derived from these (rather than set piecemeal), so that
+// a configuration written out with str() and read back with parse()
+// gives the same target machine; the compile server relies on this
+// to create target machines ahead of time (see warmTargetMachine).
+
+struct TargetMachineConfig {
+  std::string triple;
+  std::string cpu;
+  std::string features;
+  Optional<Reloc::Model> relocModel;
+  CodeGenOpt::Level optLevel;
+  bool disableIntegratedAS;
+  DebugCompressionType compressDebugSections;
+  bool useInitArray;
+  bool noTrappingFPMath;
+  FPOpFusion::FPOpFusionMode fpOpFusion;
+
+  TargetMachineConfig()
+      : optLevel(CodeGenOpt::Default),
+        disableIntegratedAS(true),
+        compressDebugSections(DebugCompressionType::None),
+        useInitArray(true),
+        noTrappingFPMath(false),
+        fpOpFusion(FPOpFusion::Standard) { }
+
+  TargetOptions targetOptions() const;
+  std::unique_ptr<TargetMachine> create(const Target *target) const;
+  std::string str() const;
+  bool parse(StringRef str);
+};
+
+TargetOptions TargetMachineConfig::targetOptions() const
+{
+  TargetOptions options;
+  options.DisableIntegratedAS = disableIntegratedAS;
+  options.CompressDebugSections = compressDebugSections;
+
+  // FIXME: this hard-wires on the equivalent of -ffunction-sections
+  // and -fdata-sections, since there doesn't seem to be a high-level
+  // hook for selecting a separate section for a specific variable or
+  // function (other than forcing it into a comdat, which is not
+  // always what we want).
+  options.FunctionSections = true;
+  options.DataSections = true;
+  options.UniqueSectionNames = true;
+
+  // FIXME: this needs to be dependent on target triple
+  options.EABIVersion = llvm::EABI::Default;
+
+  options.UseInitArray = useInitArray;
+  options.NoTrappingFPMath = noTrappingFPMath;
+  options.AllowFPOpFusion = fpOpFusion;
+  return options;
+}
+
+std::unique_ptr<TargetMachine>
+TargetMachineConfig::create(const Target *target) const
+{
+  Optional<llvm::CodeModel::Model> CM = None;
+  return std::unique_ptr<TargetMachine>(
+      target->createTargetMachine(triple, cpu, features, targetOptions(),
+                                  relocModel, CM, optLevel));
+}
+
+std::string TargetMachineConfig::str() const
+{
+  std::string result;
+  raw_string_ostream os(result);
+  const char sep = '\x1f';
+  os << triple << sep << cpu << sep << features << sep
+     << (relocModel ? int(*relocModel) : -1) << sep
+     << int(optLevel) << sep
+     << disableIntegratedAS << sep
+     << int(compressDebugSections) << sep
+     << useInitArray << sep
+     << noTrappingFPMath << sep
+     << int(fpOpFusion);
+  return os.str();
+}
+
+bool TargetMachineConfig::parse(StringRef str)
+{
+  SmallVector<StringRef, 10> fields;
+  str.split(fields, '\x1f');
+  int reloc, olvl, dias, cds, uia, ntfp, fpf;
+  if (fields.size() != 10 ||
+      fields[3].getAsInteger(10, reloc) ||
+      fields[4].getAsInteger(10, olvl) ||
+      fields[5].getAsInteger(10, dias) ||
+      fields[6].getAsInteger(10, cds) ||
+      fields[7].getAsInteger(10, uia) ||
+      fields[8].getAsInteger(10, ntfp) ||
+      fields[9].getAsInteger(10, fpf))
+    return false;
+  triple = fields[0];
+  cpu = fields[1];
+  features = fields[2];
+  relocModel = None;
+  if (reloc >= 0)
+    relocModel = static_cast<Reloc::Model>(reloc);
+  optLevel = static_cast<CodeGenOpt::Level>(olvl);
+  disableIntegratedAS = dias;
+  compressDebugSections = static_cast<DebugCompressionType>(cds);
+  useInitArray = uia;
+  noTrappingFPMath = ntfp;
+  fpOpFusion = static_cast<FPOpFusion::FPOpFusionMode>(fpf);
+  return true;
+}
+
+// Target machines created ahead of time by the compile server, keyed
+// by configuration. Each compile runs in a process forked from the
+// server, so a compile takes the matching target machine for itself,
+// leaving the server's copy for the next request.
+#define GOLLVM_MAX_WARM_TARGET_MACHINES 8
+static std::map<std::string, std::unique_ptr<TargetMachine>> warmTargetMachines;
+
+// Configurations of the target machines used by compiles in this
+// process.
+static std::vector<std::string> targetMachineConfigs;
+
+std::vector<std::string> targetMachineConfigsUsed()
+{
+  return targetMachineConfigs;
+}
+
+void warmTargetMachine(const std::string &config)
+{
+  if (warmTargetMachines.count(config) ||
+      warmTargetMachines.size() >= GOLLVM_MAX_WARM_TARGET_MACHINES)
+    return;
+  TargetMachineConfig tmc;
+  if (!tmc.parse(config))
+    return;
+  std::string error;
+  const Target *target = TargetRegistry::lookupTarget(tmc.triple, error);
+  if (!target)
+    return;
+  std::unique_ptr<TargetMachine> tm = tmc.create(target);
+  if (!tm)
+    return;
+
+  // Subtargets are created on demand for the CPU and features of each
+  // function; create the one compiles will ask for.
+  LLVMContext context;
+  Module module("warm", context);
+  Function *fcn =
+      Function::Create(FunctionType::get(Type::getVoidTy(context), false),
+                       GlobalValue::ExternalLinkage, "warm", &module);
+  fcn->addFnAttr("target-cpu", tmc.cpu);
+  fcn->addFnAttr("target-features", tmc.features);
+  tm->getSubtargetImpl(*fcn);
+
+  warmTargetMachines[config] = std::move(tm);
+}
+
+// Returns a target machine for the specified configuration created
+// ahead of time, if there is one.
+static std::unique_ptr<TargetMachine>
+takeWarmTargetMachine(const std::string &config)
+{
+  auto it = warmTargetMachines.find(config);
+  if (it == warmTargetMachines.end())
+    return nullptr;
+  std::unique_ptr<TargetMachine> tm = std::move(it->second);
+  warmTargetMachines.erase(it);
+  return tm;
+}
+
+// Code generation state for one variant of the module (the regular
+// output, or the -fgo-dual-pic-output one) when code generation is
+// split into partitions; see CompileGoImpl::invokeParallelCodeGen.
+struct PartitionedCodeGen {
+  Optional<Reloc::Model> relocModel;
+  // Stream for partition 0 when it is emitted as assembly, else null.
+  raw_pwrite_stream *asmOut;
+  std::vector<SmallString<0>> bitcodes;
+  std::vector<std::unique_ptr<ToolOutputFile>> partOuts;
+  ArtifactList partArtifacts;
+  // Failures in the worker threads are recorded here and reported
+  // once all partitions are done.
+  std::vector<char> partErrors;
+  std::vector<std::string> partMessages;
+};
+
 class CompileGoImpl {
  public:
   CompileGoImpl(ToolChain &tc, const std::string &executablePath);
@@ -93,21 +295,45 @@ class CompileGoImpl {
   opt::InputArgList &args_;
   CodeGenOpt::Level cgolvl_;
   unsigned olvl_;
+  unsigned sizeLevel_;
   bool hasError_;
+  bool thinLTO_;
+  TargetMachine::CodeGenFileType fileType_;
+  unsigned codegenPartitions_;
+  unsigned splitStackLeafBudget_;
+  Compilation *compilation_;
+  const Action *jobAction_;
+  const Artifact *output_;
   std::unique_ptr<Llvm_backend> bridge_;
+  const Target *theTarget_;
+  TargetMachineConfig tmConfig_;
+  Optional<Reloc::Model> relocModel_;
+  Optional<PGOOptions> pgoOptions_;
+  bool debugInfoForProfiling_;
   std::unique_ptr<TargetMachine> target_;
   std::unique_ptr<Llvm_linemap> linemap_;
   std::unique_ptr<Module> module_;
   std::vector<std::string> inputFileNames_;
   std::string asmOutFileName_;
   std::unique_ptr<ToolOutputFile> asmout_;
+  std::unique_ptr<ToolOutputFile> picAsmout_;
+  // For -fgo-dual-pic-output: the PIC object, and the action that
+  // assembles it (null if the PIC output is written directly).
+  Artifact *picObj_;
+  Action *picAsmAction_;
   std::unique_ptr<TargetLibraryInfoImpl> tlii_;
   std::string targetCpuAttr_;
   std::string targetFeaturesAttr_;
 
-  void createPasses(legacy::PassManager &MPM,
-                    legacy::FunctionPassManager &FPM);
+  PassBuilder::OptimizationLevel optimizationLevel();
+  void createPasses(PassBuilder &PB, ModulePassManager &MPM);
   void setupGoSearchPath();
+  std::unique_ptr<TargetMachine>
+  createTargetMachine(Optional<Reloc::Model> relocModel);
+  bool addCodeGenPasses(TargetMachine &tm,
+                        legacy::PassManager &codeGenPasses,
+                        raw_pwrite_stream &os,
+                        TargetMachine::CodeGenFileType ft);
 
   // This routine emits output for -### and/or -v, then returns TRUE
   // of the compilation should be stubbed out (-###) or FALSE otherwise.
@@ -115,10 +341,23 @@ class CompileGoImpl {
 
   // The routines below return TRUE for success, FALSE for failure/error/
   bool setup();
+  bool setupProfileOptions();
   bool initBridge();
   bool invokeFrontEnd();
   bool invokeBridge();
   bool invokeBackEnd();
+  bool invokeParallelCodeGen(std::unique_ptr<Module> picModule);
+  bool splitForCodeGen(std::unique_ptr<Module> module,
+                       Optional<Reloc::Model> relocModel,
+                       raw_pwrite_stream &asmOut,
+                       const Action *asmInput,
+                       PartitionedCodeGen *pcg);
+  void codeGenPartition(PartitionedCodeGen &pcg, unsigned idx);
+  std::unique_ptr<Module> makeDualPicModule(const Module &module);
+  bool invokeDualPicCodeGen(std::unique_ptr<Module> picModule);
+  bool setupDualPicOutput(Compilation &compilation,
+                          const Action &jobAction);
+  bool scheduleDualPicAssembly();
   bool resolveInputOutput(const Action &jobAction,
                           const ArtifactList &inputArtifacts,
                           const Artifact &output);
@@ -137,7 +376,19 @@ CompileGoImpl::CompileGoImpl(ToolChain &tc, const std::string &executablePath)
       args_(tc.driver().args()),
       cgolvl_(CodeGenOpt::Default),
       olvl_(2),
-      hasError_(false)
+      sizeLevel_(0),
+      hasError_(false),
+      thinLTO_(false),
+      fileType_(TargetMachine::CGFT_AssemblyFile),
+      codegenPartitions_(1),
+      splitStackLeafBudget_(0),
+      compilation_(nullptr),
+      jobAction_(nullptr),
+      output_(nullptr),
+      theTarget_(nullptr),
+      debugInfoForProfiling_(false),
+      picObj_(nullptr),
+      picAsmAction_(nullptr)
 {
   InitializeAllTargets();
   InitializeAllTargetMCs();
@@ -153,6 +404,10 @@ bool CompileGoImpl::performAction(Compilation &compilation,
   if (preamble(output))
     return true;
 
+  compilation_ = &compilation;
+  jobAction_ = &jobAction;
+  output_ = &output;
+
   // Resolve input/output files.
   if (!resolveInputOutput(jobAction, inputArtifacts, output))
     return false;
@@ -264,9 +519,15 @@ bool CompileGoImpl::resolveInputOutput(const Action &jobAction,
   assert(! inputFileNames_.empty());
   asmOutFileName_ = output.file();
 
+  // With the integrated assembler, code generation writes the object
+  // file directly.
+  if (driver_.compileEmitsObject())
+    fileType_ = TargetMachine::CGFT_ObjectFile;
+
   // Open output file.
   std::error_code EC;
-  sys::fs::OpenFlags OpenFlags = sys::fs::F_Text;
+  sys::fs::OpenFlags OpenFlags =
+      (driver_.compileEmitsObject() ? sys::fs::F_None : sys::fs::F_Text);
   auto FDOut = llvm::make_unique<ToolOutputFile>(asmOutFileName_, EC,
                                                  OpenFlags);
   if (EC) {
@@ -277,9 +538,165 @@ bool CompileGoImpl::resolveInputOutput(const Action &jobAction,
 
   asmout_.reset(FDOut.release());
   asmout_->keep();
+
+  // Secondary PIC output, if requested.
+  if (args_.hasArg(gollvm::options::OPT_fgo_dual_pic_output_EQ) &&
+      !setupDualPicOutput(*compilation_, jobAction))
+    return false;
+
   return true;
 }
 
+// Process the profile-guided optimization options. Instrumentation
+// (-fprofile-generate), instrumentation-based use (-fprofile-use=) and
+// sample-based use (-fprofile-sample-use=) are mutually exclusive; the
+// result is handed to the pass builder, which schedules the
+// appropriate instrumentation, profile loading and (for sample
+// profiles) discriminator passes.
+
+bool CompileGoImpl::setupProfileOptions()
+{
+  opt::Arg *genarg =
+      args_.getLastArg(gollvm::options::OPT_fprofile_generate,
+                       gollvm::options::OPT_fprofile_generate_EQ);
+  opt::Arg *usearg = args_.getLastArg(gollvm::options::OPT_fprofile_use_EQ);
+  opt::Arg *samplearg =
+      args_.getLastArg(gollvm::options::OPT_fprofile_sample_use_EQ);
+  if ((genarg != nullptr) + (usearg != nullptr) + (samplearg != nullptr) > 1) {
+    errs() << progname_ << ": error: only one of -fprofile-generate, "
+           << "-fprofile-use= and -fprofile-sample-use= may be specified\n";
+    return false;
+  }
+  debugInfoForProfiling_ =
+      (samplearg != nullptr ||
+       args_.hasArg(gollvm::options::OPT_fdebug_info_for_profiling));
+
+  // As with clang, -fprofile-use= accepts a directory, in which case
+  // the profile is expected to be in default.profdata.
+  std::string usePath;
+  if (usearg != nullptr) {
+    SmallString<256> path(usearg->getValue());
+    if (sys::fs::is_directory(path))
+      sys::path::append(path, "default.profdata");
+    usePath = path.str();
+  }
+  for (const std::string &path :
+           { usePath, std::string(samplearg ? samplearg->getValue() : "") }) {
+    if (!path.empty() && !sys::fs::exists(path)) {
+      errs() << progname_ << ": error: profile file '" << path
+             << "' not found\n";
+      return false;
+    }
+  }
+
+  if ((genarg || usearg || samplearg) && olvl_ == 0)
+    errs() << progname_ << ": warning: profile-guided optimization "
+           << "options have no effect at -O0\n";
+
+  if (genarg != nullptr) {
+    SmallString<256> path;
+    if (genarg->getOption().matches(
+            gollvm::options::OPT_fprofile_generate_EQ))
+      path = genarg->getValue();
+    sys::path::append(path, "default_%m.profraw");
+    pgoOptions_ = PGOOptions(path.str(), "", "", "", /*RunProfileGen=*/true,
+                             debugInfoForProfiling_);
+  } else if (usearg != nullptr) {
+    pgoOptions_ = PGOOptions("", usePath, "", "", false,
+                             debugInfoForProfiling_);
+  } else if (samplearg != nullptr) {
+    pgoOptions_ = PGOOptions("", "", samplearg->getValue(), "", false,
+                             /*SamplePGOSupport=*/true);
+  } else if (debugInfoForProfiling_) {
+    pgoOptions_ = PGOOptions("", "", "", "", false, true);
+  }
+  return true;
+}
+
+// Support for -fgo-dual-pic-output=<file>: the primary output is
+// compiled as non-PIC, and a PIC variant is code-generated from a clone
+// of the optimized module, so that both objects needed for libgo can
+// be produced with a single front end run. With -S (or when using the
+// integrated assembler) the PIC output is written directly to <file>;
+// otherwise assembly is written to a temporary and an additional
+// assembler command produces <file>. That command is scheduled after
+// code generation (see scheduleDualPicAssembly), since with parallel
+// code generation it also has to pick up the PIC partitions.
+
+bool CompileGoImpl::setupDualPicOutput(Compilation &compilation,
+                                       const Action &jobAction)
+{
+  opt::Arg *dparg =
+      args_.getLastArg(gollvm::options::OPT_fgo_dual_pic_output_EQ);
+  if (driver_.getPicLevel() != PICLevel::NotPIC) {
+    errs() << progname_ << ": error: " << dparg->getAsString(args_)
+           << " requires a non-PIC primary compilation\n";
+    return false;
+  }
+  if (args_.hasArg(gollvm::options::OPT_emit_llvm)) {
+    errs() << progname_ << ": error: " << dparg->getAsString(args_)
+           << " cannot be combined with -emit-llvm\n";
+    return false;
+  }
+  if (driver_.usingThinLTO() && !args_.hasArg(gollvm::options::OPT_S)) {
+    errs() << progname_ << ": error: " << dparg->getAsString(args_)
+           << " cannot be combined with -flto=thin\n";
+    return false;
+  }
+
+  Artifact *picObj = compilation.newFileArtifact(dparg->getValue(), false);
+  Artifact *picAsm = picObj;
+  if (!args_.hasArg(gollvm::options::OPT_S) &&
+      fileType_ != TargetMachine::CGFT_ObjectFile) {
+    auto tfa = compilation.createTemporaryFileArtifact(&jobAction);
+    if (!tfa)
+      return false;
+    picAsm = *tfa;
+  }
+
+  std::error_code EC;
+  sys::fs::OpenFlags OpenFlags =
+      (fileType_ == TargetMachine::CGFT_ObjectFile ?
+       sys::fs::F_None : sys::fs::F_Text);
+  auto FDOut = llvm::make_unique<ToolOutputFile>(picAsm->file(), EC,
+                                                 OpenFlags);
+  if (EC) {
+    errs() << progname_ << ": error opening " << picAsm->file() << ": "
+           << EC.message() << '\n';
+    return false;
+  }
+  picAsmout_.reset(FDOut.release());
+  picAsmout_->keep();
+
+  picObj_ = picObj;
+  if (picAsm == picObj)
+    return true;
+
+  InputAction *ia = new InputAction(picAsm);
+  compilation.recordAction(ia);
+  picAsmAction_ = new Action(Action::A_Assemble, ia);
+  compilation.recordAction(picAsmAction_);
+  return true;
+}
+
+// Schedule assembly of the -fgo-dual-pic-output variant, if it is
+// written as assembly. This is only done once code generation has
+// succeeded, so the command is never run for a failed compile.
+
+bool CompileGoImpl::scheduleDualPicAssembly()
+{
+  if (!picAsmAction_)
+    return true;
+  InputAction *ia = static_cast<InputAction *>(picAsmAction_->inputs()[0]);
+  Tool *assembler = compilation_->toolchain().getAssembler();
+  ExternalTool *et = assembler->castToExternalTool();
+  assert(et != nullptr);
+  ArtifactList inputs;
+  inputs.push_back(ia->input());
+  return et->constructCommand(*compilation_, *picAsmAction_, inputs,
+                              *picObj_);
+}
+
 bool CompileGoImpl::setup()
 {
   // Set triple.
@@ -287,9 +704,8 @@ bool CompileGoImpl::setup()
 
   // Get the target specific parser.
   std::string Error;
-  const Target *TheTarget =
-      TargetRegistry::lookupTarget("", triple_, Error);
-  if (!TheTarget) {
+  theTarget_ = TargetRegistry::lookupTarget("", triple_, Error);
+  if (!theTarget_) {
     errs() << progname_ << Error;
     return false;
   }
@@ -312,7 +728,16 @@ bool CompileGoImpl::setup()
         olvl_ = 1;
         cgolvl_ = CodeGenOpt::Less;
         break;
-      case 's': // TODO: -Os same as -O for now.
+      case 's':
+        olvl_ = 2;
+        sizeLevel_ = 1;
+        cgolvl_ = CodeGenOpt::Default;
+        break;
+      case 'z':
+        olvl_ = 2;
+        sizeLevel_ = 2;
+        cgolvl_ = CodeGenOpt::Default;
+        break;
       case '2':
         olvl_ = 2;
         cgolvl_ = CodeGenOpt::Default;
@@ -327,37 +752,83 @@ bool CompileGoImpl::setup()
     }
   }
 
+  // ThinLTO: when an object is requested, emit bitcode with a module
+  // summary instead, and leave code generation to the linker. -S
+  // output is unaffected.
+  thinLTO_ = driver_.usingThinLTO() && !args_.hasArg(gollvm::options::OPT_S);
+
+  // Parallel code generation. This is only useful when an object
+  // is being produced: -S output has to remain a single file, and
+  // -emit-llvm (or ThinLTO) output doesn't involve code generation.
+  llvm::Optional<unsigned> pcg =
+      driver_.getLastArgAsInteger(gollvm::options::OPT_fparallel_codegen_EQ,
+                                  1u);
+  if (!pcg)
+    return false;
+  codegenPartitions_ = (*pcg == 0 ? heavyweight_hardware_concurrency() : *pcg);
+  if (args_.hasArg(gollvm::options::OPT_S) ||
+      args_.hasArg(gollvm::options::OPT_emit_llvm) || thinLTO_)
+    codegenPartitions_ = 1;
+
+  // Leaf functions may only skip the split-stack check if their frame
+  // fits in the guard area below the stack limit; budgets beyond what
+  // the target's __morestack provides are capped.
+  llvm::Optional<unsigned> sslb =
+      driver_.getLastArgAsInteger(
+          gollvm::options::OPT_fgo_split_stack_leaf_budget_EQ,
+          (unsigned) GOLLVM_SPLIT_STACK_LEAF_BUDGET_DEFAULT);
+  if (!sslb)
+    return false;
+  splitStackLeafBudget_ = std::min(*sslb, splitStackLeafBudgetLimit(triple_));
+  if (thinLTO_ && splitStackLeafBudget_) {
+    if (args_.hasArg(gollvm::options::OPT_fgo_split_stack_leaf_budget_EQ))
+      errs() << progname_ << ": warning: -fgo-split-stack-leaf-budget "
+             << "has no effect with -flto=thin\n";
+    splitStackLeafBudget_ = 0;
+  }
+
+  if (!setupProfileOptions())
+    return false;
+
   go_no_warn = args_.hasArg(gollvm::options::OPT_w);
   go_loc_show_column =
       driver_.reconcileOptionPair(gollvm::options::OPT_fshow_column,
                                   gollvm::options::OPT_fno_show_column,
                                   true);
 
-  TargetOptions Options;
-
-  // FIXME: turn off integrated assembler for now.
-  Options.DisableIntegratedAS = true;
-
-  // FIXME: this hard-wires on the equivalent of -ffunction-sections
-  // and -fdata-sections, since there doesn't seem to be a high-level
-  // hook for selecting a separate section for a specific variable or
-  // function (other than forcing it into a comdat, which is not
-  // always what we want).
-  Options.FunctionSections = true;
-  Options.DataSections = true;
-  Options.UniqueSectionNames = true;
-
-  // FIXME: this needs to be dependent on target triple
-  Options.EABIVersion = llvm::EABI::Default;
+  TargetMachineConfig &tmc = tmConfig_;
+  tmc.triple = triple_.getTriple();
+  tmc.optLevel = cgolvl_;
+
+  // Assembly output is meant for an external assembler.
+  tmc.disableIntegratedAS = (fileType_ != TargetMachine::CGFT_ObjectFile);
+
+  // Compressed debug sections (-gz). This is normally done by the
+  // assembler; with the integrated assembler we have to do it here.
+  opt::Arg *gzarg = args_.getLastArg(gollvm::options::OPT_gz,
+                                     gollvm::options::OPT_gz_EQ);
+  if (gzarg != nullptr && fileType_ == TargetMachine::CGFT_ObjectFile) {
+    StringRef gz(gzarg->getOption().matches(gollvm::options::OPT_gz) ?
+                 "zlib" : gzarg->getValue());
+    if (gz == "zlib")
+      tmc.compressDebugSections = DebugCompressionType::Z;
+    else if (gz == "zlib-gnu")
+      tmc.compressDebugSections = DebugCompressionType::GNU;
+    else if (gz != "none") {
+      errs() << progname_ << ": error: unsupported argument '" << gz
+             << "' to option '" << gzarg->getSpelling() << "'\n";
+      return false;
+    }
+  }
 
   // init array use
-  Options.UseInitArray =
+  tmc.useInitArray =
       driver_.reconcileOptionPair(gollvm::options::OPT_fuse_init_array,
                                   gollvm::options::OPT_fno_use_init_array,
                                   true);
 
   // FP trapping mode
-  Options.NoTrappingFPMath =
+  tmc.noTrappingFPMath =
       driver_.reconcileOptionPair(gollvm::options::OPT_ftrapping_math,
                                   gollvm::options::OPT_fno_trapping_math,
                                   false);
@@ -381,7 +852,7 @@ bool CompileGoImpl::setup()
   auto dofuse = driver_.getFPOpFusionMode();
   if (!dofuse)
     return false;
-  Options.AllowFPOpFusion = *dofuse;
+  tmc.fpOpFusion = *dofuse;
 
   // Support -march
   std::string cpuStr;
@@ -427,19 +898,38 @@ bool CompileGoImpl::setup()
   }
   targetCpuAttr_ = cpuAttrs->cpu;
   targetFeaturesAttr_ = cpuAttrs->attrs;
-
-  // Create target machine
-  Optional<llvm::CodeModel::Model> CM = None;
-  target_.reset(
-      TheTarget->createTargetMachine(triple_.getTriple(),
-                                     targetCpuAttr_, targetFeaturesAttr_,
-                                     Options, driver_.reconcileRelocModel(),
-                                     CM, cgolvl_));
+  tmc.cpu = targetCpuAttr_;
+  tmc.features = targetFeaturesAttr_;
+
+  // Create target machine, or pick up one created ahead of time by
+  // the compile server. Options given with -mllvm may affect target
+  // machine creation, so don't mix those with pre-created ones.
+  relocModel_ = driver_.reconcileRelocModel();
+  tmc.relocModel = relocModel_;
+  if (!args_.hasArg(gollvm::options::OPT_mllvm)) {
+    std::string config = tmc.str();
+    target_ = takeWarmTargetMachine(config);
+    targetMachineConfigs.push_back(config);
+  }
+  if (!target_)
+    target_ = createTargetMachine(relocModel_);
   assert(target_.get() && "Could not allocate target machine!");
 
   return true;
 }
 
+// Create a new target machine based on the settings established
+// in setup(). Note that this may be invoked from code generation
+// threads, so it should only read state.
+
+std::unique_ptr<TargetMachine>
+CompileGoImpl::createTargetMachine(Optional<Reloc::Model> relocModel)
+{
+  TargetMachineConfig tmc = tmConfig_;
+  tmc.relocModel = relocModel;
+  return tmc.create(theTarget_);
+}
+
 // This helper performs the various initial steps needed to set up the
 // compilation, including prepping the LLVM context, creating an LLVM
 // module, creating the bridge itself (Llvm_backend object) and
@@ -452,6 +942,19 @@ bool CompileGoImpl::initBridge()
   context_.setDiagnosticHandler(
       llvm::make_unique<BEDiagnosticHandler>(&this->hasError_));
 
+  // -f[no-]discard-value-names. Names of non-global values are only
+  // useful when reading IR, so by default don't keep them around in
+  // compilers built without assertions.
+#ifdef NDEBUG
+  bool discardNamesDefault = true;
+#else
+  bool discardNamesDefault = false;
+#endif
+  context_.setDiscardValueNames(
+      driver_.reconcileOptionPair(gollvm::options::OPT_fdiscard_value_names,
+                                  gollvm::options::OPT_fno_discard_value_names,
+                                  discardNamesDefault));
+
   // Construct linemap and module
   linemap_.reset(new Llvm_linemap());
   module_.reset(new llvm::Module("gomodule", context_));
@@ -472,7 +975,44 @@ bool CompileGoImpl::initBridge()
   if (!tl)
     return false;
   bridge_->setTraceLevel(*tl);
+
+  // Honor -fgo-tree-integrity=... option.
+  opt::Arg *tiarg = args_.getLastArg(gollvm::options::OPT_fgo_tree_integrity_EQ);
+  if (tiarg != nullptr) {
+    StringRef val(tiarg->getValue());
+    if (val == "off")
+      bridge_->setTreeIntegrityMode(TreeIntegrityOff);
+    else if (val == "repair-only")
+      bridge_->setTreeIntegrityMode(TreeIntegrityRepairOnly);
+    else if (val == "full")
+      bridge_->setTreeIntegrityMode(TreeIntegrityFull);
+    else {
+      errs() << progname_ << ": invalid argument '"
+             << tiarg->getValue() << "' to '"
+             << tiarg->getAsString(args_) << "' option\n";
+      return false;
+    }
+  }
   bridge_->setNoInline(args_.hasArg(gollvm::options::OPT_fno_inline));
+
+  // -f[no-]go-strict-aliasing
+  bool strictAliasing =
+      driver_.reconcileOptionPair(gollvm::options::OPT_fgo_strict_aliasing,
+                                  gollvm::options::OPT_fno_go_strict_aliasing,
+                                  true);
+  bridge_->setStrictAliasing(strictAliasing);
+
+  // When we write the object file ourselves, the integrated assembler
+  // can pick up the export data as raw bytes from a temporary file
+  // (removed once the compilation is done) instead of having to parse
+  // escaped ".ascii" directives. Assembly and bitcode output have to
+  // stay self-contained.
+  if (fileType_ == TargetMachine::CGFT_ObjectFile && !thinLTO_) {
+    auto tfa = compilation_->createTemporaryFileArtifact(jobAction_, "gox");
+    if (!tfa)
+      return false;
+    bridge_->setExportDataFile((*tfa)->file());
+  }
   bridge_->setTargetCpuAttr(targetCpuAttr_);
   bridge_->setTargetFeaturesAttr(targetFeaturesAttr_);
 
@@ -483,6 +1023,10 @@ bool CompileGoImpl::initBridge()
                                   true);
   bridge_->setNoFpElim(!omitFp);
 
+  // Sample profiling wants discriminators and the profiling flag on
+  // the compile unit.
+  bridge_->setDebugInfoForProfiling(debugInfoForProfiling_);
+
   // Honor -fdebug-prefix=... option.
   for (const auto &arg : driver_.args().getAllArgValues(gollvm::options::OPT_fdebug_prefix_map_EQ))
     bridge_->addDebugPrefix(llvm::StringRef(arg).split('='));
@@ -648,8 +1192,13 @@ bool CompileGoImpl::invokeFrontEnd()
     bridge_->verifyModule();
   llvm::Optional<unsigned> tl =
       driver_.getLastArgAsInteger(gollvm::options::OPT_tracelevel_EQ, 0u);
-  if (*tl)
+  if (*tl) {
     std::cerr << "linemap stats:" << linemap_->statistics() << "\n";
+    unsigned hits, misses;
+    go_export_data_cache_stats(&hits, &misses);
+    std::cerr << "export data cache: hits=" << hits
+              << " misses=" << misses << "\n";
+  }
 
   // Delete the bridge at this point. In the case that there were
   // errors, this will help clean up any unreachable LLVM Instructions
@@ -665,101 +1214,555 @@ bool CompileGoImpl::invokeFrontEnd()
   return true;
 }
 
-void CompileGoImpl::createPasses(legacy::PassManager &MPM,
-                                           legacy::FunctionPassManager &FPM)
+PassBuilder::OptimizationLevel CompileGoImpl::optimizationLevel()
+{
+  if (sizeLevel_ == 1)
+    return PassBuilder::OptimizationLevel::Os;
+  if (sizeLevel_ == 2)
+    return PassBuilder::OptimizationLevel::Oz;
+  switch (olvl_) {
+    case 0: return PassBuilder::OptimizationLevel::O0;
+    case 1: return PassBuilder::OptimizationLevel::O1;
+    case 2: return PassBuilder::OptimizationLevel::O2;
+    default: return PassBuilder::OptimizationLevel::O3;
+  }
+}
+
+void CompileGoImpl::createPasses(PassBuilder &PB, ModulePassManager &MPM)
 {
   if (args_.hasArg(gollvm::options::OPT_disable_llvm_passes))
     return;
 
-  // FIXME: support LTO, ThinLTO, PGO
+  // FIXME: support full LTO
 
-  PassManagerBuilder pmb;
+  if (! args_.hasArg(gollvm::options::OPT_noverify))
+    MPM.addPass(VerifierPass());
 
-  // Configure the inliner
-  if (args_.hasArg(gollvm::options::OPT_fno_inline) || olvl_ == 0) {
-    // Nothing here at the moment. There is go:noinline, but no equivalent
-    // of go:alwaysinline.
-  } else {
-    bool disableInlineHotCallSite = false; // for autofdo, not yet supported
-    pmb.Inliner =
-        createFunctionInliningPass(olvl_, 2, disableInlineHotCallSite);
+  // Nothing to run at -O0. Note that there is go:noinline (and
+  // -fno-inline is implemented by the bridge via the noinline
+  // attribute), but no equivalent of go:alwaysinline, so there is
+  // no need to schedule the always-inliner.
+  if (olvl_ == 0)
+    return;
+
+  // For ThinLTO, run only the pre-link part of the pipeline here; the
+  // remainder runs in the ThinLTO backends at link time. Split-stack
+  // leaf elision is not done in that case: the backends run inside the
+  // linker (LLVMgold.so or lld) with LLVM's stock post-link pipeline,
+  // which offers no way to add a pass, and running it here instead
+  // would be unsafe, since the frame estimate is made before the
+  // post-link pipeline has unrolled, vectorized or otherwise grown the
+  // function. See also setup().
+  if (thinLTO_) {
+    MPM.addPass(PB.buildThinLTOPreLinkDefaultPipeline(optimizationLevel()));
+    return;
   }
 
-  pmb.OptLevel = olvl_;
-  pmb.SizeLevel = 0; // TODO: decide on right value here
-  pmb.PrepareForThinLTO = false;
-  pmb.PrepareForLTO = false;
+  MPM.addPass(PB.buildPerModuleDefaultPipeline(optimizationLevel()));
 
-  FPM.add(new TargetLibraryInfoWrapperPass(*tlii_));
-  if (! args_.hasArg(gollvm::options::OPT_noverify))
-    FPM.add(createVerifierPass());
+  // Elide split-stack prologues for small leaf functions. This has to
+  // come after inlining, which determines what is a leaf.
+  if (splitStackLeafBudget_)
+    MPM.addPass(SplitStackLeafPass(splitStackLeafBudget_));
+}
 
-  pmb.populateFunctionPassManager(FPM);
-  pmb.populateModulePassManager(MPM);
+// Helper class for -ftime-report. Hooks into the pass instrumentation
+// callbacks of the new pass manager so as to record, for each LLVM
+// pass, the number of times it was run, the time spent in it
+// (exclusive of any nested passes), and the net change in instruction
+// count for the IR units it was run on.
+
+class PassExecutionReport {
+ public:
+  void registerCallbacks(PassInstrumentationCallbacks &PIC);
+  void print(raw_ostream &os);
+
+ private:
+  typedef std::chrono::steady_clock clock;
+
+  struct PassRecord {
+    PassRecord() : time(clock::duration::zero()), runs(0), instrDelta(0) { }
+    clock::duration time;
+    unsigned runs;
+    int64_t instrDelta;
+  };
+
+  struct ActivePass {
+    StringRef passID;
+    PassRecord *record;
+    clock::time_point start;
+    int64_t instrCount;
+  };
+
+  StringMap<PassRecord> records_;
+  std::vector<ActivePass> stack_;
+
+  void beforePass(StringRef passID, Any IR);
+  void afterPass(StringRef passID, Any IR);
+  void popPass(StringRef passID, int64_t instrCount);
+};
+
+// Pass managers and adaptors are instrumented along with the passes
+// they contain; they are omitted from the report so as not to count
+// the same work twice.
+
+static bool isPassManagerOrAdaptor(StringRef passID)
+{
+  StringRef prefix = passID.substr(0, passID.find('<'));
+  return (prefix.endswith("PassManager") ||
+          prefix.endswith("PassAdaptor") ||
+          prefix.endswith("AnalysisManagerProxy"));
+}
+
+// Returns the number of instructions in an IR unit, or -1 if
+// the unit kind is not handled.
+
+static int64_t instructionCount(Any IR)
+{
+  if (any_isa<const Module *>(IR))
+    return any_cast<const Module *>(IR)->getInstructionCount();
+  if (any_isa<const Function *>(IR))
+    return any_cast<const Function *>(IR)->getInstructionCount();
+  if (any_isa<const LazyCallGraph::SCC *>(IR)) {
+    int64_t count = 0;
+    for (const LazyCallGraph::Node &node :
+             *any_cast<const LazyCallGraph::SCC *>(IR))
+      count += node.getFunction().getInstructionCount();
+    return count;
+  }
+  if (any_isa<const Loop *>(IR)) {
+    int64_t count = 0;
+    for (const BasicBlock *bb : any_cast<const Loop *>(IR)->blocks())
+      count += bb->size();
+    return count;
+  }
+  return -1;
+}
+
+void PassExecutionReport::registerCallbacks(PassInstrumentationCallbacks &PIC)
+{
+  PIC.registerBeforePassCallback([this](StringRef passID, Any IR) {
+      beforePass(passID, IR);
+      return true;
+    });
+  PIC.registerAfterPassCallback([this](StringRef passID, Any IR) {
+      afterPass(passID, IR);
+    });
+  PIC.registerAfterPassInvalidatedCallback([this](StringRef passID) {
+      popPass(passID, -1);
+    });
+}
+
+void PassExecutionReport::beforePass(StringRef passID, Any IR)
+{
+  if (isPassManagerOrAdaptor(passID))
+    return;
+  clock::time_point now = clock::now();
+
+  // Stop the clock for the enclosing pass (if any).
+  if (!stack_.empty())
+    stack_.back().record->time += now - stack_.back().start;
+
+  ActivePass ap;
+  ap.passID = passID;
+  ap.record = &records_[passID];
+  ap.start = now;
+  ap.instrCount = instructionCount(IR);
+  stack_.push_back(ap);
+}
+
+void PassExecutionReport::afterPass(StringRef passID, Any IR)
+{
+  if (isPassManagerOrAdaptor(passID))
+    return;
+  popPass(passID, instructionCount(IR));
+}
+
+void PassExecutionReport::popPass(StringRef passID, int64_t instrCount)
+{
+  if (isPassManagerOrAdaptor(passID))
+    return;
+  clock::time_point now = clock::now();
+  while (!stack_.empty()) {
+    ActivePass ap = stack_.back();
+    stack_.pop_back();
+    ap.record->time += now - ap.start;
+    ap.record->runs += 1;
+    if (ap.passID == passID) {
+      if (ap.instrCount >= 0 && instrCount >= 0)
+        ap.record->instrDelta += instrCount - ap.instrCount;
+      break;
+    }
+  }
+
+  // Restart the clock for the enclosing pass.
+  if (!stack_.empty())
+    stack_.back().start = now;
+}
+
+void PassExecutionReport::print(raw_ostream &os)
+{
+  std::vector<std::pair<StringRef, PassRecord *>> sorted;
+  clock::duration total = clock::duration::zero();
+  for (auto &ent : records_) {
+    sorted.push_back(std::make_pair(ent.getKey(), &ent.getValue()));
+    total += ent.getValue().time;
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<StringRef, PassRecord *> &a,
+               const std::pair<StringRef, PassRecord *> &b) {
+              if (a.second->time != b.second->time)
+                return a.second->time > b.second->time;
+              return a.first < b.first;
+            });
+
+  typedef std::chrono::duration<double> seconds;
+  double totalSecs = std::chrono::duration_cast<seconds>(total).count();
+  os << "===" << std::string(73, '-') << "===\n"
+     << "                      LLVM pass execution report\n"
+     << "===" << std::string(73, '-') << "===\n"
+     << format("  Total optimization pass time: %.4f seconds\n\n",
+               totalSecs)
+     << "   Time (s)   Pct     Runs  Instr delta  Pass\n";
+  for (auto &ent : sorted) {
+    double secs =
+        std::chrono::duration_cast<seconds>(ent.second->time).count();
+    double pct = (totalSecs > 0.0 ? 100.0 * secs / totalSecs : 0.0);
+    os << format("  %9.4f %5.1f%% %8u %12lld  ", secs, pct,
+                 ent.second->runs, (long long) ent.second->instrDelta)
+       << ent.first << "\n";
+  }
+  os << "\n";
+}
+
+bool CompileGoImpl::addCodeGenPasses(TargetMachine &tm,
+                                     legacy::PassManager &codeGenPasses,
+                                     raw_pwrite_stream &os,
+                                     TargetMachine::CodeGenFileType ft)
+{
+  codeGenPasses.add(
+      createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+  codeGenPasses.add(new TargetLibraryInfoWrapperPass(*tlii_));
+  bool noverify = args_.hasArg(gollvm::options::OPT_noverify);
+  if (tm.addPassesToEmitFile(codeGenPasses, os, nullptr, ft,
+                             /*DisableVerify=*/ noverify)) {
+    errs() << "error: unable to interface with target\n";
+    return false;
+  }
+  return true;
 }
 
 bool CompileGoImpl::invokeBackEnd()
 {
   tlii_.reset(new TargetLibraryInfoImpl(triple_));
 
-  // Set up module and function passes
-  legacy::PassManager modulePasses;
-  modulePasses.add(
-      createTargetTransformInfoWrapperPass(target_->getTargetIRAnalysis()));
-  legacy::FunctionPassManager functionPasses(module_.get());
-  functionPasses.add(
-      createTargetTransformInfoWrapperPass(target_->getTargetIRAnalysis()));
-  createPasses(modulePasses, functionPasses);
+  // Support -ftime-report. The optimization pipeline is covered by
+  // the report below; for the legacy pass manager used for code
+  // generation we rely on LLVM's own pass timers.
+  bool timeReport = args_.hasArg(gollvm::options::OPT_ftime_report);
+  PassInstrumentationCallbacks PIC;
+  std::unique_ptr<PassExecutionReport> report;
+  if (timeReport) {
+    report.reset(new PassExecutionReport());
+    report->registerCallbacks(PIC);
+    TimePassesIsEnabled = true;
+  }
+
+  // Set up the optimization pipeline and analysis managers.
+  PassBuilder PB(target_.get(), pgoOptions_, &PIC);
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+
+  // Register our target library info first, so that it takes
+  // precedence over the default one registered by the pass builder.
+  FAM.registerPass([&] { return TargetLibraryAnalysis(*tlii_); });
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  ModulePassManager modulePasses;
+  createPasses(PB, modulePasses);
 
   // Add passes to emit bitcode or LLVM IR as appropriate. Here we mimic
   // clang behavior, which is to emit bitcode when "-emit-llvm" is specified
   // but an LLVM IR dump of "-S -emit-llvm" is used.
   raw_pwrite_stream *OS = &asmout_->os();
-  if (args_.hasArg(gollvm::options::OPT_emit_llvm)) {
+  if (thinLTO_) {
+    // ThinLTO object: bitcode plus module summary index. The module
+    // inline asm holding the export data is carried along in the
+    // bitcode, where go_read_export_data knows to look for it.
+    modulePasses.addPass(BitcodeWriterPass(*OS, false,
+                                           /*EmitSummaryIndex=*/true,
+                                           /*EmitModuleHash=*/true));
+  } else if (args_.hasArg(gollvm::options::OPT_emit_llvm)) {
     bool bitcode = !args_.hasArg(gollvm::options::OPT_S);
     bool preserveUseLists =
         driver_.reconcileOptionPair(gollvm::options::OPT_emit_llvm_uselists,
                                     gollvm::options::OPT_no_emit_llvm_uselists,
                                     false);
-    modulePasses.add(bitcode ?
-                     createBitcodeWriterPass(*OS, preserveUseLists) :
-                     createPrintModulePass(*OS, "", preserveUseLists));
+    if (bitcode)
+      modulePasses.addPass(BitcodeWriterPass(*OS, preserveUseLists));
+    else
+      modulePasses.addPass(PrintModulePass(*OS, "", preserveUseLists));
   }
 
-  // Set up codegen passes
+  // Set up codegen passes. When code generation is split into
+  // partitions, each partition gets its own pipeline instead.
   legacy::PassManager codeGenPasses;
-  codeGenPasses.add(
-      createTargetTransformInfoWrapperPass(target_->getTargetIRAnalysis()));
-
-  // Codegen setup
-  codeGenPasses.add(new TargetLibraryInfoWrapperPass(*tlii_));
-  bool noverify = args_.hasArg(gollvm::options::OPT_noverify);
-  TargetMachine::CodeGenFileType ft = TargetMachine::CGFT_AssemblyFile;
-  if (target_->addPassesToEmitFile(codeGenPasses, *OS, nullptr, ft,
-                                   /*DisableVerify=*/ noverify)) {
-    errs() << "error: unable to interface with target\n";
+  bool emitLLVM = args_.hasArg(gollvm::options::OPT_emit_llvm);
+  if (codegenPartitions_ <= 1 && !thinLTO_ && !emitLLVM &&
+      !addCodeGenPasses(*target_, codeGenPasses, *OS, fileType_))
     return false;
-  }
 
-  // Here we go... first function passes
-  functionPasses.doInitialization();
-  for (Function &F : *module_.get())
-    if (!F.isDeclaration())
-      functionPasses.run(F);
-  functionPasses.doFinalization();
+  // Here we go... first the optimization pipeline
+  modulePasses.run(*module_.get(), MAM);
+  if (report)
+    report->print(errs());
 
-  // ... then module passes
-  modulePasses.run(*module_.get());
+  // No code generation for -emit-llvm; with ThinLTO, code generation
+  // happens at link time.
+  if (thinLTO_ || emitLLVM)
+    return !hasError_;
+
+  // Code generation modifies the IR, so the module used for the
+  // -fgo-dual-pic-output variant has to be cloned at this point.
+  std::unique_ptr<Module> picModule;
+  if (picAsmout_)
+    picModule = makeDualPicModule(*module_.get());
 
   // ... and finally code generation
-  codeGenPasses.run(*module_.get());
+  if (codegenPartitions_ > 1) {
+    if (!invokeParallelCodeGen(std::move(picModule)))
+      return false;
+  } else {
+    codeGenPasses.run(*module_.get());
+    if (picModule && !invokeDualPicCodeGen(std::move(picModule)))
+      return false;
+  }
+
+  if (hasError_)
+    return false;
+
+  return scheduleDualPicAssembly();
+}
+
+// Return the module to code-generate for -fgo-dual-pic-output: a clone
+// of the optimized (non-PIC) module, turned into the module a -fPIC
+// compile would have produced. Neither the bridge nor the optimization
+// pipeline consult the relocation model, so the IR only differs in
+// the "PIC Level" module flag, and in dso_local markings: these say
+// that a symbol can't be preempted, which may hold for a non-PIC
+// object but not for a PIC one. Nothing sets them on Go symbols today
+// (code generation works out locality from the relocation model), but
+// they are dropped from the clone rather than trusted. The check_dual_pic
+// target in gotools compares the result against a separate -fPIC
+// compile.
+
+std::unique_ptr<Module> CompileGoImpl::makeDualPicModule(const Module &module)
+{
+  std::unique_ptr<Module> picModule = CloneModule(module);
+
+  // Module::setPICLevel adds a flag; the existing one has to go first,
+  // since duplicate flags are rejected by the verifier.
+  SmallVector<Module::ModuleFlagEntry, 8> flags;
+  picModule->getModuleFlagsMetadata(flags);
+  if (NamedMDNode *md = picModule->getModuleFlagsMetadata())
+    picModule->eraseNamedMetadata(md);
+  for (auto &flag : flags)
+    if (flag.Key->getString() != "PIC Level")
+      picModule->addModuleFlag(flag.Behavior, flag.Key->getString(),
+                               flag.Val);
+  picModule->setPICLevel(PICLevel::BigPIC);
+
+  for (GlobalValue &gv : picModule->global_values())
+    if (!gv.hasLocalLinkage() && gv.hasDefaultVisibility())
+      gv.setDSOLocal(false);
+  return picModule;
+}
+
+// Run code generation for the PIC variant of the module, when code
+// generation is not split into partitions.
+
+bool CompileGoImpl::invokeDualPicCodeGen(std::unique_ptr<Module> picModule)
+{
+  std::unique_ptr<TargetMachine> tm = createTargetMachine(Reloc::PIC_);
+  legacy::PassManager codeGenPasses;
+  if (!addCodeGenPasses(*tm, codeGenPasses, picAsmout_->os(), fileType_))
+    return false;
+  codeGenPasses.run(*picModule);
+  return true;
+}
+
+// Split the optimized module into partitions and run code generation
+// for each of them on a separate thread. LLVM contexts are not
+// thread-safe, so each partition is round-tripped through bitcode
+// into a private context (this mirrors what llvm::splitCodeGen does).
+//
+// Partition 0 is the only partition that keeps the module inline asm
+// (which holds the Go export data). With the integrated assembler,
+// every partition is written to a temporary object file, and a
+// relocatable link of those objects (scheduled here) produces the
+// compile output. With an external assembler, partition 0 is written
+// to the regular output as assembly, the remaining partitions are
+// recorded as supplemental outputs of the compile action, and the
+// assembler tool folds them into the final object.
+//
+// The -fgo-dual-pic-output variant, if any, is split and generated
+// the same way, in the same thread pool, and its partitions end up in
+// the PIC output.
+
+bool CompileGoImpl::invokeParallelCodeGen(std::unique_ptr<Module> picModule)
+{
+  PartitionedCodeGen main, pic;
+  std::vector<PartitionedCodeGen *> variants;
+  if (!splitForCodeGen(std::move(module_), relocModel_, asmout_->os(),
+                       jobAction_, &main))
+    return false;
+  variants.push_back(&main);
+  if (picModule) {
+    const Action *picAsmInput =
+        (picAsmAction_ ? picAsmAction_->inputs()[0] : nullptr);
+    if (!splitForCodeGen(std::move(picModule), Reloc::PIC_,
+                         picAsmout_->os(), picAsmInput, &pic))
+      return false;
+    variants.push_back(&pic);
+  }
+
+  {
+    ThreadPool codeGenPool(codegenPartitions_);
+    for (PartitionedCodeGen *pcg : variants)
+      for (unsigned idx = 0; idx < pcg->bitcodes.size(); ++idx)
+        codeGenPool.async([this, pcg, idx]() {
+          codeGenPartition(*pcg, idx);
+        });
+    codeGenPool.wait();
+  }
+
+  for (PartitionedCodeGen *pcg : variants) {
+    for (unsigned idx = 0; idx < pcg->bitcodes.size(); ++idx) {
+      if (!pcg->partMessages[idx].empty())
+        errs() << progname_ << ": error: " << pcg->partMessages[idx] << "\n";
+      if (pcg->partErrors[idx])
+        hasError_ = true;
+    }
+  }
 
   if (hasError_)
     return false;
 
+  // Schedule the links that combine the partition objects into the
+  // compile output (and the PIC output). The commands are created
+  // now; they will not be executed if the compile fails.
+  if (fileType_ == TargetMachine::CGFT_ObjectFile) {
+    Tool *assembler = compilation_->toolchain().getAssembler();
+    auto *as = static_cast<gnutools::Assembler *>(assembler);
+    for (PartitionedCodeGen *pcg : variants) {
+      ArtifactList rest(pcg->partArtifacts.begin() + 1,
+                        pcg->partArtifacts.end());
+      const Artifact &output = (pcg == &main ? *output_ : *picObj_);
+      if (!as->combinePartitions(*compilation_, *jobAction_,
+                                 *pcg->partArtifacts[0], rest, output))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+// Split 'module' for code generation with the specified relocation
+// model, and open outputs for the partitions. When emitting assembly,
+// partition 0 goes to 'asmOut' and the object partitions are recorded
+// as supplemental outputs of 'asmInput', for the assembler to fold in.
+
+bool CompileGoImpl::splitForCodeGen(std::unique_ptr<Module> module,
+                                    Optional<Reloc::Model> relocModel,
+                                    raw_pwrite_stream &asmOut,
+                                    const Action *asmInput,
+                                    PartitionedCodeGen *pcg)
+{
+  // Locals are preserved (kept in the same partition as the functions
+  // that reference them) as opposed to being externalized, since
+  // externalized symbols from different packages could collide at
+  // link time.
+  std::vector<SmallString<0>> &bitcodes = pcg->bitcodes;
+  SplitModule(std::move(module), codegenPartitions_,
+              [&](std::unique_ptr<Module> part) {
+                if (!bitcodes.empty())
+                  part->setModuleInlineAsm("");
+                bitcodes.emplace_back();
+                raw_svector_ostream bcos(bitcodes.back());
+                WriteBitcodeToFile(*part, bcos);
+              },
+              /*PreserveLocals=*/true);
+  pcg->relocModel = relocModel;
+  pcg->partErrors.assign(bitcodes.size(), 0);
+  pcg->partMessages.resize(bitcodes.size());
+
+  // Open outputs for the object partitions.
+  bool emitObject = (fileType_ == TargetMachine::CGFT_ObjectFile);
+  pcg->asmOut = (emitObject ? nullptr : &asmOut);
+  for (unsigned idx = (emitObject ? 0 : 1); idx < bitcodes.size(); ++idx) {
+    auto tfa = compilation_->createTemporaryFileArtifact(jobAction_, "o");
+    if (!tfa)
+      return false;
+    std::error_code EC;
+    auto FDOut = llvm::make_unique<ToolOutputFile>((*tfa)->file(), EC,
+                                                   sys::fs::F_None);
+    if (EC) {
+      errs() << progname_ << ": error opening " << (*tfa)->file() << ": "
+             << EC.message() << '\n';
+      return false;
+    }
+    FDOut->keep();
+    if (!emitObject)
+      compilation_->addSupplementalOutput(asmInput, *tfa);
+    pcg->partArtifacts.push_back(*tfa);
+    pcg->partOuts.push_back(std::move(FDOut));
+  }
   return true;
 }
 
+// Run code generation for one partition; called on a worker thread.
+
+void CompileGoImpl::codeGenPartition(PartitionedCodeGen &pcg, unsigned idx)
+{
+  unsigned firstObjPart = (pcg.asmOut ? 1 : 0);
+  raw_pwrite_stream *os =
+      (idx < firstObjPart ? pcg.asmOut :
+       &pcg.partOuts[idx - firstObjPart]->os());
+  TargetMachine::CodeGenFileType ft =
+      (idx < firstObjPart ? fileType_ : TargetMachine::CGFT_ObjectFile);
+
+  LLVMContext ctx;
+  bool partError = false;
+  ctx.setDiagnosticHandler(
+      llvm::make_unique<BEDiagnosticHandler>(&partError));
+  SmallString<0> &bc = pcg.bitcodes[idx];
+  Expected<std::unique_ptr<Module>> partOrErr =
+      parseBitcodeFile(MemoryBufferRef(StringRef(bc.data(), bc.size()),
+                                       "<split-module>"), ctx);
+  if (!partOrErr) {
+    pcg.partMessages[idx] = "failed to read bitcode for partition: " +
+        toString(partOrErr.takeError());
+    pcg.partErrors[idx] = 1;
+    return;
+  }
+  std::unique_ptr<Module> part(std::move(partOrErr.get()));
+
+  std::unique_ptr<TargetMachine> tm = createTargetMachine(pcg.relocModel);
+  legacy::PassManager codeGenPasses;
+  if (!addCodeGenPasses(*tm, codeGenPasses, *os, ft)) {
+    pcg.partErrors[idx] = 1;
+    return;
+  }
+  codeGenPasses.run(*part);
+  pcg.partErrors[idx] = partError;
+}
+
 //......................................................................
 
 CompileGo::CompileGo(ToolChain &tc, const std::string &executablePath)
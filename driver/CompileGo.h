@@ -15,6 +15,9 @@
 
 #include "Tool.h"
 
+#include <string>
+#include <vector>
+
 namespace gollvm {
 namespace driver {
 
@@ -43,6 +46,16 @@ class CompileGo : public InternalTool {
   std::unique_ptr<CompileGoImpl> impl_;
 };
 
+// Support for the compile server (see CompileServer.h). Returns the
+// configurations of the target machines created by compiles in this
+// process, in the form accepted by warmTargetMachine.
+std::vector<std::string> targetMachineConfigsUsed();
+
+// Create a target machine (and the subtarget compiles will use) for
+// the specified configuration ahead of time, for use by compiles
+// carried out in processes forked from this one.
+void warmTargetMachine(const std::string &config);
+
 } // end namespace driver
 } // end namespace gollvm
 
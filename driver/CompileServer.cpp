@@ -0,0 +1,535 @@
+//===-- CompileServer.cpp -------------------------------------------------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Gollvm driver compile server: a long-lived llvm-goc process that
+// accepts compile requests over a Unix domain socket.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CompileGo.h"
+#include "CompileServer.h"
+#include "go-export-data.h"
+#include "go-export-data.h"
+
+extern char **environ;
+
+namespace gollvm {
+namespace driver {
+
+// Wire protocol. The client first sends a single byte carrying its
+// standard input/output/error descriptors as ancillary data, then a
+// series of length-prefixed strings: magic, server identity, working
+// directory, argument count + arguments, environment count +
+// environment. The server replies with a single int32, either the
+// exit status of the compile or kRejected.
+static const char kMagic[] = "gollvm-compile-server-1";
+static const int32_t kRejected = -1;
+static const uint32_t kMaxStringLen = 1 << 24;
+
+static bool writeAll(int fd, const void *buf, size_t len)
+{
+  const char *p = static_cast<const char *>(buf);
+  while (len != 0) {
+    ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, void *buf, size_t len)
+{
+  char *p = static_cast<char *>(buf);
+  while (len != 0) {
+    ssize_t n = ::read(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool writeU32(int fd, uint32_t val)
+{
+  return writeAll(fd, &val, sizeof(val));
+}
+
+static bool readU32(int fd, uint32_t &val)
+{
+  return readAll(fd, &val, sizeof(val));
+}
+
+static bool writeString(int fd, llvm::StringRef str)
+{
+  return writeU32(fd, str.size()) && writeAll(fd, str.data(), str.size());
+}
+
+static bool readString(int fd, std::string &str)
+{
+  uint32_t len;
+  if (!readU32(fd, len) || len > kMaxStringLen)
+    return false;
+  str.resize(len);
+  return len == 0 || readAll(fd, &str[0], len);
+}
+
+static bool writeStrings(int fd, const std::vector<std::string> &strs)
+{
+  if (!writeU32(fd, strs.size()))
+    return false;
+  for (auto &s : strs)
+    if (!writeString(fd, s))
+      return false;
+  return true;
+}
+
+static bool readStrings(int fd, std::vector<std::string> &strs)
+{
+  uint32_t count;
+  if (!readU32(fd, count) || count > kMaxStringLen)
+    return false;
+  strs.resize(count);
+  for (auto &s : strs)
+    if (!readString(fd, s))
+      return false;
+  return true;
+}
+
+// Identifies the llvm-goc build on either end of the socket, so that a
+// client never has its compile carried out by a stale or different
+// compiler binary.
+static std::string serverIdentity(const char *argv0)
+{
+  std::string exe =
+      llvm::sys::fs::getMainExecutable(argv0, (void*) &serverIdentity);
+  llvm::sys::fs::file_status st;
+  if (exe.empty() || llvm::sys::fs::status(exe, st))
+    return std::string();
+  return exe + "@" +
+      std::to_string(st.getLastModificationTime().time_since_epoch().count());
+}
+
+static bool fillSockAddr(const char *socketPath, struct sockaddr_un &addr)
+{
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(addr.sun_path))
+    return false;
+  strcpy(addr.sun_path, socketPath);
+  return true;
+}
+
+static int connectTo(const char *socketPath)
+{
+  struct sockaddr_un addr;
+  if (!fillSockAddr(socketPath, addr))
+    return -1;
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Returns true if the process on the other end of the connection runs
+// as the same user as this one. Both ends check: the server must not
+// run compiles for other users, and a client must not hand its
+// environment and file descriptors to a server run by someone else.
+static bool peerIsSameUser(int sock)
+{
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if (::getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 ||
+      len != sizeof(cred))
+    return false;
+  return cred.uid == ::geteuid();
+}
+
+// Control message buffer for passing the three standard descriptors;
+// the union gives it the alignment cmsghdr requires.
+union StdFdsControl {
+  struct cmsghdr hdr;
+  char buf[CMSG_SPACE(3 * sizeof(int))];
+};
+
+static bool sendStdFds(int sock)
+{
+  int fds[3] = { 0, 1, 2 };
+  char byte = 0;
+  struct iovec iov = { &byte, 1 };
+  StdFdsControl control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  ssize_t n;
+  do {
+    n = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  return n == 1;
+}
+
+static bool recvStdFds(int sock, int fds[3])
+{
+  char byte;
+  struct iovec iov = { &byte, 1 };
+  StdFdsControl control;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  ssize_t n;
+  do {
+    n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n != 1)
+    return false;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr ||
+      cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+    return false;
+  memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+  return true;
+}
+
+llvm::Optional<int> forwardToCompileServer(const char *socketPath,
+                                           int argc, char **argv)
+{
+  std::string identity = serverIdentity(argv[0]);
+  if (identity.empty())
+    return llvm::None;
+  int sock = connectTo(socketPath);
+  if (sock < 0)
+    return llvm::None;
+  if (!peerIsSameUser(sock)) {
+    ::close(sock);
+    return llvm::None;
+  }
+
+  llvm::SmallString<256> cwd;
+  std::vector<std::string> args(argv, argv + argc);
+  std::vector<std::string> env;
+  for (char **e = environ; *e != nullptr; ++e)
+    env.push_back(*e);
+
+  // A failure while sending the request means the compile never
+  // started, so it is safe for the caller to run it locally.
+  bool sent = (!llvm::sys::fs::current_path(cwd) &&
+               sendStdFds(sock) &&
+               writeString(sock, kMagic) &&
+               writeString(sock, identity) &&
+               writeString(sock, cwd) &&
+               writeStrings(sock, args) &&
+               writeStrings(sock, env));
+  int32_t status = kRejected;
+  bool replied = sent && readAll(sock, &status, sizeof(status));
+  ::close(sock);
+  if (!sent || (replied && status == kRejected))
+    return llvm::None;
+  if (!replied) {
+    llvm::errs() << argv[0] << ": error: lost connection to compile "
+                 << "server '" << socketPath << "'\n";
+    return 1;
+  }
+  return status;
+}
+
+// Warm state. Compiles run in processes forked from the server, so
+// anything they set up is lost when they exit. Instead, once a compile
+// succeeds it reports (over a datagram socket back to the server) the
+// target machine configurations it used and the files it read export
+// data from; the server then creates those target machines, and
+// indexes those files (locating the export data of each object in
+// them), and compiles forked afterwards inherit the result. What is
+// shared is where the export data lives, not anything parsed from it:
+// each compile still reads and parses its imports itself, since the
+// front end keeps imported packages in global state. Reporting is best
+// effort: messages that don't fit in the socket buffer are dropped.
+enum WarmItemKind : char {
+  WarmTargetMachine = 'T',
+  WarmExportData = 'E'
+};
+
+static void sendWarmItem(int reportFd, WarmItemKind kind,
+                         const std::string &payload)
+{
+  std::string msg(1, kind);
+  msg += payload;
+  ::send(reportFd, msg.data(), msg.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+static void reportWarmState(int reportFd)
+{
+  for (auto &config : targetMachineConfigsUsed())
+    sendWarmItem(reportFd, WarmTargetMachine, config);
+  std::vector<std::string> paths;
+  go_export_data_paths(&paths);
+  for (auto &path : paths)
+    sendWarmItem(reportFd, WarmExportData, path);
+}
+
+static void applyWarmState(int reportFd)
+{
+  std::vector<char> buf(1 << 16);
+  for (;;) {
+    ssize_t n = ::recv(reportFd, buf.data(), buf.size(), MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    std::string payload(buf.data() + 1, n - 1);
+    if (buf[0] == WarmTargetMachine)
+      warmTargetMachine(payload);
+    else if (buf[0] == WarmExportData)
+      go_preload_export_data(payload.c_str());
+  }
+}
+
+// Runs the compile described by a request in a child of the
+// connection handler, so that the frontend's global state starts out
+// fresh and a crash in the compile is reported back to the client as
+// an exit status rather than a dropped connection.
+static int32_t runRequest(DriverMainFn driverMain,
+                          int reportFd,
+                          int fds[3],
+                          const std::string &cwd,
+                          std::vector<std::string> &args,
+                          const std::vector<std::string> &env)
+{
+  pid_t pid = ::fork();
+  if (pid < 0)
+    return kRejected;
+  if (pid == 0) {
+    for (int i = 0; i < 3; ++i) {
+      if (::dup2(fds[i], i) < 0)
+        _exit(1);
+      ::close(fds[i]);
+    }
+    if (::chdir(cwd.c_str()) != 0)
+      _exit(1);
+    ::clearenv();
+    for (auto &e : env) {
+      size_t eq = e.find('=');
+      if (eq != std::string::npos && eq != 0)
+        ::setenv(e.substr(0, eq).c_str(), e.c_str() + eq + 1, 1);
+    }
+    std::vector<char *> argv;
+    for (auto &a : args)
+      argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    int rc = driverMain(args.size(), argv.data());
+    if (rc == 0)
+      reportWarmState(reportFd);
+    exit(rc);
+  }
+
+  int wstatus;
+  pid_t rv;
+  do {
+    rv = ::waitpid(pid, &wstatus, 0);
+  } while (rv < 0 && errno == EINTR);
+  if (rv < 0)
+    return 1;
+  if (WIFEXITED(wstatus))
+    return WEXITSTATUS(wstatus);
+  if (WIFSIGNALED(wstatus))
+    return 128 + WTERMSIG(wstatus);
+  return 1;
+}
+
+static void handleConnection(int conn,
+                             int reportFd,
+                             const std::string &identity,
+                             DriverMainFn driverMain)
+{
+  int fds[3];
+  if (!recvStdFds(conn, fds))
+    return;
+
+  std::string magic, clientIdentity, cwd;
+  std::vector<std::string> args, env;
+  int32_t status = kRejected;
+  if (readString(conn, magic) && magic == kMagic &&
+      readString(conn, clientIdentity) &&
+      readString(conn, cwd) &&
+      readStrings(conn, args) && !args.empty() &&
+      readStrings(conn, env)) {
+    if (clientIdentity == identity)
+      status = runRequest(driverMain, reportFd, fds, cwd, args, env);
+  }
+  for (int i = 0; i < 3; ++i)
+    ::close(fds[i]);
+  writeAll(conn, &status, sizeof(status));
+}
+
+int runCompileServer(const char *progname,
+                     const char *socketPath,
+                     DriverMainFn driverMain)
+{
+  std::string identity = serverIdentity(progname);
+  if (identity.empty()) {
+    llvm::errs() << progname << ": error: unable to locate "
+                 << "compiler executable for compile server\n";
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  if (!fillSockAddr(socketPath, addr)) {
+    llvm::errs() << progname << ": error: compile server socket path '"
+                 << socketPath << "' is too long\n";
+    return 1;
+  }
+
+  // Refuse to take over the socket of a server that is still live;
+  // otherwise clean up a stale socket left behind by a previous one.
+  int probe = connectTo(socketPath);
+  if (probe >= 0) {
+    ::close(probe);
+    llvm::errs() << progname << ": error: a compile server is already "
+                 << "listening on '" << socketPath << "'\n";
+    return 1;
+  }
+  ::unlink(socketPath);
+
+  // A request runs with our privileges whatever it asks for (linker,
+  // plugins, output paths), so only the user running the server may
+  // connect: the socket is created accessible to its owner only (the
+  // umask covers the window between bind and chmod), and connections
+  // from other users are refused below.
+  int lsock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  bool bound = false;
+  if (lsock >= 0) {
+    mode_t oldMask = ::umask(0177);
+    bound = (::bind(lsock, reinterpret_cast<struct sockaddr *>(&addr),
+                    sizeof(addr)) == 0);
+    ::umask(oldMask);
+  }
+  if (!bound ||
+      ::chmod(socketPath, S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(lsock, SOMAXCONN) != 0) {
+    llvm::errs() << progname << ": error: unable to listen on '"
+                 << socketPath << "': " << strerror(errno) << "\n";
+    if (lsock >= 0)
+      ::close(lsock);
+    return 1;
+  }
+
+  // Connection handlers are reaped automatically; clients that go away
+  // early must not take the server down with them.
+  ::signal(SIGCHLD, SIG_IGN);
+  ::signal(SIGPIPE, SIG_IGN);
+
+  // Do the expensive one-time setup here, so that each forked request
+  // inherits it instead of repeating it.
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+  llvm::InitializeAllAsmParsers();
+
+  // Channel over which compiles report warm state (see above).
+  int report[2];
+  if (::socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, report) != 0) {
+    llvm::errs() << progname << ": error: compile server setup failed: "
+                 << strerror(errno) << "\n";
+    ::close(lsock);
+    return 1;
+  }
+
+  for (;;) {
+    struct pollfd pfds[2] = { { lsock, POLLIN, 0 },
+                              { report[0], POLLIN, 0 } };
+    if (::poll(pfds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      llvm::errs() << progname << ": error: compile server poll failed: "
+                   << strerror(errno) << "\n";
+      ::close(lsock);
+      return 1;
+    }
+    if (pfds[1].revents & POLLIN)
+      applyWarmState(report[0]);
+    if (!(pfds[0].revents & POLLIN))
+      continue;
+
+    int conn = ::accept4(lsock, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      llvm::errs() << progname << ": error: compile server accept failed: "
+                   << strerror(errno) << "\n";
+      ::close(lsock);
+      return 1;
+    }
+    if (!peerIsSameUser(conn)) {
+      ::close(conn);
+      continue;
+    }
+    pid_t pid = ::fork();
+    if (pid == 0) {
+      ::close(lsock);
+      ::close(report[0]);
+      ::signal(SIGCHLD, SIG_DFL);
+      handleConnection(conn, report[1], identity, driverMain);
+      ::close(conn);
+      _exit(0);
+    }
+    if (pid < 0) {
+      int32_t status = kRejected;
+      writeAll(conn, &status, sizeof(status));
+    }
+    ::close(conn);
+  }
+}
+
+} // end namespace driver
+} // end namespace gollvm
@@ -0,0 +1,59 @@
+//===-- CompileServer.h ---------------------------------------------------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the compile server entry points (helper for driver functionality).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GOLLVM_DRIVER_COMPILESERVER_H
+#define GOLLVM_DRIVER_COMPILESERVER_H
+
+#include "llvm/ADT/Optional.h"
+
+namespace gollvm {
+namespace driver {
+
+// Environment variable that opts in to use of a compile server: when
+// set to the path of a server's socket, the driver forwards its
+// invocation to that server instead of compiling in-process.
+#define GOLLVM_COMPILE_SERVER_ENV "GOLLVM_COMPILE_SERVER"
+
+// Function used to carry out a single (ordinary) driver invocation.
+typedef int (*DriverMainFn)(int argc, char **argv);
+
+// Run as a compile server (llvm-goc --compile-server=<path>), accepting
+// requests on the Unix domain socket at 'socketPath'. The Go frontend
+// keeps global state, so each request is carried out in a process
+// forked from the server, which inherits the server's initialized
+// state (registered targets, option tables, etc) rather than paying
+// for it at startup. Compiles also report back the target machines
+// they created and the files they read export data from; the server
+// sets these up in turn, so that later compiles start with warm
+// target machines, and with the export data in those files already
+// located (the export data is still read and parsed by each
+// compile). The socket is only accessible to the user running the
+// server, and connections from other users are refused. Returns only
+// on error.
+int runCompileServer(const char *progname,
+                     const char *socketPath,
+                     DriverMainFn driverMain);
+
+// Forward this invocation to the compile server listening on
+// 'socketPath'. The request carries the command line, working directory
+// and environment, along with our standard input/output/error, so the
+// compile behaves as if it had been run locally. Returns the exit status
+// of the remote compile, or None if the server could not be used (not
+// running, or a different llvm-goc build), in which case the caller
+// should carry out the compile itself.
+llvm::Optional<int> forwardToCompileServer(const char *socketPath,
+                                           int argc, char **argv);
+
+} // end namespace driver
+} // end namespace gollvm
+
+#endif // GOLLVM_DRIVER_COMPILESERVER_H
@@ -215,6 +215,47 @@ bool Driver::picIsPIE()
           opt.matches(gollvm::options::OPT_fpie));
 }
 
+// Returns TRUE if -flto=thin is in effect (rightmost of -flto=...
+// and -fno-lto wins). Validation of the -flto= value is done in setup().
+
+bool Driver::usingThinLTO()
+{
+  opt::Arg *arg = args_.getLastArg(gollvm::options::OPT_flto_EQ,
+                                   gollvm::options::OPT_fno_lto);
+  if (arg == nullptr || arg->getOption().matches(gollvm::options::OPT_fno_lto))
+    return false;
+  return llvm::StringRef(arg->getValue()).equals("thin");
+}
+
+// Returns TRUE if the compiler should write object files directly
+// (integrated assembler) as opposed to emitting assembly for an
+// external assembler. The external assembler is still used with
+// -fno-integrated-as, and when there are -Wa,/-Xassembler options to
+// honor.
+
+bool Driver::usingIntegratedAssembler()
+{
+  if (!reconcileOptionPair(gollvm::options::OPT_fintegrated_as,
+                           gollvm::options::OPT_fno_integrated_as,
+                           true))
+    return false;
+  if (args_.hasArg(gollvm::options::OPT_Wa_COMMA,
+                   gollvm::options::OPT_Xassembler))
+    return false;
+  return true;
+}
+
+// Returns TRUE if Go compile actions produce object files themselves
+// (either native objects via the integrated assembler, or ThinLTO
+// bitcode), meaning that no separate assemble action is needed.
+
+bool Driver::compileEmitsObject()
+{
+  if (args_.hasArg(gollvm::options::OPT_S))
+    return false;
+  return usingThinLTO() || usingIntegratedAssembler();
+}
+
 // Given a pair of llvm::opt options (presumably corresponding to
 // -fXXX and -fno-XXX boolean flags), select the correct value for the
 // option depending on the relative position of the options on the
@@ -322,6 +363,16 @@ ToolChain *Driver::setup()
     exit(0);
   }
 
+  // Only ThinLTO is supported at the moment.
+  if (const opt::Arg *arg = args_.getLastArg(gollvm::options::OPT_flto_EQ)) {
+    if (!llvm::StringRef(arg->getValue()).equals("thin")) {
+      errs() << progname_ << ": error: unsupported argument '"
+             << arg->getValue() << "' to '"
+             << arg->getAsString(args_) << "' option\n";
+      return nullptr;
+    }
+  }
+
   // Check for existence of input files.
   for (opt::Arg *arg : args_) {
     if (arg->getOption().getKind() == opt::Option::InputClass) {
@@ -445,15 +496,22 @@ bool Driver::buildActions(Compilation &compilation)
     compilation.recordAction(gocompact);
     compilation.addAction(gocompact);
 
-    // Schedule assemble action now if no -S.
+    // Schedule assemble action now if no -S. With the integrated
+    // assembler (or with -flto=thin, where code generation is deferred
+    // until link time) the compiler emits the object itself, so there
+    // is no assembly step.
     if (!OPT_S) {
-      // Create action
-      Action *asmact =
-          new Action(Action::A_Assemble, gocompact);
-      compilation.recordAction(asmact);
-      compilation.addAction(asmact);
+      Action *objact = gocompact;
+      if (!compileEmitsObject()) {
+        // Create action
+        Action *asmact =
+            new Action(Action::A_Assemble, gocompact);
+        compilation.recordAction(asmact);
+        compilation.addAction(asmact);
+        objact = asmact;
+      }
       if (!OPT_c)
-        linkerInputActions.push_back(asmact);
+        linkerInputActions.push_back(objact);
     }
   }
 
@@ -522,7 +580,11 @@ bool Driver::processAction(Action *act, Compilation &compilation, bool lastAct)
   // Select the result file for this action.
   Artifact *result = nullptr;
   if (!lastAct) {
-    auto tfa = compilation.createTemporaryFileArtifact(act);
+    // Compile actions may produce objects directly.
+    const char *suffix = nullptr;
+    if (act->type() == Action::A_Compile && compileEmitsObject())
+      suffix = "o";
+    auto tfa = compilation.createTemporaryFileArtifact(act, suffix);
     if (!tfa)
       return false;
     result = *tfa;
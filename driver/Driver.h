@@ -104,6 +104,9 @@ class Driver {
   llvm::PIELevel::Level getPieLevel();
   bool picIsPIE();
   bool isPIE();
+  bool usingThinLTO();
+  bool usingIntegratedAssembler();
+  bool compileEmitsObject();
   template<typename IT>
   llvm::Optional<IT> getLastArgAsInteger(gollvm::options::ID id,
                                          IT defaultValue);
@@ -84,6 +84,26 @@ combineInputsWithEscapes(const std::set<unsigned> &escapes,
   }
 }
 
+// Select the linker to use, honoring -fuse-ld=XXX. Returns the name
+// of the linker as it should appear in argv[0], and stores the
+// resolved path of the linker executable into 'executable'.
+
+static const char *selectLinker(llvm::opt::ArgList &args,
+                                ToolChain &toolchain,
+                                const char **executable)
+{
+  const char *ld = "ld.gold";
+  llvm::opt::Arg *ldarg = args.getLastArg(gollvm::options::OPT_fuse_ld_EQ);
+  if (ldarg != nullptr)
+    ld = ldarg->getValue();
+
+  // Perform program path lookup if needed.
+  *executable = ld;
+  if (!llvm::sys::path::is_absolute(ld))
+    *executable = args.MakeArgString(toolchain.getProgramPath(ld));
+  return ld;
+}
+
 Assembler::Assembler(gollvm::driver::ToolChain &tc)
     : ExternalTool("gnu-assembler", tc)
 {
@@ -119,9 +139,24 @@ bool Assembler::constructCommand(Compilation &compilation,
       break;
   }
 
+  // Collect any supplemental objects produced along with our inputs.
+  // If there are some, the assembler writes to a temporary, which is
+  // then combined with the supplemental objects to form the output.
+  ArtifactList partitions;
+  for (auto &input : jobAction.inputs())
+    for (auto &art : compilation.supplementalOutputs(input))
+      partitions.push_back(art);
+  const Artifact *asOutput = &output;
+  if (!partitions.empty()) {
+    auto tfa = compilation.createTemporaryFileArtifact(&jobAction);
+    if (!tfa)
+      return false;
+    asOutput = *tfa;
+  }
+
   // Output file.
   cmdArgs.push_back("-o");
-  cmdArgs.push_back(output.file());
+  cmdArgs.push_back(asOutput->file());
 
   // Incorporate inputs with -Wa,.. and -Xassembler args, in correct order.
   std::set<unsigned> asFlags;
@@ -149,6 +184,40 @@ bool Assembler::constructCommand(Compilation &compilation,
   compilation.addCommand(jobAction, *this,
                          executable, cmdArgs);
 
+  // If the producer of our input emitted additional objects (ex:
+  // partitions from -fparallel-codegen), combine them with the
+  // assembler output into the final object via a relocatable link.
+  if (!partitions.empty() &&
+      !combinePartitions(compilation, jobAction, *asOutput,
+                         partitions, output))
+    return false;
+
+  return true;
+}
+
+bool Assembler::combinePartitions(Compilation &compilation,
+                                  const Action &jobAction,
+                                  const Artifact &first,
+                                  const ArtifactList &partitions,
+                                  const Artifact &output)
+{
+  llvm::opt::ArgList &args = toolchain().driver().args();
+  llvm::opt::ArgStringList cmdArgs;
+
+  const char *executable = nullptr;
+  cmdArgs.push_back(selectLinker(args, toolchain(), &executable));
+  cmdArgs.push_back("-r");
+  cmdArgs.push_back("-o");
+  cmdArgs.push_back(output.file());
+
+  // Partition order is fixed by the compiler, so the combined
+  // object is deterministic.
+  cmdArgs.push_back(first.file());
+  for (auto &part : partitions)
+    cmdArgs.push_back(part->file());
+  cmdArgs.push_back(nullptr);
+
+  compilation.addCommand(jobAction, *this, executable, cmdArgs);
   return true;
 }
 
@@ -250,6 +319,58 @@ void Linker::addFilePathArgs(llvm::opt::ArgStringList &cmdArgs)
       cmdArgs.push_back(args.MakeArgString(llvm::StringRef("-L") + fp));
 }
 
+// Add the options needed to carry out ThinLTO at link time. For gold
+// (or bfd) this means loading the LLVM gold plugin; lld has LTO
+// support built in. In either case the ThinLTO backends are run in
+// parallel (one job per core unless -flto-jobs=N is specified).
+
+void Linker::addLTOOptions(const char *ld, llvm::opt::ArgStringList &cmdArgs)
+{
+  llvm::opt::ArgList &args = toolchain().driver().args();
+
+  // Backend optimization level: -O0 through -O3 are passed through,
+  // everything else (-Os, -Oz) is treated as -O2.
+  std::string olvl("2");
+  llvm::opt::Arg *oarg = args.getLastArg(gollvm::options::OPT_O_Group);
+  if (oarg != nullptr) {
+    llvm::StringRef lev(oarg->getValue());
+    if (lev.size() == 1 && lev[0] >= '0' && lev[0] <= '3')
+      olvl = lev.str();
+  }
+  llvm::opt::Arg *jarg = args.getLastArg(gollvm::options::OPT_flto_jobs_EQ);
+
+  if (llvm::sys::path::filename(ld).endswith("lld")) {
+    cmdArgs.push_back(args.MakeArgString("--lto-O" + olvl));
+    if (jarg != nullptr)
+      cmdArgs.push_back(args.MakeArgString(llvm::StringRef("--thinlto-jobs=") +
+                                           jarg->getValue()));
+    return;
+  }
+
+  cmdArgs.push_back("-plugin");
+  cmdArgs.push_back(args.MakeArgString(toolchain().getFilePath("LLVMgold.so")));
+  cmdArgs.push_back(args.MakeArgString("-plugin-opt=O" + olvl));
+  cmdArgs.push_back("-plugin-opt=thinlto");
+  if (jarg != nullptr)
+    cmdArgs.push_back(args.MakeArgString(llvm::StringRef("-plugin-opt=jobs=") +
+                                         jarg->getValue()));
+}
+
+// Add the LLVM profile runtime library, which writes out the
+// counters collected by -fprofile-generate code at exit. The "-u"
+// forces the registration hook to be pulled in from the archive.
+
+void Linker::addProfileRuntime(llvm::opt::ArgStringList &cmdArgs)
+{
+  llvm::opt::ArgList &args = toolchain().driver().args();
+  std::string lib("libclang_rt.profile-");
+  lib += toolchain().driver().triple().getArchName();
+  lib += ".a";
+  cmdArgs.push_back("-u");
+  cmdArgs.push_back("__llvm_profile_runtime");
+  cmdArgs.push_back(args.MakeArgString(toolchain().getFilePath(lib.c_str())));
+}
+
 void Linker::addSysLibsStatic(llvm::opt::ArgList &args,
                               llvm::opt::ArgStringList &cmdArgs)
 {
@@ -320,22 +441,18 @@ bool Linker::constructCommand(Compilation &compilation,
   llvm::opt::ArgList &args = compilation.driver().args();
   llvm::opt::ArgStringList cmdArgs;
 
-  // Honor -fuse-ld=XXX
-  const char *executable = "ld.gold";
-  llvm::opt::Arg *ldarg = args.getLastArg(gollvm::options::OPT_fuse_ld_EQ);
-  if (ldarg != nullptr)
-    executable = ldarg->getValue();
-
-  cmdArgs.push_back(executable);
-
-  // Perform program path lookup if needed.
-  if (!llvm::sys::path::is_absolute(executable))
-    executable = args.MakeArgString(toolchain().getProgramPath(executable));
+  const char *executable = nullptr;
+  const char *ld = selectLinker(args, toolchain(), &executable);
+  cmdArgs.push_back(ld);
 
   // Output file.
   cmdArgs.push_back("-o");
   cmdArgs.push_back(output.file());
 
+  // Options for ThinLTO.
+  if (toolchain().driver().usingThinLTO())
+    addLTOOptions(ld, cmdArgs);
+
   // Pass --sysroot to the linker.
   if (!toolchain().driver().sysRoot().empty())
     cmdArgs.push_back(args.MakeArgString(llvm::StringRef("--sysroot=") + toolchain().driver().sysRoot()));
@@ -371,6 +488,11 @@ bool Linker::constructCommand(Compilation &compilation,
   golib += toolchain().driver().installedLibDir();
   cmdArgs.push_back(args.MakeArgString(golib.c_str()));
 
+  // Instrumented code (-fprofile-generate) needs the profile runtime.
+  if (args.hasArg(gollvm::options::OPT_fprofile_generate,
+                  gollvm::options::OPT_fprofile_generate_EQ))
+    addProfileRuntime(cmdArgs);
+
   if (useStdLib) {
 
     // Incorporate linker arguments needed for Go.
@@ -43,6 +43,14 @@ class Assembler : public ExternalTool {
                         const Action &jobAction,
                         const ArtifactList &inputArtifacts,
                         const Artifact &output);
+
+  // Add a command to 'compilation' that combines 'first' and the
+  // objects in 'partitions' into 'output' with a relocatable link.
+  bool combinePartitions(Compilation &compilation,
+                         const Action &jobAction,
+                         const Artifact &first,
+                         const ArtifactList &partitions,
+                         const Artifact &output);
 };
 
 class Linker : public ExternalTool {
@@ -65,6 +73,8 @@ class Linker : public ExternalTool {
                  llvm::opt::ArgStringList &cmdArgs);
   void addSharedAndOrStaticFlags(llvm::opt::ArgStringList &cmdArgs);
   void addFilePathArgs(llvm::opt::ArgStringList &cmdArgs);
+  void addLTOOptions(const char *ld, llvm::opt::ArgStringList &cmdArgs);
+  void addProfileRuntime(llvm::opt::ArgStringList &cmdArgs);
 };
 
 } // end namespace gnutools
@@ -0,0 +1,141 @@
+//===-- SplitStackLeaf.cpp ------------------------------------------------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Gollvm driver helper class SplitStackLeafPass methods.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SplitStackLeaf.h"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace llvm;
+
+namespace gollvm {
+namespace driver {
+
+// Functions with more instructions than this are not considered
+// "small", regardless of their frame size; larger functions are less
+// likely to benefit anyhow.
+static const unsigned kMaxLeafInstructions = 128;
+
+// Number of pointer-sized slots set aside in the frame estimate for
+// the return address, frame pointer and callee-saved registers.
+static const unsigned kFrameReserveSlots = 16;
+
+// Alignment assumed for the incoming stack pointer; allocas with
+// larger alignment may force the frame to be realigned.
+static const unsigned kIncomingStackAlign = 16;
+
+unsigned splitStackLeafBudgetLimit(const Triple &triple)
+{
+  // BACKOFF in libgcc's morestack.S, less the 256 bytes
+  // (kSplitStackAvailable in the X86 frame lowering) that small
+  // split-stack frames are allowed to use below the limit. Only half
+  // of what remains is handed out, as a safety margin: the frame size
+  // is estimated from the IR, before register allocation and frame
+  // lowering have had their say.
+  switch (triple.getArch()) {
+    case Triple::x86_64:
+      return (3584 - 256) / 2;
+    case Triple::x86:
+      return (1024 - 256) / 2;
+    default:
+      return 0;
+  }
+}
+
+// Intrinsics that never turn into calls during code generation.
+
+static bool isNonCallingIntrinsic(const IntrinsicInst &ii)
+{
+  if (isa<DbgInfoIntrinsic>(ii))
+    return true;
+  switch (ii.getIntrinsicID()) {
+    case Intrinsic::lifetime_start:
+    case Intrinsic::lifetime_end:
+    case Intrinsic::assume:
+    case Intrinsic::expect:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The frame estimate is meant to be an upper bound: besides the
+// allocas themselves (plus any padding needed to realign them), each
+// value computed by the function is assumed to need its own spill
+// slot, and a fixed number of slots is reserved for the return address
+// and saved registers.
+
+bool SplitStackLeafPass::isEligible(const Function &f) const
+{
+  if (f.isDeclaration() || !f.hasFnAttribute("split-stack"))
+    return false;
+  if (f.getInstructionCount() > kMaxLeafInstructions)
+    return false;
+
+  const DataLayout &dl = f.getParent()->getDataLayout();
+  uint64_t slotSize = dl.getPointerSize();
+  uint64_t frameSize = kFrameReserveSlots * slotSize;
+  for (const BasicBlock &bb : f) {
+    for (const Instruction &inst : bb) {
+      if (const AllocaInst *ai = dyn_cast<AllocaInst>(&inst)) {
+        if (!ai->isStaticAlloca())
+          return false;
+        uint64_t count =
+            cast<ConstantInt>(ai->getArraySize())->getZExtValue();
+        uint64_t size = dl.getTypeAllocSize(ai->getAllocatedType()) * count;
+        uint64_t align = std::max<uint64_t>(ai->getAlignment(), 1);
+        if (align > kIncomingStackAlign)
+          frameSize += align - kIncomingStackAlign;
+        frameSize = alignTo(frameSize, align);
+        frameSize += size;
+      } else {
+        if (isa<InvokeInst>(&inst))
+          return false;
+        if (const CallInst *call = dyn_cast<CallInst>(&inst)) {
+          const IntrinsicInst *ii = dyn_cast<IntrinsicInst>(call);
+          if (!ii || !isNonCallingIntrinsic(*ii))
+            return false;
+        }
+        Type *vt = inst.getType();
+        if (!vt->isVoidTy() && vt->isSized())
+          frameSize += alignTo(dl.getTypeAllocSize(vt), slotSize);
+      }
+      if (frameSize > budget_)
+        return false;
+    }
+  }
+  return true;
+}
+
+PreservedAnalyses SplitStackLeafPass::run(Module &m,
+                                          ModuleAnalysisManager &mam)
+{
+  if (budget_ == 0)
+    return PreservedAnalyses::all();
+  bool changed = false;
+  for (Function &f : m) {
+    if (!isEligible(f))
+      continue;
+    f.removeFnAttr("split-stack");
+    changed = true;
+  }
+  return (changed ? PreservedAnalyses::none() : PreservedAnalyses::all());
+}
+
+} // end namespace driver
+} // end namespace gollvm
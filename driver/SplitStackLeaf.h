@@ -0,0 +1,70 @@
+//===-- SplitStackLeaf.h --------------------------------------------------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the SplitStackLeafPass class (helper for driver functionality).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GOLLVM_DRIVER_SPLITSTACKLEAF_H
+#define GOLLVM_DRIVER_SPLITSTACKLEAF_H
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+class Function;
+class Triple;
+}
+
+namespace gollvm {
+namespace driver {
+
+// Default stack budget (in bytes) for -fgo-split-stack-leaf-budget.
+#define GOLLVM_SPLIT_STACK_LEAF_BUDGET_DEFAULT 256
+
+// Returns the largest leaf frame (in bytes) that can safely run
+// without a split-stack check on the specified target, or zero if
+// prologue elision isn't supported there.
+//
+// Split-stack code runs with the stack limit placed some distance
+// above the true end of each stack segment: libgo's __morestack
+// leaves a BACKOFF area below the limit (3584 bytes on x86_64, 1024
+// on 386), part of which (256 bytes) is already used by the
+// prologues of small split-stack frames, which compare the stack
+// pointer against the limit before allocating the frame. Half of
+// what is left over is made available to frames that skip the check
+// entirely; the other half is kept as a safety margin for errors in
+// the frame size estimate.
+unsigned splitStackLeafBudgetLimit(const llvm::Triple &triple);
+
+// Module pass that removes the "split-stack" attribute (and with it
+// the __morestack check in the prologue) from small leaf functions,
+// i.e. functions that make no calls and whose estimated frame size
+// (a conservative guess made from the IR, see isEligible) fits within
+// 'budget' bytes. This is intended to be run after the
+// optimization pipeline, once inlining has settled which functions
+// are leaves. Elided functions are treated by the code generator and
+// linker the same way as //go:nosplit functions.
+
+class SplitStackLeafPass : public llvm::PassInfoMixin<SplitStackLeafPass> {
+ public:
+  explicit SplitStackLeafPass(unsigned budget) : budget_(budget) { }
+
+  llvm::PreservedAnalyses run(llvm::Module &m,
+                              llvm::ModuleAnalysisManager &mam);
+
+  // Returns true if the prologue check for 'f' can be elided.
+  bool isEligible(const llvm::Function &f) const;
+
+ private:
+  unsigned budget_;
+};
+
+} // end namespace driver
+} // end namespace gollvm
+
+#endif // GOLLVM_DRIVER_SPLITSTACKLEAF_H
@@ -0,0 +1,111 @@
+#!/bin/sh
+#
+# Round-trip test for the compile server (llvm-goc --compile-server).
+# Starts a server, then compiles the same file twice with
+# GOLLVM_COMPILE_SERVER pointing at it. The first compile reads its
+# imports from disk and reports them back to the server, which
+# preloads them; the second compile (forked from the server) should
+# then find all of its imports in the export data cache. Command line
+# is expected to look like
+#
+#  compileservertest.sh \
+#     WORKDIR <value> \
+#     SRC <file> \
+#     GOC <path> \
+#     LIBDIR <dir> \
+#     LOGFILE <file>
+#
+# where:
+#
+#   WORKDIR    names the work directory in which the test should be run
+#   SRC        is the Go source file to compile
+#   GOC        is the path to the llvm-goc binary (not a wrapper script,
+#              since the server checks that clients run the same binary)
+#   LIBDIR     is the root of the libgo build to import packages from
+#   LOGFILE    is a file into which compiler stderr should be written
+#
+
+CUR=""
+for ARG in $*
+do
+  case "$ARG" in
+    GOC) CUR=GOC ;;
+    LIBDIR) CUR=LIBDIR ;;
+    LOGFILE) CUR=LOGFILE ;;
+    SRC) CUR=SRC ;;
+    WORKDIR) CUR=WORKDIR ;;
+    *) if [ -z "${CUR}" ]; then
+         echo "unexpected stray argument $ARG"
+         exit 1
+       fi
+       eval "$CUR=\$ARG"
+       ;;
+  esac
+done
+REQUIRED="GOC LIBDIR LOGFILE SRC WORKDIR"
+for R in $REQUIRED
+do
+  eval "V=\$$R"
+  if [ -z "$V" ]; then
+    echo "error: no setting for \"$R\" supplied on command line"
+    exit 1
+  fi
+done
+#
+rm -rf $WORKDIR
+mkdir $WORKDIR
+if [ $? != 0 ]; then
+  echo "can't create $WORKDIR"
+  exit 1
+fi
+cp $SRC $WORKDIR
+cd $WORKDIR
+SRCBASE=`basename $SRC`
+SOCK=`pwd`/server.sock
+rm -f $LOGFILE
+#
+# Start the server and wait for its socket to show up.
+#
+$GOC --compile-server=$SOCK 2>> $LOGFILE &
+SERVER=$!
+trap "kill $SERVER 2> /dev/null" 0
+TRIES=0
+while [ ! -S $SOCK ]; do
+  TRIES=`expr $TRIES + 1`
+  if [ $TRIES -gt 30 ]; then
+    echo "compile server did not start (see $LOGFILE)"
+    exit 1
+  fi
+  sleep 1
+done
+#
+# Compile twice through the server. The export data cache statistics
+# are printed at -tracelevel=1.
+#
+export GOLLVM_COMPILE_SERVER=$SOCK
+for N in 1 2
+do
+  $GOC -c -tracelevel=1 -I $LIBDIR -o out$N.o $SRCBASE 2> trace$N
+  if [ $? != 0 ]; then
+    echo "compile $N failed (see $LOGFILE)"
+    cat trace$N >> $LOGFILE
+    exit 1
+  fi
+  grep "^export data cache:" trace$N > stats$N
+  echo "compile $N: `cat stats$N`" >> $LOGFILE
+done
+#
+# The first compile has to read its imports; the second should find
+# every one of them already cached (a compile run locally, because the
+# server couldn't take it, would have to read them again).
+#
+if ! grep -q "misses=[1-9]" stats1; then
+  echo "first compile did not read any export data: `cat stats1`"
+  exit 1
+fi
+if ! grep -q "hits=[1-9][0-9]* misses=0\$" stats2; then
+  echo "second compile missed the export data cache: `cat stats2`"
+  exit 1
+fi
+echo "compile server round trip OK: `cat stats2`"
+exit 0
@@ -0,0 +1,100 @@
+#!/bin/sh
+#
+# Check for -fgo-dual-pic-output. Compiles a file once with
+# -fgo-dual-pic-output, and again separately without and with -fPIC;
+# the two objects from the dual compile should match those from the
+# separate compiles byte for byte. This is done both with and without
+# parallel code generation. Command line is expected to look like
+#
+#  dualpictest.sh \
+#     WORKDIR <value> \
+#     SRC <file> \
+#     GOC <path> \
+#     LIBDIR <dir> \
+#     LOGFILE <file>
+#
+# where:
+#
+#   WORKDIR    names the work directory in which the test should be run
+#   SRC        is the Go source file to compile
+#   GOC        is the path to the llvm-goc binary
+#   LIBDIR     is the root of the libgo build to import packages from
+#   LOGFILE    is a file into which compiler stderr should be written
+#
+
+CUR=""
+for ARG in $*
+do
+  case "$ARG" in
+    GOC) CUR=GOC ;;
+    LIBDIR) CUR=LIBDIR ;;
+    LOGFILE) CUR=LOGFILE ;;
+    SRC) CUR=SRC ;;
+    WORKDIR) CUR=WORKDIR ;;
+    *) if [ -z "${CUR}" ]; then
+         echo "unexpected stray argument $ARG"
+         exit 1
+       fi
+       eval "$CUR=\$ARG"
+       ;;
+  esac
+done
+REQUIRED="GOC LIBDIR LOGFILE SRC WORKDIR"
+for R in $REQUIRED
+do
+  eval "V=\$$R"
+  if [ -z "$V" ]; then
+    echo "error: no setting for \"$R\" supplied on command line"
+    exit 1
+  fi
+done
+#
+rm -rf $WORKDIR
+mkdir $WORKDIR
+if [ $? != 0 ]; then
+  echo "can't create $WORKDIR"
+  exit 1
+fi
+cp $SRC $WORKDIR
+cd $WORKDIR
+SRCBASE=`basename $SRC`
+rm -f $LOGFILE
+#
+compile() {
+  echo "$GOC -c -O2 -I $LIBDIR $* $SRCBASE" >> $LOGFILE
+  $GOC -c -O2 -I $LIBDIR "$@" $SRCBASE 2>> $LOGFILE
+  if [ $? != 0 ]; then
+    echo "compile failed: $* (see $LOGFILE)"
+    exit 1
+  fi
+}
+#
+# Report a mismatch, with a disassembly diff in the log if objdump is
+# around to produce one.
+#
+mismatch() {
+  echo "$1 differs from $2 (see $LOGFILE)"
+  cmp $1 $2 >> $LOGFILE 2>&1
+  if objdump --version > /dev/null 2>&1; then
+    objdump -d -r -t $1 | grep -v "file format" > $1.dis
+    objdump -d -r -t $2 | grep -v "file format" > $2.dis
+    diff $1.dis $2.dis >> $LOGFILE
+  fi
+  exit 1
+}
+#
+for PCG in 1 4
+do
+  compile -fparallel-codegen=$PCG -o dual$PCG.o \
+    -fgo-dual-pic-output=dual$PCG-pic.o
+  compile -fparallel-codegen=$PCG -o nopic$PCG.o
+  compile -fparallel-codegen=$PCG -fPIC -o pic$PCG.o
+  cmp -s dual$PCG.o nopic$PCG.o || mismatch dual$PCG.o nopic$PCG.o
+  cmp -s dual$PCG-pic.o pic$PCG.o || mismatch dual$PCG-pic.o pic$PCG.o
+  if cmp -s pic$PCG.o nopic$PCG.o; then
+    echo "-fPIC made no difference to the object (-fparallel-codegen=$PCG)"
+    exit 1
+  fi
+done
+echo "dual PIC output matches separate compiles"
+exit 0
@@ -0,0 +1,112 @@
+#!/bin/sh
+#
+# Code generation check for split-stack prologue elision
+# (-fgo-split-stack-leaf-budget). Compiles the split-stack torture
+# test to assembly and checks that the small leaf function leafSmall
+# has no __morestack call, that the over-budget leaf leafBig keeps
+# one, and that leafSmall keeps one when elision is disabled. Command
+# line is expected to look like
+#
+#  splitstackleafcheck.sh \
+#     WORKDIR <value> \
+#     SRC <file> \
+#     GOC <path> \
+#     LIBDIR <dir> \
+#     LOGFILE <file>
+#
+# where:
+#
+#   WORKDIR    names the work directory in which the test should be run
+#   SRC        is the Go source file to compile
+#   GOC        is the path to the llvm-goc binary
+#   LIBDIR     is the root of the libgo build to import packages from
+#   LOGFILE    is a file into which compiler stderr should be written
+#
+
+CUR=""
+for ARG in $*
+do
+  case "$ARG" in
+    GOC) CUR=GOC ;;
+    LIBDIR) CUR=LIBDIR ;;
+    LOGFILE) CUR=LOGFILE ;;
+    SRC) CUR=SRC ;;
+    WORKDIR) CUR=WORKDIR ;;
+    *) if [ -z "${CUR}" ]; then
+         echo "unexpected stray argument $ARG"
+         exit 1
+       fi
+       eval "$CUR=\$ARG"
+       ;;
+  esac
+done
+REQUIRED="GOC LIBDIR LOGFILE SRC WORKDIR"
+for R in $REQUIRED
+do
+  eval "V=\$$R"
+  if [ -z "$V" ]; then
+    echo "error: no setting for \"$R\" supplied on command line"
+    exit 1
+  fi
+done
+#
+rm -rf $WORKDIR
+mkdir $WORKDIR
+if [ $? != 0 ]; then
+  echo "can't create $WORKDIR"
+  exit 1
+fi
+cp $SRC $WORKDIR
+cd $WORKDIR
+SRCBASE=`basename $SRC`
+rm -f $LOGFILE
+#
+# Compile to assembly with the specified leaf budget.
+#
+compile() {
+  $GOC -S -O2 -I $LIBDIR -fgo-split-stack-leaf-budget=$1 \
+    -o $2 $SRCBASE 2>> $LOGFILE
+  if [ $? != 0 ]; then
+    echo "compile with budget $1 failed (see $LOGFILE)"
+    exit 1
+  fi
+}
+#
+# Print the body of the named function (from its label up to the end
+# of function marker).
+#
+body() {
+  awk -v label="splitstack.$1:" '
+    $1 == label { infunc = 1; found = 1 }
+    infunc && /^\.Lfunc_end/ { exit }
+    infunc { print }
+    END { if (!found) exit 1 }' $2
+}
+#
+# Check that function $1 in $2 does (yes) or doesn't (no) call
+# __morestack.
+#
+check() {
+  if ! body $1 $2 > $1.s; then
+    echo "function $1 not found in $2"
+    exit 1
+  fi
+  if grep -q __morestack $1.s; then
+    HAS=yes
+  else
+    HAS=no
+  fi
+  echo "$2: $1 calls __morestack: $HAS" >> $LOGFILE
+  if [ $HAS != $3 ]; then
+    echo "$2: expected __morestack call in $1: $3, got: $HAS"
+    exit 1
+  fi
+}
+#
+compile 1000000 elided.s
+compile 0 full.s
+check leafSmall elided.s no
+check leafBig elided.s yes
+check leafSmall full.s yes
+echo "split-stack leaf elision check OK"
+exit 0
@@ -0,0 +1,72 @@
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Input for the -fgo-dual-pic-output check: code whose PIC and non-PIC
+// forms differ (references to global data and functions, within the
+// package and in other packages, function values, interface tables
+// and type descriptors), to be compared against separate compiles.
+
+package dualpic
+
+import (
+	"fmt"
+	"sort"
+	"strings"
+	"sync"
+)
+
+var (
+	mu      sync.Mutex
+	counts  = map[string]int{}
+	total   int
+	handler = defaultHandler
+)
+
+type Shape interface {
+	Area() float64
+	Name() string
+}
+
+type Rect struct{ W, H float64 }
+type Circle struct{ R float64 }
+
+func (r Rect) Area() float64   { return r.W * r.H }
+func (r Rect) Name() string    { return "rect" }
+func (c Circle) Area() float64 { return 3.14159 * c.R * c.R }
+func (c Circle) Name() string  { return "circle" }
+
+func defaultHandler(s string) string { return strings.ToUpper(s) }
+
+// SetHandler replaces the function applied by Record.
+func SetHandler(f func(string) string) { handler = f }
+
+// Record counts a name, after passing it through the handler.
+func Record(name string) {
+	mu.Lock()
+	defer mu.Unlock()
+	counts[handler(name)]++
+	total++
+}
+
+// Summary describes the shapes and the names recorded so far.
+func Summary(shapes []Shape) string {
+	var b strings.Builder
+	for _, s := range shapes {
+		Record(s.Name())
+		fmt.Fprintf(&b, "%s:%.2f ", s.Name(), s.Area())
+	}
+	mu.Lock()
+	names := make([]string, 0, len(counts))
+	for n := range counts {
+		names = append(names, n)
+	}
+	mu.Unlock()
+	sort.Strings(names)
+	return b.String() + strings.Join(names, ",") + fmt.Sprint(total)
+}
+
+// Shapes returns one of each kind of shape.
+func Shapes() []Shape {
+	return []Shape{Rect{2, 3}, Circle{1}, &Rect{1, 1}}
+}
@@ -0,0 +1,32 @@
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// An external test package, so that the package has to be imported
+// through the export data in its combined object.
+
+package parallelcodegen_test
+
+import (
+	"reflect"
+	"testing"
+
+	p "parallelcodegen"
+)
+
+func TestImported(t *testing.T) {
+	shapes := []p.Shape{p.Rect{2, 3}, p.Square{4}, p.Tri{6, 2}}
+	if got := p.TotalArea(shapes...); got != 28 {
+		t.Errorf("TotalArea = %g, want 28", got)
+	}
+	want := []string{"rect 2x3", "square 4", "tri 6x2"}
+	if got := p.Describe(shapes...); !reflect.DeepEqual(got, want) {
+		t.Errorf("Describe = %q, want %q", got, want)
+	}
+	if got := p.Adder(10)(7); got != 22 {
+		t.Errorf("Adder(10)(7) = %d, want 22", got)
+	}
+	if got := p.Fib(20); got != 6765 {
+		t.Errorf("Fib(20) = %d, want 6765", got)
+	}
+}
@@ -0,0 +1,78 @@
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Package parallelcodegen is built with -fparallel-codegen, which
+// spreads its functions over several code generation partitions that
+// are then linked into a single object. Functions call each other,
+// share package-level data and are reached through method values and
+// interfaces, so that references between partitions have to be
+// resolved when the partitions are combined.
+package parallelcodegen
+
+import "fmt"
+
+// Table is package-level data shared by functions in all partitions.
+var Table = [...]uint64{3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9}
+
+var counter int
+
+type Shape interface {
+	Area() float64
+	Name() string
+}
+
+type Rect struct{ W, H float64 }
+type Square struct{ S float64 }
+type Tri struct{ B, H float64 }
+
+func (r Rect) Area() float64   { return r.W * r.H }
+func (r Rect) Name() string    { return fmt.Sprintf("rect %gx%g", r.W, r.H) }
+func (s Square) Area() float64 { return Rect{s.S, s.S}.Area() }
+func (s Square) Name() string  { return fmt.Sprintf("square %g", s.S) }
+func (t Tri) Area() float64    { return Rect{t.B, t.H}.Area() / 2 }
+func (t Tri) Name() string     { return fmt.Sprintf("tri %gx%g", t.B, t.H) }
+
+func TotalArea(shapes ...Shape) float64 {
+	var sum float64
+	for _, s := range shapes {
+		sum += s.Area()
+	}
+	return sum
+}
+
+func mix(x uint64) uint64 {
+	counter++
+	return x*0x9e3779b97f4a7c15 + Table[x%uint64(len(Table))]
+}
+
+func Fold(n int) uint64 {
+	var h uint64
+	for i := 0; i < n; i++ {
+		h = mix(h ^ uint64(i))
+	}
+	return h
+}
+
+func Fib(n int) int {
+	if n < 2 {
+		return n
+	}
+	return Fib(n-1) + Fib(n-2)
+}
+
+func Counter() int { return counter }
+
+// Adder returns a closure, whose body may land in a different
+// partition than the function that creates it.
+func Adder(base int) func(int) int {
+	return func(x int) int { return base + x + Fib(5) }
+}
+
+func Describe(shapes ...Shape) []string {
+	var names []string
+	for _, s := range shapes {
+		names = append(names, s.Name())
+	}
+	return names
+}
@@ -0,0 +1,22 @@
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+package parallelcodegen
+
+import "testing"
+
+func TestFold(t *testing.T) {
+	var want uint64
+	for i := 0; i < 100; i++ {
+		want = want ^ uint64(i)
+		want = want*0x9e3779b97f4a7c15 + Table[want%uint64(len(Table))]
+	}
+	before := Counter()
+	if got := Fold(100); got != want {
+		t.Errorf("Fold(100) = %#x, want %#x", got, want)
+	}
+	if n := Counter() - before; n != 100 {
+		t.Errorf("mix called %d times, want 100", n)
+	}
+}
@@ -0,0 +1,140 @@
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Stack overflow torture test for split-stack prologue elision
+// (-fgo-split-stack-leaf-budget). Small leaf functions, which run
+// without a stack check once elided, are called at every depth of a
+// recursion whose frames vary in size, from many goroutines at once,
+// so that they run at all sorts of distances from the end of a stack
+// segment. A leaf frame that overruns the guard area below the stack
+// limit shows up as a crash or as corrupted results.
+
+package splitstack
+
+import (
+	"sync"
+	"testing"
+)
+
+//go:noinline
+func leafSmall(x uint64) uint64 {
+	return x*0x9e3779b97f4a7c15 + 1
+}
+
+// Lots of values live at once, to encourage register spills.
+//
+//go:noinline
+func leafSpilly(a, b, c, d uint64) uint64 {
+	e, f, g, h := a^b, b^c, c^d, d^a
+	i, j, k, l := a+e, b+f, c+g, d+h
+	m, n, o, p := e*i, f*j, g*k, h*l
+	q, r, s, t := m-a, n-b, o-c, p-d
+	return (a + b + c + d) ^ (e + f + g + h) ^ (i + j + k + l) ^
+		(m + n + o + p) ^ (q*r + s*t) ^ (q*t + r*s)
+}
+
+// A local array that stays on the stack.
+//
+//go:noinline
+func leafArray(x uint64) uint64 {
+	var a [24]uint64
+	for i := range a {
+		a[i] = x + uint64(i)*x
+	}
+	var sum uint64
+	for i := range a {
+		sum = sum*31 + a[i]
+	}
+	return sum
+}
+
+// A leaf whose frame is over any budget the driver allows, so it keeps
+// its split-stack check (the check target verifies this in the
+// generated code).
+//
+//go:noinline
+func leafBig(x uint64) uint64 {
+	var a [512]uint64
+	for i := range a {
+		a[i] = x ^ uint64(i)
+	}
+	return a[x%512] + a[(x>>9)%512]
+}
+
+func leaves(x uint64) uint64 {
+	return leafSmall(x) ^ leafSpilly(x, x+1, x+2, x+3) ^ leafArray(x) ^
+		leafBig(x)
+}
+
+// Non-leaf frames of a few different sizes, used to shift the stack
+// pointer around between leaf calls.
+
+//go:noinline
+func pad8(n int, x uint64) uint64 {
+	var b [8]byte
+	b[n&7] = byte(x)
+	return descend(n-1, x+uint64(b[n&7])) + leaves(x)
+}
+
+//go:noinline
+func pad40(n int, x uint64) uint64 {
+	var b [40]byte
+	b[n%40] = byte(x)
+	return descend(n-1, x+uint64(b[n%40])) + leaves(x)
+}
+
+//go:noinline
+func pad200(n int, x uint64) uint64 {
+	var b [200]byte
+	b[n%200] = byte(x)
+	return descend(n-1, x+uint64(b[n%200])) + leaves(x)
+}
+
+func descend(n int, x uint64) uint64 {
+	if n <= 0 {
+		return leaves(x)
+	}
+	switch n % 3 {
+	case 0:
+		return pad8(n, x)
+	case 1:
+		return pad40(n, x)
+	default:
+		return pad200(n, x)
+	}
+}
+
+func TestLeafStackOverflow(t *testing.T) {
+	const maxDepth = 600
+	const goroutines = 16
+
+	// Expected results, computed on a single goroutine.
+	want := make([]uint64, maxDepth)
+	for d := range want {
+		want[d] = descend(d, uint64(d))
+	}
+
+	var wg sync.WaitGroup
+	errs := make(chan string, goroutines)
+	for g := 0; g < goroutines; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			// Each goroutine walks the depths in a different
+			// order, starting out on a fresh (small) stack.
+			for i := 0; i < maxDepth; i++ {
+				d := (i*7 + g*13) % maxDepth
+				if got := descend(d, uint64(d)); got != want[d] {
+					errs <- "wrong result"
+					return
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+	close(errs)
+	for e := range errs {
+		t.Fatal(e)
+	}
+}
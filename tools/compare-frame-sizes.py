@@ -0,0 +1,165 @@
+#!/usr/bin/python
+"""Compare per-function stack frame sizes between two builds.
+
+This script disassembles the objects from two builds of the same code
+(for example libgo built before and after a change to the bridge) and
+compares the stack frame size of each function, as given by the stack
+pointer adjustment in its prologue. It is intended for evaluating
+changes that affect frame layout, such as the emission of lifetime
+markers (which let stack coloring overlap disjoint locals).
+
+Usage:
+
+   compare-frame-sizes.py [options] <before> <after>
+
+where <before> and <after> are object files, archives, or directories
+(searched recursively for *.o and *.a files). Only x86_64 and 386
+objects are supported; frame size is taken from the first
+"sub $N,%rsp" (or %esp) found near the start of each function, so
+pushes of callee-saved registers are not counted.
+
+"""
+
+import getopt
+import os
+import re
+import sys
+
+import script_utils as u
+
+# Disassembler to use
+flag_objdump = "llvm-objdump"
+
+# Number of largest changes to report
+flag_top = 20
+
+# How far into a function to look for the prologue stack adjustment
+max_prologue_insns = 24
+
+# Frames larger than this need the slower __morestack prologue
+# sequence on x86 (see kSplitStackAvailable in the X86 frame lowering).
+small_frame_limit = 256
+
+funcre = re.compile(r"^[0-9a-f]+ <(\S+)>:$")
+subre = re.compile(r"^\s*[0-9a-f]+:\s+sub[lq]?\s+"
+                   r"\$(0x[0-9a-f]+|\d+),\s*%[re]sp\b")
+insnre = re.compile(r"^\s*[0-9a-f]+:\s+\S")
+
+
+def collect_objects(path):
+  """Return list of object files/archives at or under path."""
+  if not os.path.exists(path):
+    u.error("%s does not exist" % path)
+  if not os.path.isdir(path):
+    return [path]
+  objs = []
+  for root, _, files in os.walk(path):
+    for f in files:
+      if f.endswith(".o") or f.endswith(".a"):
+        objs.append(os.path.join(root, f))
+  return sorted(objs)
+
+
+def frame_sizes(path):
+  """Return dict mapping function name to frame size for objects in path."""
+  sizes = {}
+  for obj in collect_objects(path):
+    lines = u.docmdlines("%s -d --no-show-raw-insn %s" % (flag_objdump, obj),
+                         True)
+    if lines is None:
+      u.warning("can't disassemble %s, skipping" % obj)
+      continue
+    fn = None
+    ninsns = 0
+    for line in lines:
+      m = funcre.match(line)
+      if m:
+        fn = m.group(1)
+        ninsns = 0
+        sizes[fn] = max(sizes.get(fn, 0), 0)
+        continue
+      if fn is None or ninsns >= max_prologue_insns:
+        continue
+      if not insnre.match(line):
+        continue
+      ninsns += 1
+      m = subre.match(line)
+      if m:
+        sizes[fn] = max(sizes[fn], int(m.group(1), 0))
+        ninsns = max_prologue_insns
+  u.verbose(1, "%d functions found in %s" % (len(sizes), path))
+  return sizes
+
+
+def report(before, after):
+  """Print summary comparing the two sets of frame sizes."""
+  common = sorted(set(before) & set(after))
+  if not common:
+    u.error("no functions in common between the two builds")
+  tb = sum(before[f] for f in common)
+  ta = sum(after[f] for f in common)
+  deltas = [(after[f] - before[f], f) for f in common]
+  grew = [d for d in deltas if d[0] > 0]
+  shrank = [d for d in deltas if d[0] < 0]
+  bigb = len([f for f in common if before[f] > small_frame_limit])
+  biga = len([f for f in common if after[f] > small_frame_limit])
+
+  w = sys.stdout.write
+  w("functions compared:     %d (%d only in before, %d only in after)\n" %
+    (len(common), len(before) - len(common), len(after) - len(common)))
+  w("total frame bytes:      %d -> %d (%+d, %+.1f%%)\n" %
+    (tb, ta, ta - tb, (100.0 * (ta - tb) / tb) if tb else 0.0))
+  w("frames grown/shrunk:    %d / %d\n" % (len(grew), len(shrank)))
+  w("frames > %d bytes:     %d -> %d\n" % (small_frame_limit, bigb, biga))
+  if shrank:
+    w("\nlargest reductions:\n")
+    for d, f in sorted(shrank)[:flag_top]:
+      w("  %8d  %6d -> %6d  %s\n" % (d, before[f], after[f], f))
+  if grew:
+    w("\nlargest increases:\n")
+    for d, f in sorted(grew, reverse=True)[:flag_top]:
+      w("  %+8d  %6d -> %6d  %s\n" % (d, before[f], after[f], f))
+
+
+def usage(msgarg):
+  """Print usage and exit."""
+  if msgarg:
+    sys.stderr.write("error: %s\n" % msgarg)
+  sys.stderr.write("""\
+    usage:  %s [options] <before> <after>
+
+    options:
+    -d          increase debug msg verbosity level
+    -o X        use X as the disassembler (default: llvm-objdump)
+    -t N        report the N largest changes in each direction
+
+""" % os.path.basename(sys.argv[0]))
+  sys.exit(1)
+
+
+def parse_args():
+  """Command line option parsing."""
+  global flag_objdump, flag_top
+
+  try:
+    optlist, args = getopt.getopt(sys.argv[1:], "do:t:")
+  except getopt.GetoptError as err:
+    # unrecognized option
+    usage(str(err))
+
+  for opt, arg in optlist:
+    if opt == "-d":
+      u.increment_verbosity()
+    elif opt == "-o":
+      flag_objdump = arg
+    elif opt == "-t":
+      flag_top = int(arg)
+  if len(args) != 2:
+    usage("specify before and after builds")
+  return args
+
+
+# Setup
+u.setdeflanglocale()
+bpath, apath = parse_args()
+report(frame_sizes(bpath), frame_sizes(apath))
@@ -13,6 +13,9 @@
 #include "llvm/IR/Function.h"
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <chrono>
+
 using namespace llvm;
 using namespace goBackendUnitTests;
 
@@ -380,7 +383,7 @@ TEST(BackendCABIOracleTests, PassAndReturnArrays) {
   const char *exp = R"RAW_RESULT(
     %cast.0 = bitcast [2 x float]* %p0.addr to <2 x float>*
     %ld.0 = load <2 x float>, <2 x float>* %cast.0
-    call void @foo([3 x double]* sret %sret.actual.0, i8* nest undef, <2 x float> %ld.0)
+    call void @foo([3 x double]* nonnull sret align 8 dereferenceable(24) %sret.actual.0, i8* nest undef, <2 x float> %ld.0)
     %cast.1 = bitcast [3 x double]* %sret.formal.0 to i8*
     %cast.2 = bitcast [3 x double]* %sret.actual.0 to i8*
     call void @llvm.memcpy.p0i8.p0i8.i64(i8* align 8 %cast.1, i8* align 8 %cast.2, i64 24, i1 false)
@@ -541,4 +544,133 @@ TEST(BackendCABIOracleTests, PassAndReturnComplex) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendCABIOracleTests, OracleCache) {
+  FcnTestHarness h;
+  Llvm_backend *be = h.be();
+  TypeManager *tm = be->typeManager();
+
+  // func foo(x s1, y s2, z s3) s2, where the struct params have to be
+  // exploded into eightbytes by the oracle.
+  Btype *bf32t = be->float_type(32);
+  Btype *bf64t = be->float_type(64);
+  Btype *bi16t = be->integer_type(false, 16);
+  Btype *s1 = mkBackendStruct(be, bf32t, "f1", bf32t, "f2",
+                              bi16t, "i1", bi16t, "i2", bi16t, "i3", nullptr);
+  Btype *s2 = mkBackendStruct(be, bf64t, "k", bf32t, "f1", bf32t, "f2",
+                              nullptr);
+  Btype *s3 = mkBackendStruct(be, s1, "f1", s2, "f2", nullptr);
+  BFunctionType *befty = mkFuncTyp(be,
+                                   L_PARM, s1,
+                                   L_PARM, s2,
+                                   L_PARM, s3,
+                                   L_RES, s2,
+                                   L_END);
+  Bfunction *func = h.mkFunction("foo", befty);
+
+  // The oracle computed for the function is the one handed out for
+  // every later query on the same type.
+  const CABIOracle *oracle = tm->abiOracle(befty);
+  EXPECT_EQ(oracle, tm->abiOracle(befty));
+
+  // Lower a batch of calls to foo; all of them share that oracle.
+  Location loc;
+  const unsigned numCalls = 100;
+  for (unsigned i = 0; i < numCalls; ++i) {
+    Bexpression *fn = be->function_code_expression(func, loc);
+    std::vector<Bexpression *> args;
+    for (unsigned pidx = 0; pidx < 3; ++pidx)
+      args.push_back(be->var_expression(func->getNthParamVar(pidx), loc));
+    Bexpression *call = be->call_expression(func, fn, args, nullptr, loc);
+    h.mkExprStmt(call);
+  }
+  EXPECT_EQ(oracle, tm->abiOracle(befty));
+  EXPECT_EQ(oracle->toString(), CABIOracle(befty, tm).toString());
+
+  // A different function type gets an oracle of its own.
+  BFunctionType *befty2 = mkFuncTyp(be, L_PARM, s2, L_RES, s1, L_END);
+  const CABIOracle *oracle2 = tm->abiOracle(befty2);
+  EXPECT_NE(oracle, oracle2);
+  EXPECT_EQ(oracle2, tm->abiOracle(befty2));
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
+TEST(BackendCABIOracleTests, OracleCacheBenchmark) {
+  FcnTestHarness h;
+  Llvm_backend *be = h.be();
+  TypeManager *tm = be->typeManager();
+
+  // Same signature as in OracleCache above.
+  Btype *bf32t = be->float_type(32);
+  Btype *bf64t = be->float_type(64);
+  Btype *bi16t = be->integer_type(false, 16);
+  Btype *s1 = mkBackendStruct(be, bf32t, "f1", bf32t, "f2",
+                              bi16t, "i1", bi16t, "i2", bi16t, "i3", nullptr);
+  Btype *s2 = mkBackendStruct(be, bf64t, "k", bf32t, "f1", bf32t, "f2",
+                              nullptr);
+  Btype *s3 = mkBackendStruct(be, s1, "f1", s2, "f2", nullptr);
+  BFunctionType *befty = mkFuncTyp(be,
+                                   L_PARM, s1,
+                                   L_PARM, s2,
+                                   L_PARM, s3,
+                                   L_RES, s2,
+                                   L_END);
+  Bfunction *func = h.mkFunction("foo", befty);
+  const CABIOracle *oracle = tm->abiOracle(befty);
+  Location loc;
+
+  typedef std::chrono::steady_clock clock;
+  auto nsSince = [](clock::time_point t0) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock::now() - t0).count();
+  };
+
+  // Per-call cost of the ABI analysis: what each call site used to pay
+  // (a fresh oracle) versus a cache lookup. Each is the best of a few
+  // rounds, so that a stray context switch doesn't skew the result.
+  const unsigned iters = 5000;
+  const unsigned rounds = 5;
+  long long uncachedNs = -1, cachedNs = -1;
+  unsigned slots = 0;
+  for (unsigned r = 0; r < rounds; ++r) {
+    clock::time_point t0 = clock::now();
+    for (unsigned i = 0; i < iters; ++i) {
+      CABIOracle fresh(befty, tm);
+      slots += fresh.paramInfo(2).numArgSlots();
+    }
+    long long ns = nsSince(t0);
+    uncachedNs = (uncachedNs < 0 ? ns : std::min(uncachedNs, ns));
+    t0 = clock::now();
+    for (unsigned i = 0; i < iters; ++i)
+      slots += tm->abiOracle(befty)->paramInfo(2).numArgSlots();
+    ns = nsSince(t0);
+    cachedNs = (cachedNs < 0 ? ns : std::min(cachedNs, ns));
+  }
+  EXPECT_EQ(slots, 2 * rounds * iters * oracle->paramInfo(2).numArgSlots());
+  EXPECT_LT(cachedNs, uncachedNs);
+
+  // Per-call cost of lowering a complete call to foo (which now
+  // includes the cached oracle lookup).
+  const unsigned numCalls = 2000;
+  clock::time_point t0 = clock::now();
+  for (unsigned i = 0; i < numCalls; ++i) {
+    Bexpression *fn = be->function_code_expression(func, loc);
+    std::vector<Bexpression *> args;
+    for (unsigned pidx = 0; pidx < 3; ++pidx)
+      args.push_back(be->var_expression(func->getNthParamVar(pidx), loc));
+    Bexpression *call = be->call_expression(func, fn, args, nullptr, loc);
+    h.mkExprStmt(call);
+  }
+  long long loweringNs = nsSince(t0);
+  EXPECT_EQ(oracle, tm->abiOracle(befty));
+
+  RecordProperty("uncached_oracle_ns_per_call", uncachedNs / iters);
+  RecordProperty("cached_oracle_ns_per_call", cachedNs / iters);
+  RecordProperty("call_lowering_ns_per_call", loweringNs / numCalls);
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 }
@@ -10,6 +10,8 @@
 #include "go-llvm-backend.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -166,4 +168,184 @@ TEST(BackendCallTests, MultiReturnCall) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendCallTests, MathIntrinsicCalls) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Location loc;
+
+  // var x float64; var y uint64
+  Btype *bf64t = be->float_type(64);
+  Btype *bu64t = be->integer_type(true, 64);
+  Bvariable *x = h.mkLocal("x", bf64t, mkFloat64Const(be, 2.0));
+  Bvariable *y = h.mkLocal("y", bu64t, mkUint64Const(be, 10101));
+
+  // __builtin_sqrt(x), __builtin_fabs(x), __builtin_floor(x)
+  const char *unary[] = { "__builtin_sqrt", "__builtin_fabs",
+                          "__builtin_floor" };
+  for (auto name : unary) {
+    Bfunction *bfcn = be->lookup_builtin(name);
+    ASSERT_TRUE(bfcn != nullptr);
+    Bexpression *call =
+        h.mkCallExpr(be, bfcn, be->var_expression(x, loc), nullptr);
+    h.mkExprStmt(call);
+  }
+
+  // __builtin_fma(x, x, x), __builtin_copysign(x, x)
+  {
+  Bfunction *bfcn = be->lookup_builtin("__builtin_fma");
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->var_expression(x, loc),
+                   be->var_expression(x, loc),
+                   be->var_expression(x, loc), nullptr);
+  h.mkExprStmt(call);
+  }
+  {
+  Bfunction *bfcn = be->lookup_builtin("__builtin_copysign");
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->var_expression(x, loc),
+                   be->var_expression(x, loc), nullptr);
+  h.mkExprStmt(call);
+  }
+
+  // __builtin_clzll(y), __builtin_popcountll(y),
+  // __builtin_rotateleft64(y, 13)
+  const char *bits[] = { "__builtin_clzll", "__builtin_popcountll" };
+  for (auto name : bits) {
+    Bfunction *bfcn = be->lookup_builtin(name);
+    ASSERT_TRUE(bfcn != nullptr);
+    Bexpression *call =
+        h.mkCallExpr(be, bfcn, be->var_expression(y, loc), nullptr);
+    h.mkExprStmt(call);
+  }
+  {
+  Bfunction *bfcn = be->lookup_builtin("__builtin_rotateleft64");
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->var_expression(y, loc),
+                   mkUint64Const(be, 13), nullptr);
+  h.mkExprStmt(call);
+  }
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // Each of the above should turn into an intrinsic call and not a
+  // libcall.
+  const char *intrinsics[] = {
+    "call double @llvm.sqrt.f64(double",
+    "call double @llvm.fabs.f64(double",
+    "call double @llvm.floor.f64(double",
+    "call double @llvm.fma.f64(double",
+    "call double @llvm.copysign.f64(double",
+    "call i64 @llvm.ctlz.i64(i64",
+    "call i64 @llvm.ctpop.i64(i64",
+    "call i64 @llvm.fshl.i64(i64",
+  };
+  for (auto pat : intrinsics)
+    EXPECT_EQ(h.countInstancesInModuleDump(pat), 1u) << pat;
+  EXPECT_EQ(h.countInstancesInModuleDump("@sqrt(double"), 0u);
+  EXPECT_EQ(h.countInstancesInModuleDump(
+      "call i64 @__builtin_rotateleft64("), 0u);
+}
+
+TEST(BackendCallTests, CallTemporaryLifetime) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Bfunction *func = h.func();
+  Location loc;
+
+  // type S struct { f1 *int8; f2 *int32; f3 *int64; f4 int64 }
+  // func bar() S
+  Btype *bi8t = be->integer_type(false, 8);
+  Btype *bi32t = be->integer_type(false, 32);
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *st = mkBackendStruct(be, be->pointer_type(bi8t), "f1",
+                              be->pointer_type(bi32t), "f2",
+                              be->pointer_type(bi64t), "f3",
+                              bi64t, "f4", nullptr);
+  BFunctionType *befty = mkFuncTyp(be, L_RES, st, L_END);
+  bool is_decl = true; bool is_inl = false;
+  bool is_vis = true; bool is_split = true;
+  bool is_noret = false; bool is_uniqsec = false;
+  Bfunction *befcn = be->function(befty, "bar", "bar",
+                                  is_vis, is_decl, is_inl, is_split,
+                                  is_noret, is_uniqsec, loc);
+
+  // x := bar()
+  Bexpression *fn = be->function_code_expression(befcn, loc);
+  std::vector<Bexpression *> args;
+  Bexpression *call = be->call_expression(func, fn, args, nullptr, loc);
+  h.mkLocal("x", st, call);
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // The sret temporary for the call is live only within the statement.
+  EXPECT_EQ(h.countInstancesInModuleDump(
+      "call void @llvm.lifetime.start.p0i8(i64 32,"), 1u);
+  EXPECT_EQ(h.countInstancesInModuleDump(
+      "call void @llvm.lifetime.end.p0i8(i64 32,"), 1u);
+}
+
+
+TEST(BackendCallTests, CallTemporaryLifetimesDisjoint) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Bfunction *func = h.func();
+  Location loc;
+
+  // type S struct { f1 *int8; f2 *int32; f3 *int64; f4 int64 }
+  // func bar() S
+  Btype *bi8t = be->integer_type(false, 8);
+  Btype *bi32t = be->integer_type(false, 32);
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *st = mkBackendStruct(be, be->pointer_type(bi8t), "f1",
+                              be->pointer_type(bi32t), "f2",
+                              be->pointer_type(bi64t), "f3",
+                              bi64t, "f4", nullptr);
+  BFunctionType *befty = mkFuncTyp(be, L_RES, st, L_END);
+  bool is_decl = true; bool is_inl = false;
+  bool is_vis = true; bool is_split = true;
+  bool is_noret = false; bool is_uniqsec = false;
+  Bfunction *befcn = be->function(befty, "bar", "bar",
+                                  is_vis, is_decl, is_inl, is_split,
+                                  is_noret, is_uniqsec, loc);
+
+  // x := bar()
+  // y := bar()
+  // z := bar()
+  const unsigned ncalls = 3;
+  const char *names[ncalls] = { "x", "y", "z" };
+  for (unsigned i = 0; i < ncalls; ++i) {
+    Bexpression *fn = be->function_code_expression(befcn, loc);
+    std::vector<Bexpression *> args;
+    Bexpression *call = be->call_expression(func, fn, args, nullptr, loc);
+    h.mkLocal(names[i], st, call);
+  }
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // Each statement's sret temporary must be dead before the next one
+  // starts, so that stack coloring can give all three the same slot.
+  unsigned starts = 0, live = 0, maxLive = 0;
+  for (llvm::Instruction &inst : llvm::instructions(func->function())) {
+    llvm::IntrinsicInst *ii = llvm::dyn_cast<llvm::IntrinsicInst>(&inst);
+    if (!ii || !func->isTemporary(ii->getArgOperand(1)->stripPointerCasts()))
+      continue;
+    if (ii->getIntrinsicID() == llvm::Intrinsic::lifetime_start) {
+      starts += 1;
+      live += 1;
+      maxLive = std::max(maxLive, live);
+    } else if (ii->getIntrinsicID() == llvm::Intrinsic::lifetime_end) {
+      live -= 1;
+    }
+  }
+  EXPECT_EQ(starts, ncalls);
+  EXPECT_EQ(live, 0u);
+  EXPECT_EQ(maxLive, 1u);
+}
+
 }
@@ -8,6 +8,8 @@
 
 #include "TestUtils.h"
 #include "go-llvm-backend.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -395,4 +397,59 @@ TEST(BackendCoreTests, TestFcnPointerCompatible) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendCoreTests, ExportData) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+
+  // Export data is emitted as ".ascii" directives in an excluded
+  // section, with quotes, backslashes, newlines and NULs escaped.
+  const char chunk1[] = "v3;\n\"quoted\"\\";
+  const char chunk2[] = { 'a', '\0', 'b' };
+  be->write_export_data(chunk1, sizeof(chunk1) - 1);
+  be->write_export_data(chunk2, sizeof(chunk2));
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  const char *expected =
+      "\t.section \".go_export\",\"e\",@progbits\n"
+      "\t.ascii \"v3;\\n\\\"quoted\\\"\\\\\"\n"
+      "\t.ascii \"a\\000b\"\n"
+      "\t.text\n";
+  EXPECT_EQ(be->module().getModuleInlineAsm(), expected);
+}
+
+TEST(BackendCoreTests, ExportDataIncbin) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+
+  // With an export data file, the bytes are written to it unescaped
+  // and the excluded section just includes the file.
+  SmallString<128> path;
+  ASSERT_FALSE(sys::fs::createTemporaryFile("exportdata", "gox", path));
+  be->setExportDataFile(std::string(path.str()));
+  const char chunk1[] = "v3;\n\"quoted\"\\";
+  const char chunk2[] = { 'a', '\0', 'b' };
+  be->write_export_data(chunk1, sizeof(chunk1) - 1);
+  be->write_export_data(chunk2, sizeof(chunk2));
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  std::string expected("\t.section \".go_export\",\"e\",@progbits\n"
+                       "\t.incbin \"");
+  expected += path.str();
+  expected += "\"\n\t.text\n";
+  EXPECT_EQ(be->module().getModuleInlineAsm(), expected);
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> mb = MemoryBuffer::getFile(path);
+  ASSERT_TRUE(bool(mb));
+  std::string bytes(chunk1, sizeof(chunk1) - 1);
+  bytes.append(chunk2, sizeof(chunk2));
+  EXPECT_EQ((*mb)->getBuffer().str(), bytes);
+  sys::fs::remove(path);
+}
+
 }
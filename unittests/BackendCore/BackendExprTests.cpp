@@ -1439,7 +1439,7 @@ TEST(BackendExprTests, TestConditionalExpression3) {
 
 
   const char *exp = R"RAW_RESULT(
-define void @foo({ [16 x i32], i32 }* sret %sret.formal.0, i8* nest %nest.0, { [16 x i32], i32 }* byval %p0, i32 %p1) #0 {
+define void @foo({ [16 x i32], i32 }* nonnull sret align 4 dereferenceable(68) %sret.formal.0, i8* nest %nest.0, { [16 x i32], i32 }* byval %p0, i32 %p1) #0 {
 entry:
   %p1.addr = alloca i32
   %a = alloca { [16 x i32], i32 }
@@ -1714,4 +1714,155 @@ TEST(BackendExprTests, TestImmutableStructReferenceDuplication) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendExprTests, TestStrictAliasingTags) {
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  be->setStrictAliasing(true);
+  Location loc;
+
+  // type S struct {
+  //   f1 int32
+  //   f2 float64
+  // }
+  // var s S
+  // var y float64
+  // s.f2 = y
+  Btype *bi32t = be->integer_type(false, 32);
+  Btype *bf64t = be->float_type(64);
+  Btype *st = mkBackendStruct(be, bi32t, "f1", bf64t, "f2", nullptr);
+  Bvariable *sv = h.mkLocal("s", st);
+  Bvariable *yv = h.mkLocal("y", bf64t);
+  Bexpression *vex = be->var_expression(sv, loc);
+  Bexpression *fex = be->struct_field_expression(vex, 1, loc);
+  h.mkAssign(fex, be->var_expression(yv, loc));
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // Scalar tag for the load of y, struct-path tag for the store to s.f2.
+  EXPECT_TRUE(h.expectModuleDumpContains("!{!\"Go TBAA\"}"));
+  EXPECT_TRUE(h.expectModuleDumpContains("!{!\"float64\","));
+  EXPECT_TRUE(h.expectModuleDumpContains("!{!\"struct\","));
+  EXPECT_GE(h.countInstancesInModuleDump("!tbaa"), 2u);
+}
+
+TEST(BackendExprTests, TestStrictAliasingPointerConversion) {
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  be->setStrictAliasing(true);
+  Location loc;
+
+  // var x int64
+  // *(*float64)(&x) = 1.0
+  //
+  // The conversion allows the same memory to be reached through
+  // differently-typed accesses, so no TBAA tags should be emitted.
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *bf64t = be->float_type(64);
+  Bvariable *xv = h.mkLocal("x", bi64t);
+  Bexpression *vex = be->var_expression(xv, loc);
+  Bexpression *adx = be->address_expression(vex, loc);
+  Bexpression *cast = be->convert_expression(be->pointer_type(bf64t),
+                                             adx, loc);
+  Bexpression *dex = be->indirect_expression(bf64t, cast, false, loc);
+  h.mkAssign(dex, mkFloat64Const(be, 1.0));
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+  EXPECT_EQ(h.countInstancesInModuleDump("!tbaa"), 0u);
+}
+
+TEST(BackendExprTests, TestStrictAliasingToUnsafePointer) {
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  be->setStrictAliasing(true);
+  Location loc;
+
+  // var x int64
+  // p := unsafe.Pointer(&x)
+  // x = 2
+  //
+  // An unsafe.Pointer can't be dereferenced, so converting to one
+  // doesn't by itself cost the function its TBAA tags.
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *bvpt = be->pointer_type(be->void_type());
+  Bvariable *xv = h.mkLocal("x", bi64t);
+  Bexpression *adx = be->address_expression(be->var_expression(xv, loc), loc);
+  h.mkLocal("p", bvpt, be->convert_expression(bvpt, adx, loc));
+  h.mkAssign(be->var_expression(xv, loc), mkInt64Const(be, 2));
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+  EXPECT_GE(h.countInstancesInModuleDump("!tbaa"), 1u);
+}
+
+TEST(BackendExprTests, TestStrictAliasingAllocatorResult) {
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  be->setStrictAliasing(true);
+  Location loc;
+
+  // p := (*int64)(runtime.newobject(td))
+  // *p = 1
+  //
+  // Fresh memory from an allocator can't be reached through any
+  // other type, so the conversion of its result keeps the tags.
+  Btype *bu8t = be->integer_type(true, 8);
+  Btype *bpu8t = be->pointer_type(bu8t);
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *bpi64t = be->pointer_type(bi64t);
+  BFunctionType *newobjTyp = mkFuncTyp(be, L_PARM, bpu8t, L_RES, bpu8t, L_END);
+  bool is_visible = true;
+  bool is_declaration = true;
+  bool is_inl = true;
+  bool is_splitstack = true;
+  bool in_unique_section = false;
+  bool is_noret = false;
+  Bfunction *newobj =
+      be->function(newobjTyp, "runtime.newobject", "runtime.newobject",
+                   is_visible, is_declaration, is_inl, is_splitstack,
+                   is_noret, in_unique_section, loc);
+  Bexpression *call =
+      h.mkCallExpr(be, newobj, be->zero_expression(bpu8t), nullptr);
+  Bvariable *pv = h.mkLocal("p", bpi64t,
+                            be->convert_expression(bpi64t, call, loc));
+  Bexpression *dex =
+      be->indirect_expression(bi64t, be->var_expression(pv, loc), false, loc);
+  h.mkAssign(dex, mkInt64Const(be, 1));
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+  EXPECT_GE(h.countInstancesInModuleDump("!tbaa"), 1u);
+}
+
+TEST(BackendExprTests, TestKnownValidIndirection) {
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Location loc;
+
+  // var p, q *int64
+  // x := *p  // flagged known-valid by the front end
+  // y := *q
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *pbi64t = be->pointer_type(bi64t);
+  Bvariable *pv = h.mkLocal("p", pbi64t);
+  Bvariable *qv = h.mkLocal("q", pbi64t);
+  Bexpression *dp = be->indirect_expression(bi64t,
+                                            be->var_expression(pv, loc),
+                                            true, loc);
+  h.mkLocal("x", bi64t, dp);
+  Bexpression *dq = be->indirect_expression(bi64t,
+                                            be->var_expression(qv, loc),
+                                            false, loc);
+  h.mkLocal("y", bi64t, dq);
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // Only the load of 'p' should be annotated.
+  EXPECT_EQ(h.countInstancesInModuleDump("!nonnull"), 1u);
+  EXPECT_EQ(h.countInstancesInModuleDump("!dereferenceable"), 1u);
+  EXPECT_EQ(h.countInstancesInModuleDump("!align"), 1u);
+}
+
 }
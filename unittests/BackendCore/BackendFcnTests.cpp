@@ -135,7 +135,10 @@ TEST(BackendFcnTests, BuiltinFunctionsMisc) {
       "__builtin_memcmp",        "__builtin_ctz",
       "__builtin_ctzll",         "__builtin_bswap32",
       "__builtin_bswap64",       "__builtin_return_address",
-      "__builtin_frame_address", "__builtin_unreachable"
+      "__builtin_frame_address", "__builtin_unreachable",
+      "__atomic_load_4",         "__atomic_store_8",
+      "__atomic_exchange_4",     "__atomic_compare_exchange_8",
+      "__atomic_add_fetch_8",    "__atomic_or_fetch_1"
   };
   for (auto fname : tocheck) {
     Bfunction *bfcn = be->lookup_builtin(fname);
@@ -267,6 +270,59 @@ TEST(BackendFcnTests, MakeMultipleDeclarations) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendFcnTests, RuntimeFunctionAttributes) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Location loc;
+
+  // Declarations of known runtime entry points pick up attributes
+  // from the runtime attribute table, provided the signature matches.
+  Btype *bu8t = be->integer_type(true, 8);
+  Btype *bpu8t = be->pointer_type(bu8t);
+  Btype *bi64t = be->integer_type(false, 64);
+  BFunctionType *newobjTyp = mkFuncTyp(be, L_PARM, bpu8t, L_RES, bpu8t, L_END);
+  BFunctionType *panicTyp = mkFuncTyp(be, L_END);
+  BFunctionType *badTyp = mkFuncTyp(be, L_PARM, bi64t, L_END);
+  bool is_visible = true;
+  bool is_declaration = true;
+  bool is_inl = true;
+  bool is_splitstack = true;
+  bool in_unique_section = false;
+  bool is_noret = false;
+  Bfunction *bf1 =
+      be->function(newobjTyp, "runtime.newobject", "runtime.newobject",
+                   is_visible, is_declaration, is_inl, is_splitstack,
+                   is_noret, in_unique_section, loc);
+  Bfunction *bf2 =
+      be->function(panicTyp, "runtime.panicmem", "runtime.panicmem",
+                   is_visible, is_declaration, is_inl, is_splitstack,
+                   is_noret, in_unique_section, loc);
+  Bfunction *bf3 =
+      be->function(badTyp, "runtime.panicdivide", "runtime.panicdivide",
+                   is_visible, is_declaration, is_inl, is_splitstack,
+                   is_noret, in_unique_section, loc);
+
+  llvm::Function *f1 = bf1->function();
+  EXPECT_TRUE(f1->hasFnAttribute(llvm::Attribute::NoUnwind));
+  llvm::AttributeList al1 = f1->getAttributes();
+  EXPECT_TRUE(al1.hasAttribute(llvm::AttributeList::ReturnIndex,
+                               llvm::Attribute::NoAlias));
+  EXPECT_TRUE(al1.hasAttribute(llvm::AttributeList::ReturnIndex,
+                               llvm::Attribute::NonNull));
+  llvm::Function *f2 = bf2->function();
+  EXPECT_TRUE(f2->hasFnAttribute(llvm::Attribute::Cold));
+  EXPECT_TRUE(f2->hasFnAttribute(llvm::Attribute::NoReturn));
+  EXPECT_FALSE(f2->hasFnAttribute(llvm::Attribute::NoUnwind));
+
+  // Parameter count mismatch: entry is ignored.
+  llvm::Function *f3 = bf3->function();
+  EXPECT_FALSE(f3->hasFnAttribute(llvm::Attribute::Cold));
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 TEST(BackendFcnTests, TestIntrinsicCall) {
   FcnTestHarness h("foo");
   Llvm_backend *be = h.be();
@@ -371,6 +427,76 @@ TEST(BackendFcnTests, TestCallMemBuiltins) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendFcnTests, TestAtomicBuiltins) {
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Location loc;
+
+  // var x, y, z uint32
+  Btype *bu32t = be->integer_type(true, 32);
+  Bvariable *x = h.mkLocal("x", bu32t);
+  Bvariable *y = h.mkLocal("y", bu32t);
+  Bvariable *z = h.mkLocal("z", bu32t);
+
+  // y = __atomic_load_4(&x, __ATOMIC_ACQUIRE)
+  {
+  Bfunction *bfcn = be->lookup_builtin("__atomic_load_4");
+  Bexpression *vex = be->var_expression(x, loc);
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->address_expression(vex, loc),
+                   mkInt32Const(be, 2), nullptr);
+  h.mkAssign(be->var_expression(y, loc), call);
+  }
+
+  // __atomic_store_4(&x, 3, __ATOMIC_RELEASE)
+  {
+  Bfunction *bfcn = be->lookup_builtin("__atomic_store_4");
+  Bexpression *vex = be->var_expression(x, loc);
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->address_expression(vex, loc),
+                   mkUIntConst(be, 3, 32), mkInt32Const(be, 3), nullptr);
+  h.mkExprStmt(call);
+  }
+
+  // z = __atomic_add_fetch_4(&x, 5, __ATOMIC_SEQ_CST)
+  {
+  Bfunction *bfcn = be->lookup_builtin("__atomic_add_fetch_4");
+  Bexpression *vex = be->var_expression(x, loc);
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->address_expression(vex, loc),
+                   mkUIntConst(be, 5, 32), mkInt32Const(be, 5), nullptr);
+  h.mkAssign(be->var_expression(z, loc), call);
+  }
+
+  // __atomic_compare_exchange_4(&x, &y, 7, false,
+  //                             __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE)
+  {
+  Bfunction *bfcn = be->lookup_builtin("__atomic_compare_exchange_4");
+  Bexpression *vex = be->var_expression(x, loc);
+  Bexpression *vey = be->var_expression(y, loc);
+  Bexpression *call =
+      h.mkCallExpr(be, bfcn, be->address_expression(vex, loc),
+                   be->address_expression(vey, loc),
+                   mkUIntConst(be, 7, 32),
+                   be->boolean_constant_expression(false),
+                   mkInt32Const(be, 5), mkInt32Const(be, 2), nullptr);
+  h.mkExprStmt(call);
+  }
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // All of the above should be expanded inline.
+  EXPECT_TRUE(h.expectModuleDumpContains(
+      "load atomic i32, i32* %x acquire, align 4"));
+  EXPECT_TRUE(h.expectModuleDumpContains(
+      "store atomic i32 3, i32* %x release, align 4"));
+  EXPECT_TRUE(h.expectModuleDumpContains(
+      "atomicrmw add i32* %x, i32 5 seq_cst"));
+  EXPECT_TRUE(h.expectModuleDumpContains("seq_cst acquire"));
+  EXPECT_EQ(h.countInstancesInModuleDump("call"), 0u);
+}
+
 TEST(BackendFcnTests, TestMultipleExternalFcnsWithSameName) {
   FcnTestHarness h("foo");
   Llvm_backend *be = h.be();
@@ -516,4 +642,44 @@ TEST(BackendFcnTests, TestDeclAndDefWithSameName) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+
+TEST(BackendFcnTests, DiscardValueNames) {
+  LLVMContext C;
+  C.setDiscardValueNames(true);
+  std::unique_ptr<Llvm_backend> be(new Llvm_backend(C, nullptr, nullptr));
+  be->disableDebugMetaDataGeneration();
+  Location loc;
+
+  // Value names are not generated, but names for globals still are.
+  EXPECT_TRUE(be->discardValueNames());
+  EXPECT_EQ(be->namegen("tmp"), "");
+  EXPECT_NE(be->uniqueName("const"), "");
+
+  // x := p0; x = x + 2; return x
+  Bfunction *func = mkFunci32o64(be.get(), "foo");
+  Btype *bi64t = be->integer_type(false, 64);
+  Bvariable *xv = be->local_variable(func, "x", bi64t, nullptr, false, loc);
+  Bstatement *is = be->init_statement(func, xv, mkInt64Const(be.get(), 1));
+  Bblock *block = mkBlockFromStmt(be.get(), func, is);
+  Bexpression *add =
+      be->binary_expression(OPERATOR_PLUS, be->var_expression(xv, loc),
+                            mkInt64Const(be.get(), 2), loc);
+  addStmtToBlock(be.get(), block,
+                 be->assignment_statement(func, be->var_expression(xv, loc),
+                                          add, loc));
+  addStmtToBlock(be.get(), block,
+                 be->return_statement(func, {be->var_expression(xv, loc)},
+                                      loc));
+  be->function_set_body(func, block);
+
+  Function *f = func->function();
+  EXPECT_EQ(f->getName(), "foo");
+  for (BasicBlock &bb : *f)
+    for (Instruction &inst : bb)
+      EXPECT_FALSE(inst.hasName());
+
+  bool broken = llvm::verifyModule(be->module(), &llvm::dbgs());
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 }
@@ -14,6 +14,8 @@
 #include "TestUtils.h"
 #include "DiffUtils.h"
 
+#include <chrono>
+
 using namespace goBackendUnitTests;
 
 namespace {
@@ -174,6 +176,35 @@ TEST(BackendNodeTests, CloneSubtree) {
 
 }
 
+TEST(BackendNodeTests, CloneCallKeepsTarget) {
+
+  FcnTestHarness h("foo");
+  Llvm_backend *be = h.be();
+  Bfunction *func = h.func();
+  Location loc = h.loc();
+
+  // The function address is a constant, but cloning must not turn it
+  // into a plain constant node, or the clone loses its direct target.
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *bpi64t = be->pointer_type(bi64t);
+  Bexpression *fn = be->function_code_expression(func, loc);
+  std::vector<Bexpression *> args;
+  args.push_back(mkInt32Const(be, int64_t(3)));
+  args.push_back(mkInt32Const(be, int64_t(6)));
+  args.push_back(be->zero_expression(bpi64t));
+  Bexpression *call = be->call_expression(func, fn, args, nullptr, loc);
+  Bexpression *clone = be->nodeBuilder().cloneSubtree(call);
+  EXPECT_NE(call, clone);
+  EXPECT_EQ(call->getCallTarget(), func);
+  EXPECT_EQ(clone->getCallTarget(), func);
+
+  h.mkExprStmt(call);
+  h.mkExprStmt(clone);
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 TEST(BackendNodeTests, FixSharing) {
 
   FcnTestHarness h("foo");
@@ -215,4 +246,172 @@ TEST(BackendNodeTests, FixSharing) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+TEST(BackendNodeTests, LargeFunctionArena) {
+
+  llvm::LLVMContext C;
+  std::unique_ptr<Llvm_backend> be(new Llvm_backend(C, nullptr, nullptr));
+  be->disableDebugMetaDataGeneration();
+  BnodeBuilder &builder = be->nodeBuilder();
+  Location loc;
+  Btype *bi64t = be->integer_type(false, 64);
+
+  // Build and lower a series of large functions, each a long run of
+  // statements of the form
+  //   x = x + (y * <const>)
+  // to exercise Bnode allocation at scale. Every node should come out
+  // of the builder's arena, and once the first function is lowered,
+  // the rest should be built mostly from its recycled storage.
+  const unsigned numStmts = 5000;
+  auto buildBody = [&](Bfunction *func) {
+    Bvariable *xv = be->local_variable(func, "x", bi64t, nullptr,
+                                       false, loc);
+    Bvariable *yv = be->local_variable(func, "y", bi64t, nullptr,
+                                       false, loc);
+    Bstatement *st = be->init_statement(func, yv, mkInt64Const(be.get(), 3));
+    Bblock *block = mkBlockFromStmt(be.get(), func, st);
+    addStmtToBlock(be.get(), block,
+                   be->init_statement(func, xv, mkInt64Const(be.get(), 0)));
+    for (unsigned i = 0; i < numStmts; ++i) {
+      Bexpression *vex = be->var_expression(xv, loc);
+      Bexpression *vey = be->var_expression(yv, loc);
+      Bexpression *mul = be->binary_expression(OPERATOR_MULT, vey,
+                                               mkInt64Const(be.get(), i),
+                                               loc);
+      Bexpression *add = be->binary_expression(OPERATOR_PLUS, vex, mul, loc);
+      EXPECT_EQ(add->children().size(), 2u);
+      Bstatement *as =
+          be->assignment_statement(func, be->var_expression(xv, loc),
+                                   add, loc);
+      addStmtToBlock(be.get(), block, as);
+    }
+    Bstatement *ret =
+        be->return_statement(func, {be->var_expression(xv, loc)}, loc);
+    addStmtToBlock(be.get(), block, ret);
+    return block;
+  };
+
+  typedef std::chrono::steady_clock clock;
+  const unsigned numFuncs = 4;
+  size_t bytes0 = builder.nodeBytesAllocated();
+  size_t bytes1 = 0;
+  unsigned long nodesPerFunc = 0;
+  unsigned long recycled1 = 0;
+  long long buildNs = 0;
+  for (unsigned f = 0; f < numFuncs; ++f) {
+    std::string fname("foo" + std::to_string(f));
+    Bfunction *func = mkFunci32o64(be.get(), fname.c_str());
+    unsigned long live0 = builder.liveNodeCount();
+    clock::time_point t0 = clock::now();
+    Bblock *body = buildBody(func);
+    be->function_set_body(func, body);
+    buildNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock::now() - t0).count();
+    if (f == 0) {
+      nodesPerFunc = builder.peakLiveNodeCount() - live0;
+      bytes1 = builder.nodeBytesAllocated();
+      recycled1 = builder.recycledNodeCount();
+    }
+  }
+  size_t bytes2 = builder.nodeBytesAllocated();
+
+  // First function: at least the statements were carved out of the
+  // arena, and no more than a dozen nodes' worth of storage was used
+  // per statement, so that growth in the size of nodes or in the
+  // number of nodes made per statement shows up here.
+  size_t nodeBytes = bytes1 - bytes0;
+  EXPECT_GT(nodeBytes, numStmts * sizeof(Bstatement));
+  EXPECT_LT(nodeBytes, numStmts * 12 * sizeof(Bexpression));
+
+  // Later functions: each statement gets at least its assignment, var
+  // exprs and arithmetic nodes from the free lists, the live node
+  // count never gets near what keeping every tree would need, and the
+  // arena barely grows.
+  EXPECT_GE(builder.recycledNodeCount() - recycled1,
+            (numFuncs - 1) * numStmts * 5ul);
+  EXPECT_LT(builder.peakLiveNodeCount(), 2 * nodesPerFunc);
+  EXPECT_LT(bytes2 - bytes1, nodeBytes / 4);
+
+  RecordProperty("node_bytes_first_function", nodeBytes);
+  RecordProperty("node_bytes_later_functions", bytes2 - bytes1);
+  RecordProperty("peak_live_nodes", builder.peakLiveNodeCount());
+  RecordProperty("build_and_lower_ns_per_stmt",
+                 buildNs / (numFuncs * numStmts));
+
+  bool broken = llvm::verifyModule(be->module(), &llvm::dbgs());
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
+
+TEST(BackendNodeTests, ReleaseLoweredTree) {
+
+  llvm::LLVMContext C;
+  std::unique_ptr<Llvm_backend> be(new Llvm_backend(C, nullptr, nullptr));
+  be->disableDebugMetaDataGeneration();
+  BnodeBuilder &builder = be->nodeBuilder();
+  Location loc;
+  Btype *bi64t = be->integer_type(false, 64);
+
+  // Build and lower two functions of identical shape. Once the first
+  // function's body has been lowered its Bnodes are released, so
+  // building the second function's tree should mostly be satisfied
+  // from recycled node storage.
+  auto buildBody = [&](Bfunction *func, Bexpression *gvex) {
+    Bvariable *xv = be->local_variable(func, "x", bi64t, nullptr,
+                                       false, loc);
+    Bexpression *vex = be->var_expression(xv, loc);
+    Bstatement *st = be->init_statement(func, xv, mkInt64Const(be.get(), 1));
+    Bblock *block = mkBlockFromStmt(be.get(), func, st);
+    for (unsigned i = 0; i < 100; ++i) {
+      Bexpression *add =
+          be->binary_expression(OPERATOR_PLUS, be->var_expression(xv, loc),
+                                mkInt64Const(be.get(), i), loc);
+      Bstatement *as = be->assignment_statement(func,
+                                                be->var_expression(xv, loc),
+                                                add, loc);
+      addStmtToBlock(be.get(), block, as);
+    }
+    Bvariable *tv = be->local_variable(func, "t", bi64t, nullptr,
+                                       false, loc);
+    addStmtToBlock(be.get(), block, be->init_statement(func, tv, gvex));
+    Bstatement *ret = be->return_statement(func, {vex}, loc);
+    addStmtToBlock(be.get(), block, ret);
+    return block;
+  };
+
+  // A var expr for a global, used in the first tree. Its value is the
+  // global itself, so it is held over rather than released.
+  Bvariable *gv = be->global_variable("g", "g", bi64t, false, /* is_external */
+                                      false, /* is_hidden */
+                                      false, /* unique_section */
+                                      loc);
+
+  // Module-scope constants are shared between the two trees.
+  Bexpression *one = mkInt64Const(be.get(), 1);
+  EXPECT_TRUE(one->moduleScope());
+
+  size_t bytes0 = builder.nodeBytesAllocated();
+  Bfunction *f1 = mkFunci32o64(be.get(), "foo");
+  Bexpression *gvex = be->var_expression(gv, loc);
+  Bblock *b1 = buildBody(f1, gvex);
+  be->function_set_body(f1, b1);
+  size_t bytes1 = builder.nodeBytesAllocated();
+
+  unsigned long recycled1 = builder.recycledNodeCount();
+  Bfunction *f2 = mkFunci32o64(be.get(), "bar");
+  Bblock *b2 = buildBody(f2, be->var_expression(gv, loc));
+  size_t bytes2 = builder.nodeBytesAllocated();
+  EXPECT_GE(builder.recycledNodeCount() - recycled1, 300u);
+  EXPECT_LT(bytes2 - bytes1, (bytes1 - bytes0) / 2);
+  be->function_set_body(f2, b2);
+
+  // The shared constant survived the release of the first tree.
+  EXPECT_EQ(mkInt64Const(be.get(), 1), one);
+  EXPECT_EQ(one->flavor(), N_Const);
+  EXPECT_EQ(gvex->flavor(), N_Var);
+  EXPECT_EQ(gvex->value(), gv->value());
+
+  bool broken = llvm::verifyModule(be->module(), &llvm::dbgs());
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 }
@@ -10,6 +10,7 @@
 #include "go-llvm-backend.h"
 #include "gtest/gtest.h"
 
+
 using namespace llvm;
 using namespace goBackendUnitTests;
 
@@ -201,4 +202,120 @@ TEST(BackendTreeIntegrity, CheckTreeIntegrityRepairableSubtree) {
   EXPECT_FALSE(broken && "Module failed to verify.");
 }
 
+
+TEST(BackendTreeIntegrity, RepairOnlyMode) {
+  FcnTestHarness h;
+  Llvm_backend *be = h.be();
+  be->setTreeIntegrityMode(TreeIntegrityRepairOnly);
+  Btype *bi32t = be->integer_type(false, 32);
+  Btype *bpi32t = be->pointer_type(bi32t);
+  BFunctionType *befty = mkFuncTyp(be, L_PARM, bpi32t, L_END);
+  Bfunction *func = h.mkFunction("x", befty);
+  Location loc;
+
+  // *p0 + *p0, where both operands are the same (repairable) subtree.
+  Bvariable *p0v = func->getNthParamVar(0);
+  Bexpression *vex0 = be->var_expression(p0v, loc);
+  Bexpression *deref = be->indirect_expression(bi32t, vex0, false, loc);
+  Bexpression *add =
+      be->binary_expression(OPERATOR_PLUS, deref, deref, loc);
+
+  TreeIntegCtl control(NoDumpPointers, ReportRepairableSharing, BatchMode);
+  std::pair<bool, std::string> result = be->checkTreeIntegrity(add, control);
+  EXPECT_FALSE(result.first);
+  EXPECT_TRUE(containstokens(result.second, "expr has multiple parents"));
+
+  // Materializing the expression should unshare it without having
+  // to fall back on the full checker.
+  unsigned long fallbacks0 = be->integrityCheckFallbacks();
+  Bstatement *es = h.mkExprStmt(add);
+  EXPECT_EQ(be->integrityCheckFallbacks(), fallbacks0);
+  result = be->checkTreeIntegrity(es, control);
+  EXPECT_TRUE(result.first);
+  EXPECT_EQ(result.second, "");
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
+
+TEST(BackendTreeIntegrity, RepairOnlyModeUntrackedRoot) {
+  LLVMContext C;
+  std::unique_ptr<Llvm_backend> be(new Llvm_backend(C, nullptr, nullptr));
+  be->setTreeIntegrityMode(TreeIntegrityRepairOnly);
+
+  // Error nodes and module-scope constants aren't tracked by the
+  // repairer (error nodes don't even have a proper id); walks rooted
+  // at them should be no-ops.
+  Bexpression *err = be->error_expression();
+  be->enforceTreeIntegrity(err);
+  Bexpression *c = mkInt64Const(be.get(), 3);
+  be->enforceTreeIntegrity(c);
+
+  TreeIntegCtl control(NoDumpPointers, ReportRepairableSharing, BatchMode);
+  EXPECT_TRUE(be->checkTreeIntegrity(c, control).first);
+}
+
+
+// Build a balanced tree of additions whose leaves are all the same
+// expression node.
+static Bexpression *mkSharedSum(Backend *be, Bexpression *leaf,
+                                unsigned nleaves)
+{
+  Location loc;
+  std::vector<Bexpression *> level(nleaves, leaf);
+  while (level.size() > 1) {
+    std::vector<Bexpression *> next;
+    for (unsigned i = 0; i + 1 < level.size(); i += 2)
+      next.push_back(be->binary_expression(OPERATOR_PLUS, level[i],
+                                           level[i+1], loc));
+    if (level.size() % 2)
+      next.push_back(level.back());
+    level.swap(next);
+  }
+  return level[0];
+}
+
+TEST(BackendTreeIntegrity, SharedSubtreeStress) {
+  FcnTestHarness h;
+  Llvm_backend *be = h.be();
+  BnodeBuilder &builder = be->nodeBuilder();
+  Btype *bi64t = be->integer_type(false, 64);
+  Btype *bpi64t = be->pointer_type(bi64t);
+  BFunctionType *befty = mkFuncTyp(be, L_PARM, bpi64t, L_END);
+  Bfunction *func = h.mkFunction("x", befty);
+  Location loc;
+  const unsigned nleaves = 4096;
+
+  // A subtree that has already been lowered to a constant, shared
+  // by every leaf of a large expression. Repairing the sharing should
+  // reuse the constant rather than cloning the subtree.
+  Bexpression *conv =
+      be->materialize(be->convert_expression(bi64t, mkInt32Const(be, 7),
+                                             loc));
+  EXPECT_TRUE(builder.constantValueReusable(conv));
+  unsigned long clones0 = builder.clonedNodeCount();
+  unsigned long reuses0 = builder.reusedConstantCount();
+  Bstatement *es1 = h.mkExprStmt(mkSharedSum(be, conv, nleaves));
+  EXPECT_EQ(builder.clonedNodeCount() - clones0, 0u);
+  EXPECT_EQ(builder.reusedConstantCount() - reuses0, nleaves - 1);
+
+  // An unlowered subtree ("*p0") shared in the same way has to be
+  // cloned, but only once per additional reference.
+  Bvariable *p0v = func->getNthParamVar(0);
+  Bexpression *deref =
+      be->indirect_expression(bi64t, be->var_expression(p0v, loc),
+                              false, loc);
+  unsigned long clones1 = builder.clonedNodeCount();
+  Bstatement *es2 = h.mkExprStmt(mkSharedSum(be, deref, nleaves));
+  EXPECT_EQ(builder.clonedNodeCount() - clones1, 2 * (nleaves - 1));
+
+  TreeIntegCtl control(NoDumpPointers, ReportRepairableSharing, BatchMode);
+  EXPECT_TRUE(be->checkTreeIntegrity(es1, control).first);
+  EXPECT_TRUE(be->checkTreeIntegrity(es2, control).first);
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 }
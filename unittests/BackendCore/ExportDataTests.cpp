@@ -0,0 +1,283 @@
+//===- llvm/tools/gollvm/unittests/BackendCore/ExportDataTests.cpp ------===//
+//
+// Copyright 2018 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+
+#include "TestUtils.h"
+#include "go-c.h"
+#include "go-export-data.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+// Returns a minimal ELF relocatable object, with a .go_export section
+// holding the specified bytes (no such section if 'exportData' is
+// empty).
+std::string mkObject(const std::string &exportData)
+{
+  const std::string shstrtab("\0.shstrtab\0.go_export\0", 22);
+  unsigned numSections = exportData.empty() ? 2 : 3;
+
+  ELF::Elf64_Ehdr ehdr;
+  memset(&ehdr, 0, sizeof(ehdr));
+  memcpy(ehdr.e_ident, ELF::ElfMagic, 4);
+  ehdr.e_ident[ELF::EI_CLASS] = ELF::ELFCLASS64;
+  ehdr.e_ident[ELF::EI_DATA] =
+      sys::IsLittleEndianHost ? ELF::ELFDATA2LSB : ELF::ELFDATA2MSB;
+  ehdr.e_ident[ELF::EI_VERSION] = ELF::EV_CURRENT;
+  ehdr.e_type = ELF::ET_REL;
+  ehdr.e_machine = ELF::EM_X86_64;
+  ehdr.e_version = ELF::EV_CURRENT;
+  ehdr.e_ehsize = sizeof(ehdr);
+  ehdr.e_shentsize = sizeof(ELF::Elf64_Shdr);
+  ehdr.e_shnum = numSections;
+  ehdr.e_shstrndx = 1;
+
+  std::string body = shstrtab + exportData;
+  while ((sizeof(ehdr) + body.size()) % 8)
+    body.push_back('\0');
+  ehdr.e_shoff = sizeof(ehdr) + body.size();
+
+  std::vector<ELF::Elf64_Shdr> shdrs(numSections);
+  memset(shdrs.data(), 0, numSections * sizeof(ELF::Elf64_Shdr));
+  shdrs[1].sh_name = 1;
+  shdrs[1].sh_type = ELF::SHT_STRTAB;
+  shdrs[1].sh_offset = sizeof(ehdr);
+  shdrs[1].sh_size = shstrtab.size();
+  shdrs[1].sh_addralign = 1;
+  if (!exportData.empty()) {
+    shdrs[2].sh_name = 11;
+    shdrs[2].sh_type = ELF::SHT_PROGBITS;
+    shdrs[2].sh_flags = ELF::SHF_EXCLUDE;
+    shdrs[2].sh_offset = sizeof(ehdr) + shstrtab.size();
+    shdrs[2].sh_size = exportData.size();
+    shdrs[2].sh_addralign = 1;
+  }
+
+  std::string result(reinterpret_cast<const char *>(&ehdr), sizeof(ehdr));
+  result += body;
+  result.append(reinterpret_cast<const char *>(shdrs.data()),
+                numSections * sizeof(ELF::Elf64_Shdr));
+  return result;
+}
+
+// Returns an archive with the specified members (name, contents), and
+// the offset of the contents of each member (as passed by the front
+// end to go_read_export_data).
+std::string mkArchive(const std::vector<std::pair<std::string,
+                                                  std::string>> &members,
+                      std::vector<off_t> *offsets)
+{
+  std::string ar("!<arch>\n");
+  for (auto &member : members) {
+    char hdr[61];
+    snprintf(hdr, sizeof(hdr), "%-16s%-12s%-6s%-6s%-8s%-10zu`\n",
+             (member.first + "/").c_str(), "0", "0", "0", "644",
+             member.second.size());
+    ar.append(hdr, 60);
+    offsets->push_back(ar.size());
+    ar += member.second;
+    if (ar.size() & 1)
+      ar.push_back('\n');
+  }
+  return ar;
+}
+
+// Returns a bitcode object carrying export data in its module inline
+// asm, as written by Llvm_backend::write_export_data.
+std::string mkBitcode(const std::string &asmText)
+{
+  LLVMContext context;
+  Module module("exportdata", context);
+  module.setModuleInlineAsm(asmText);
+  std::string bytes;
+  raw_string_ostream os(bytes);
+  WriteBitcodeToFile(module, os);
+  os.flush();
+  return bytes;
+}
+
+class TempFile {
+ public:
+  TempFile() {
+    SmallString<128> path;
+    EXPECT_FALSE(sys::fs::createTemporaryFile("exportdata", "o", path));
+    path_ = std::string(path.str());
+  }
+  ~TempFile() { sys::fs::remove(path_); }
+
+  const char *path() const { return path_.c_str(); }
+
+  void write(const std::string &contents) {
+    std::ofstream os(path(), std::ios::binary | std::ios::trunc);
+    os << contents;
+  }
+
+ private:
+  std::string path_;
+};
+
+// Reads the export data at the specified offset in a file through
+// go_read_export_data. Returns the error message, if any; 'result' is
+// left empty if there is no export data.
+const char *readExportData(const char *path, off_t offset,
+                           std::string *result)
+{
+  result->clear();
+  int fd = ::open(path, O_RDONLY);
+  EXPECT_GE(fd, 0);
+  char *buf = nullptr;
+  size_t len = 0;
+  int err = 0;
+  const char *errmsg = go_read_export_data(fd, offset, &buf, &len, &err);
+  ::close(fd);
+  if (buf) {
+    result->assign(buf, len);
+    delete[] buf;
+  }
+  return errmsg;
+}
+
+std::pair<unsigned, unsigned> cacheStats()
+{
+  unsigned hits, misses;
+  go_export_data_cache_stats(&hits, &misses);
+  return std::make_pair(hits, misses);
+}
+
+TEST(ExportDataTests, ReadObjectCached) {
+  TempFile file;
+  std::string data("v3;\npackage cached\n");
+  file.write(mkObject(data));
+
+  auto before = cacheStats();
+  std::string bytes;
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+  EXPECT_EQ(bytes, data);
+  auto after = cacheStats();
+  EXPECT_EQ(after.first, before.first);
+  EXPECT_EQ(after.second, before.second + 1);
+
+  // A second read is served from the index, with the same result.
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+  EXPECT_EQ(bytes, data);
+  auto again = cacheStats();
+  EXPECT_EQ(again.first, after.first + 1);
+  EXPECT_EQ(again.second, after.second);
+}
+
+TEST(ExportDataTests, ReadArchiveMembers) {
+  TempFile file;
+  std::string data1("v3;\npackage first\n");
+  std::string data2("v3;\npackage second, a bit longer\n");
+  std::vector<off_t> offsets;
+  file.write(mkArchive({ { "a.o", mkObject(data1) },
+                         { "_cgo_flags", "_CGO_LDFLAGS=-lm\n" },
+                         { "b.o", mkObject(data2) },
+                         { "c.o", mkObject("") } }, &offsets));
+  ASSERT_EQ(offsets.size(), 4u);
+
+  std::string bytes;
+  EXPECT_EQ(readExportData(file.path(), offsets[2], &bytes), nullptr);
+  EXPECT_EQ(bytes, data2);
+  EXPECT_EQ(readExportData(file.path(), offsets[0], &bytes), nullptr);
+  EXPECT_EQ(bytes, data1);
+
+  // Members that aren't objects, or have no export data, are ignored.
+  EXPECT_EQ(readExportData(file.path(), offsets[1], &bytes), nullptr);
+  EXPECT_TRUE(bytes.empty());
+  EXPECT_EQ(readExportData(file.path(), offsets[3], &bytes), nullptr);
+  EXPECT_TRUE(bytes.empty());
+}
+
+TEST(ExportDataTests, RewrittenFile) {
+  TempFile file;
+  std::string data1("v3;\npackage old\n");
+  file.write(mkObject(data1));
+  std::string bytes;
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+  EXPECT_EQ(bytes, data1);
+
+  // Rewriting the file in place must not give back the old data.
+  std::string data2("v3;\npackage new, with more to it\n");
+  file.write(mkObject(data2));
+  auto before = cacheStats();
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+  EXPECT_EQ(bytes, data2);
+  EXPECT_EQ(cacheStats().second, before.second + 1);
+}
+
+TEST(ExportDataTests, NoExportData) {
+  TempFile object, text;
+  object.write(mkObject(""));
+  text.write("not an object file\n");
+
+  std::string bytes;
+  EXPECT_EQ(readExportData(object.path(), 0, &bytes), nullptr);
+  EXPECT_TRUE(bytes.empty());
+  EXPECT_EQ(readExportData(text.path(), 0, &bytes), nullptr);
+  EXPECT_TRUE(bytes.empty());
+}
+
+TEST(ExportDataTests, ReadBitcode) {
+  TempFile file;
+  file.write(mkBitcode("\t.section \".go_export\",\"e\",@progbits\n"
+                       "\t.ascii \"v3;\\n\\\"quoted\\\"\\\\\"\n"
+                       "\t.ascii \"a\\000b\"\n"
+                       "\t.text\n"));
+  std::string bytes;
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+  EXPECT_EQ(bytes, std::string("v3;\n\"quoted\"\\a\0b", 16));
+}
+
+TEST(ExportDataTests, PreloadThenRead) {
+  TempFile file;
+  std::string data("v3;\npackage preloaded\n");
+  file.write(mkObject(data));
+  go_preload_export_data(file.path());
+
+  auto before = cacheStats();
+  std::string bytes;
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+  EXPECT_EQ(bytes, data);
+  auto after = cacheStats();
+  EXPECT_EQ(after.first, before.first + 1);
+  EXPECT_EQ(after.second, before.second);
+}
+
+TEST(ExportDataTests, ReportsPaths) {
+  TempFile file;
+  file.write(mkObject("v3;\npackage reported\n"));
+  std::string bytes;
+  EXPECT_EQ(readExportData(file.path(), 0, &bytes), nullptr);
+
+  std::vector<std::string> paths;
+  go_export_data_paths(&paths);
+#if defined(__linux__) || defined(F_GETPATH)
+  bool found = false;
+  for (auto &path : paths) {
+    bool same = false;
+    if (!sys::fs::equivalent(path, file.path(), same) && same)
+      found = true;
+  }
+  EXPECT_TRUE(found);
+#endif
+}
+
+}
@@ -13,6 +13,8 @@
 
 #include "llvm/Support/Path.h"
 
+#include <thread>
+
 namespace {
 
 TEST(LinemapTests, CreateLinemap) {
@@ -75,7 +77,131 @@ TEST(LinemapTests, BasicLinemap) {
 
   std::string stats = lm->statistics();
   EXPECT_EQ(stats, "accesses=9 files=5 segments=4 "
-            "locmem=22 bytes/location=2.4");
+            "locmem=22 bytes/location=2.4 decodes=14 decodehits=2");
+}
+
+TEST(LinemapTests, DecodeLocation) {
+  std::unique_ptr<Llvm_linemap> lm(new Llvm_linemap());
+
+  lm->start_file("foo.go", 10);
+  Location f10 = lm->get_location(3);
+  lm->start_file("/tmp/bar.go", 22);
+  Location b22 = lm->get_location(9);
+
+  // Decode of a location in a closed-out segment.
+  Llvm_linemap::FLC flc = lm->decode(f10);
+  EXPECT_EQ(lm->file_name(flc.fidx), "foo.go");
+  EXPECT_EQ(flc.line, 10u);
+  EXPECT_EQ(flc.column, 3u);
+
+  // Decode of a location in the segment currently being built; the
+  // result should not change once the segment is closed out.
+  flc = lm->decode(b22);
+  EXPECT_EQ(lm->file_name(flc.fidx), "/tmp/bar.go");
+  EXPECT_EQ(flc.line, 22u);
+  EXPECT_EQ(flc.column, 9u);
+  lm->start_file("foo.go", 1);
+  EXPECT_EQ(lm->location_file(b22), "/tmp/bar.go");
+  EXPECT_EQ(lm->location_line(b22), 22);
+  EXPECT_EQ(lm->location_column(b22), 9u);
+  EXPECT_EQ(lm->location_file(f10), "foo.go");
+}
+
+TEST(LinemapTests, ConcurrentFiles) {
+  std::unique_ptr<Llvm_linemap> lm(new Llvm_linemap());
+
+  // Each thread reads its own set of files; locations handed out by
+  // one thread have to decode correctly on any other.
+  const unsigned nthreads = 4;
+  const unsigned nfiles = 3;
+  const unsigned nlines = 500;
+  std::vector<std::vector<Location> > locs(nthreads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&lm, &locs, t]() {
+      for (unsigned f = 0; f < nfiles; ++f) {
+        std::string fname =
+            "t" + std::to_string(t) + "f" + std::to_string(f) + ".go";
+        lm->start_file(fname.c_str(), 1);
+        for (unsigned l = 1; l <= nlines; ++l) {
+          lm->start_line(l, 80);
+          locs[t].push_back(lm->get_location(t + 1));
+        }
+        lm->stop();
+      }
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+
+  for (unsigned t = 0; t < nthreads; ++t) {
+    ASSERT_EQ(locs[t].size(), nfiles * nlines);
+    for (unsigned f = 0; f < nfiles; ++f) {
+      std::string fname =
+          "t" + std::to_string(t) + "f" + std::to_string(f) + ".go";
+      for (unsigned l = 1; l <= nlines; ++l) {
+        Location loc = locs[t][f * nlines + l - 1];
+        Llvm_linemap::FLC flc = lm->decode(loc);
+        EXPECT_EQ(lm->file_name(flc.fidx), fname);
+        EXPECT_EQ(flc.line, l);
+        EXPECT_EQ(flc.column, t + 1);
+      }
+    }
+  }
+  EXPECT_EQ(lm->location_file(Linemap::predeclared_location()),
+            "<built-in>");
+}
+
+
+TEST(LinemapTests, ManyThreads) {
+  std::unique_ptr<Llvm_linemap> lm(new Llvm_linemap());
+
+  // More threads than there are shards: the late ones have to share
+  // the overflow shard, interleaving their locations with each other.
+  const unsigned nthreads = 100;
+  const unsigned nfiles = 2;
+  const unsigned nlines = 50;
+  std::vector<std::vector<Location> > locs(nthreads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&lm, &locs, t]() {
+      for (unsigned f = 0; f < nfiles; ++f) {
+        std::string fname =
+            "t" + std::to_string(t) + "f" + std::to_string(f) + ".go";
+        lm->start_file(fname.c_str(), 1);
+        for (unsigned l = 1; l <= nlines; ++l) {
+          lm->start_line(l, 80);
+          locs[t].push_back(lm->get_location(t + 1));
+        }
+        lm->stop();
+      }
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+
+  // Decode from as many threads again; readers don't take shards.
+  std::vector<unsigned> bad(nthreads, 0);
+  threads.clear();
+  for (unsigned t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&lm, &locs, &bad, t]() {
+      for (unsigned u = 0; u < nthreads; ++u) {
+        unsigned v = (t + u) % nthreads;
+        for (unsigned i = 0; i < locs[v].size(); ++i) {
+          std::string fname = "t" + std::to_string(v) + "f" +
+              std::to_string(i / nlines) + ".go";
+          Llvm_linemap::FLC flc = lm->decode(locs[v][i]);
+          if (lm->file_name(flc.fidx) != fname ||
+              flc.line != i % nlines + 1 || flc.column != v + 1)
+            bad[t] += 1;
+        }
+      }
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+  for (unsigned t = 0; t < nthreads; ++t)
+    EXPECT_EQ(bad[t], 0u);
 }
 
 }
@@ -12,6 +12,12 @@
 
 #include "Driver.h"
 #include "GccUtils.h"
+#include "SplitStackLeaf.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
 
 #include "gtest/gtest.h"
 
@@ -401,4 +407,75 @@ TEST(DriverUtilsTests, GCCInstallationDetectorBiarchAliases)
   EXPECT_TRUE(isOK);
 }
 
+TEST(DriverUtilsTests, SplitStackLeafElision) {
+
+  const char *ir = R"RAW_RESULT(
+    declare void @ext()
+    declare void @llvm.lifetime.start.p0i8(i64, i8*)
+    declare void @llvm.lifetime.end.p0i8(i64, i8*)
+    define i64 @leaf(i64* %p) #0 {
+      %v = load i64, i64* %p
+      ret i64 %v
+    }
+    define void @leafWithMarkers() #0 {
+      %a = alloca [16 x i8]
+      %p = bitcast [16 x i8]* %a to i8*
+      call void @llvm.lifetime.start.p0i8(i64 16, i8* %p)
+      store i8 0, i8* %p
+      call void @llvm.lifetime.end.p0i8(i64 16, i8* %p)
+      ret void
+    }
+    define void @bigFrame() #0 {
+      %a = alloca [4096 x i8]
+      %p = getelementptr [4096 x i8], [4096 x i8]* %a, i64 0, i64 0
+      store i8 0, i8* %p
+      ret void
+    }
+    define void @nonLeaf() #0 {
+      call void @ext()
+      ret void
+    }
+    define void @dynAlloca(i64 %n) #0 {
+      %a = alloca i8, i64 %n
+      store i8 0, i8* %a
+      ret void
+    }
+    define <16 x i64> @manySpillable(<16 x i64>* %p) #0 {
+      %a = load <16 x i64>, <16 x i64>* %p
+      %b = add <16 x i64> %a, %a
+      %c = mul <16 x i64> %b, %a
+      ret <16 x i64> %c
+    }
+    define void @overAligned() #0 {
+      %a = alloca i8, align 256
+      store i8 0, i8* %a
+      ret void
+    }
+    attributes #0 = { "split-stack" }
+  )RAW_RESULT";
+
+  llvm::LLVMContext context;
+  llvm::SMDiagnostic err;
+  std::unique_ptr<llvm::Module> m = llvm::parseAssemblyString(ir, err, context);
+  ASSERT_TRUE(m != nullptr);
+
+  llvm::ModuleAnalysisManager mam;
+  gollvm::driver::SplitStackLeafPass pass(256);
+  pass.run(*m, mam);
+
+  EXPECT_FALSE(m->getFunction("leaf")->hasFnAttribute("split-stack"));
+  EXPECT_FALSE(m->getFunction("leafWithMarkers")->hasFnAttribute("split-stack"));
+  EXPECT_TRUE(m->getFunction("bigFrame")->hasFnAttribute("split-stack"));
+  EXPECT_TRUE(m->getFunction("nonLeaf")->hasFnAttribute("split-stack"));
+  EXPECT_TRUE(m->getFunction("dynAlloca")->hasFnAttribute("split-stack"));
+  EXPECT_TRUE(m->getFunction("manySpillable")->hasFnAttribute("split-stack"));
+  EXPECT_TRUE(m->getFunction("overAligned")->hasFnAttribute("split-stack"));
+
+  // Budgets are limited by the guard area provided by __morestack.
+  llvm::Triple x86_64("x86_64-unknown-linux-gnu");
+  llvm::Triple unknown("mips-unknown-linux-gnu");
+  EXPECT_EQ(gollvm::driver::splitStackLeafBudgetLimit(x86_64), 1664u);
+  EXPECT_EQ(gollvm::driver::splitStackLeafBudgetLimit(unknown), 0u);
+}
+
 } // namespace